@@ -1100,6 +1100,9 @@ function equip_generic( p )
    local success
    local o
 
+   -- Recompute the stats once all the outfits are in
+   p:outfitsBegin()
+
    -- Core systems
    success = false
    o = equip_shipOutfits_coreSystems[shipname]
@@ -1169,6 +1172,9 @@ function equip_generic( p )
    equip_set( p, equip_typeOutfits_structurals[basetype] )
    equip_set( p, equip_classOutfits_structurals[class] )
 
+   -- Cargo space depends on the outfits
+   p:outfitsCommit()
+
    -- Add cargo
    local avail_cargo = {}
    local systems = getsysatdistance( nil, 0, 4 )
@@ -1,8 +1,20 @@
 uniform mat4 projection;
+uniform float dt;    // Current time (in seconds)
+uniform float ttl;   // Time to live of the control points (in seconds)
+
 in vec4 vertex;
-out vec2 pos;
+in vec4 vertex_color;
+in vec4 vertex_data; // Birth time, side [0,1], length and thickness (in pixels)
+
+out vec4 color_in;
+out vec2 pos_tex_in;
+out vec2 pos_px_in;
 
 void main(void) {
-   pos = vertex.xy;
-   gl_Position = projection * vertex;
+   color_in     = vertex_color;
+   // Age the control point, starts at 1 and ends at 0
+   pos_tex_in.x = 1. - (dt - vertex_data.x) / ttl;
+   pos_tex_in.y = 2. * vertex_data.y - 1.;
+   pos_px_in    = vec2( vertex_data.z, vertex_data.w * vertex_data.y );
+   gl_Position  = projection * vertex;
 }
@@ -962,6 +962,10 @@ static void ai_create( Pilot* pilot )
          WARN( _("Pilot '%s' equip -> '%s': %s"), pilot->name, func, lua_tostring(naevL, -1));
          lua_pop(naevL, 1);
       }
+
+      /* Commit outfit batches left open by the script, e.g. on error. */
+      while (pilot->outfit_batch > 0)
+         pilot_outfitsEnd( pilot );
    }
 
    /* Since the pilot changes outfits and cores, we must heal him up. */
@@ -1299,13 +1303,15 @@ static int aiL_getnearestpilot( lua_State *L )
    /*dist will be initialized to a number*/
    /*this will only seek out pilots closer than dist*/
    int dist=1000;
-   int i;
+   int i, j;
    int candidate_id = -1;
+   const int *near;
 
-   /*cycle through all the pilots and find the closest one that is not the pilot */
-
-   for (i = 0; i<array_size(pilot_stack); i++)
+   /*cycle through all the nearby pilots and find the closest one that is not the pilot */
+   near = pilot_gridRadius( cur_pilot->solid->pos.x, cur_pilot->solid->pos.y, dist );
+   for (j = 0; j<array_size(near); j++)
    {
+       i = near[j];
        if (pilot_stack[i]->id != cur_pilot->id && vect_dist(&pilot_stack[i]->solid->pos, &cur_pilot->solid->pos) < dist)
        {
             dist = vect_dist(&pilot_stack[i]->solid->pos, &cur_pilot->solid->pos);
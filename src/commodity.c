@@ -35,6 +35,7 @@
 #include "rng.h"
 #include "space.h"
 #include "spfx.h"
+#include "strindex.h"
 
 
 #define XML_COMMODITY_ID      "Commodities" /**< XML document identifier */
@@ -47,6 +48,7 @@
 
 /* commodity stack */
 Commodity* commodity_stack = NULL; /**< Contains all the commodities. */
+static StrIndex* commodity_index = NULL; /**< Name index of the commodity stack. */
 
 /* gatherables stack */
 static Gatherable* gatherable_stack = NULL; /**< Contains the gatherable stuff floating around. */
@@ -132,13 +134,10 @@ void tonnes2str( char *str, int tonnes )
  */
 Commodity* commodity_get( const char* name )
 {
-   int i;
-   for (i=0; i<array_size(commodity_stack); i++)
-      if (strcmp(commodity_stack[i].name,name)==0)
-         return &commodity_stack[i];
-
-   WARN(_("Commodity '%s' not found in stack"), name);
-   return NULL;
+   Commodity *c = commodity_getW( name );
+   if (c == NULL)
+      WARN(_("Commodity '%s' not found in stack"), name);
+   return c;
 }
 
 
@@ -150,11 +149,8 @@ Commodity* commodity_get( const char* name )
  */
 Commodity* commodity_getW( const char* name )
 {
-   int i;
-   for (i=0; i<array_size(commodity_stack); i++)
-      if (strcmp(commodity_stack[i].name, name) == 0)
-         return &commodity_stack[i];
-   return NULL;
+   int i = strindex_get( commodity_index, name );
+   return (i < 0) ? NULL : &commodity_stack[i];
 }
 
 /**
@@ -574,7 +570,7 @@ int commodity_load (void)
    xmlNodePtr node;
    xmlDocPtr doc;
    Commodity *c;
-   int *e;
+   int i, *e;
 
    commodity_stack = array_create( Commodity );
    econ_comm = array_create( int );
@@ -617,6 +613,11 @@ int commodity_load (void)
 
    xmlFreeDoc(doc);
 
+   /* Index by name. */
+   commodity_index = strindex_create( array_size(commodity_stack) );
+   for (i=0; i<array_size(commodity_stack); i++)
+      strindex_add( commodity_index, commodity_stack[i].name, i );
+
    DEBUG( n_( "Loaded %d Commodity", "Loaded %d Commodities", array_size(commodity_stack) ), array_size(commodity_stack) );
 
    return 0;
@@ -635,6 +636,8 @@ void commodity_free (void)
       commodity_freeOne( &commodity_stack[i] );
    array_free( commodity_stack );
    commodity_stack = NULL;
+   strindex_free( commodity_index );
+   commodity_index = NULL;
 
    /* More clean up. */
    array_free( econ_comm );
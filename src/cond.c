@@ -15,12 +15,33 @@
 
 #include "cond.h"
 
+#include "array.h"
 #include "log.h"
 #include "nlua.h"
 #include "nluadef.h"
+#include "strindex.h"
+
+
+/**
+ * @brief A conditional compiled into a Lua function.
+ */
+typedef struct CondCache_ {
+   char *cond; /**< Condition string. */
+   int ref; /**< Registry reference to the compiled function, LUA_NOREF if it failed to compile. */
+} CondCache;
 
 
 static nlua_env cond_env = LUA_NOREF; /** Conditional Lua env. */
+static CondCache *cond_cache = NULL; /**< Compiled conditionals. */
+static StrIndex *cond_index = NULL; /**< Index of cond_cache by condition string. */
+static unsigned int cond_hits = 0; /**< Checks that used an already compiled conditional. */
+static unsigned int cond_misses = 0; /**< Checks that had to compile the conditional. */
+
+
+/*
+ * Prototypes.
+ */
+static int cond_compile( const char *cond );
 
 
 /**
@@ -37,6 +58,11 @@ int cond_init (void)
       return -1;
    }
 
+   cond_cache  = array_create( CondCache );
+   cond_index  = strindex_create( 0 );
+   cond_hits   = 0;
+   cond_misses = 0;
+
    return 0;
 }
 
@@ -46,47 +72,123 @@ int cond_init (void)
  */
 void cond_exit (void)
 {
+   int i;
+
    if (cond_env == LUA_NOREF)
       return;
 
+   DEBUG(_("Conditionals: %d compiled, %u cache hits, %u misses"),
+         array_size(cond_cache), cond_hits, cond_misses);
+
+   for (i=0; i<array_size(cond_cache); i++) {
+      if (cond_cache[i].ref != LUA_NOREF)
+         luaL_unref( naevL, LUA_REGISTRYINDEX, cond_cache[i].ref );
+      free( cond_cache[i].cond );
+   }
+   array_free( cond_cache );
+   cond_cache = NULL;
+   strindex_free( cond_index );
+   cond_index = NULL;
+
    nlua_freeEnv(cond_env);
    cond_env = LUA_NOREF;
 }
 
 
 /**
- * @brief Checks to see if a condition is true.
+ * @brief Gets the conditional cache statistics.
  *
- *    @param cond Condition to check.
- *    @return 0 if is false, 1 if is true, -1 on error.
+ *    @param[out] hits Number of checks that reused a compiled conditional.
+ *    @param[out] misses Number of checks that had to compile the conditional.
  */
-int cond_check( const char* cond )
+void cond_stats( unsigned int *hits, unsigned int *misses )
+{
+   if (hits != NULL)
+      *hits = cond_hits;
+   if (misses != NULL)
+      *misses = cond_misses;
+}
+
+
+/**
+ * @brief Compiles a conditional and adds it to the cache.
+ *
+ *    @param cond Condition to compile.
+ *    @return Index of the conditional in the cache.
+ */
+static int cond_compile( const char *cond )
 {
-   int b;
+   CondCache *c;
    int ret;
 
+   c        = &array_grow( &cond_cache );
+   c->cond  = strdup( cond );
+   c->ref   = LUA_NOREF;
+   strindex_add( cond_index, c->cond, array_size(cond_cache)-1 );
+
    /* Load the string. */
    lua_pushstring(naevL, "return ");
    lua_pushstring(naevL, cond);
    lua_concat(naevL, 2);
-   ret = nlua_dobufenv(cond_env, lua_tostring(naevL,-1),
-                       lua_strlen(naevL,-1), "Lua Conditional");
+   ret = luaL_loadbuffer(naevL, lua_tostring(naevL,-1),
+                         lua_strlen(naevL,-1), "Lua Conditional");
    switch (ret) {
-      case  LUA_ERRSYNTAX:
+      case 0:
+         break;
+      case LUA_ERRSYNTAX:
          WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
-      case LUA_ERRRUN:
-         WARN(_("Lua Conditional had a runtime error: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
+         break;
       case LUA_ERRMEM:
          WARN(_("Lua Conditional ran out of memory: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
-      case LUA_ERRERR:
-         WARN(_("Lua Conditional had an error while handling error function: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
+         break;
       default:
+         WARN(_("Lua Conditional failed to load: %s"), lua_tostring(naevL, -1));
          break;
    }
+   if (ret == 0) {
+      nlua_pushenv(cond_env);
+      lua_setfenv(naevL, -2);
+      c->ref = luaL_ref(naevL, LUA_REGISTRYINDEX);
+   }
+   else
+      lua_pop(naevL, 1);
+   lua_pop(naevL, 1); /* Concatenated string. */
+
+   return array_size(cond_cache)-1;
+}
+
+
+/**
+ * @brief Checks to see if a condition is true.
+ *
+ * Conditions are compiled the first time they are seen and the resulting
+ * function is reused afterwards.
+ *
+ *    @param cond Condition to check.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
+int cond_check( const char* cond )
+{
+   int b, i;
+   int ret;
+
+   /* Get the compiled conditional. */
+   i = strindex_get( cond_index, cond );
+   if (i < 0) {
+      cond_misses++;
+      i = cond_compile( cond );
+   }
+   else
+      cond_hits++;
+   if (cond_cache[i].ref == LUA_NOREF)
+      goto cond_err;
+
+   /* Run it. */
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, cond_cache[i].ref);
+   if (nlua_pcall(cond_env, 0, 1) != 0) {
+      WARN(_("Lua Conditional had a runtime error: %s"), lua_tostring(naevL, -1));
+      goto cond_err;
+   }
 
    /* Check the result. */
    if (lua_isboolean(naevL, -1)) {
@@ -206,6 +206,7 @@ void conf_setAudioDefaults (void)
 {
    /* Sound. */
    conf.snd_voices   = VOICES_DEFAULT;
+   conf.snd_budget   = SOUND_BUDGET_DEFAULT;
    conf.snd_pilotrel = PILOT_RELATIVE_DEFAULT;
    conf.al_efx       = USE_EFX_DEFAULT;
    conf.al_bufsize   = BUFFER_SIZE_DEFAULT;
@@ -266,6 +267,7 @@ void conf_setVideoDefaults (void)
 
    /* Memory. */
    conf.engineglow   = ENGINE_GLOWS_DEFAULT;
+   conf.gfx_budget   = GFX_BUDGET_DEFAULT;
 }
 
 
@@ -339,6 +341,7 @@ int conf_loadConfig ( const char* file )
 
       /* Memory. */
       conf_loadBool( lEnv, "engineglow", conf.engineglow );
+      conf_loadInt( lEnv, "gfx_budget", conf.gfx_budget );
 
       /* Window. */
       w = h = 0;
@@ -369,6 +372,7 @@ int conf_loadConfig ( const char* file )
       /* Sound. */
       conf_loadInt( lEnv, "snd_voices", conf.snd_voices );
       conf.snd_voices = MAX( VOICES_MIN, conf.snd_voices ); /* Must be at least 16. */
+      conf_loadInt( lEnv, "snd_budget", conf.snd_budget );
       conf_loadBool( lEnv, "snd_pilotrel", conf.snd_pilotrel );
       conf_loadBool( lEnv, "al_efx", conf.al_efx );
       conf_loadInt( lEnv, "al_bufsize", conf.al_bufsize );
@@ -865,6 +869,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("engineglow",conf.engineglow);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Memory in MiB ship graphics may use before unused ones get unloaded"));
+   conf_saveInt("gfx_budget",conf.gfx_budget);
+   conf_saveEmptyLine();
+
    /* Window. */
    conf_saveComment(_("The window size or screen resolution"));
    conf_saveComment(_("Set both of these to 0 to make Naev try the desktop resolution"));
@@ -922,6 +930,10 @@ int conf_saveConfig ( const char* file )
    conf_saveInt("snd_voices",conf.snd_voices);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Memory in MiB decoded sounds may use before unused ones get unloaded"));
+   conf_saveInt("snd_budget",conf.snd_budget);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Sets sound to be relative to pilot when camera is following a pilot instead of referenced to camera."));
    conf_saveBool("snd_pilotrel",conf.snd_pilotrel);
    conf_saveEmptyLine();
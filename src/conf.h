@@ -38,6 +38,7 @@
 #define FPS_MAX_DEFAULT                      60    /**< Maximum FPS. */
 #define SHOW_PAUSE_DEFAULT                   1     /**< Whether to display pause status. */
 #define ENGINE_GLOWS_DEFAULT                 1     /**< Whether to display engine glows. */
+#define GFX_BUDGET_DEFAULT                   256   /**< Memory budget for unused ship graphics in MiB. */
 #define MINIMIZE_DEFAULT                     1     /**< Whether to minimize on focus loss. */
 #define COLORBLIND_DEFAULT                   0     /**< Whether to enable colorblindness simulation. */
 #define BIG_ICONS_DEFAULT                    1     /**< Whether to display BIGGER icons. */
@@ -48,6 +49,7 @@
 /* Audio options */
 #define VOICES_DEFAULT                       128   /**< Amount of voices to use. */
 #define VOICES_MIN                           16    /**< Minimum amount of voices to use. */
+#define SOUND_BUDGET_DEFAULT                 64    /**< Memory budget for decoded sounds in MiB. */
 #define PILOT_RELATIVE_DEFAULT               1     /**< Whether the sound is relative to the pilot (as opposed to the camera). */
 #define USE_EFX_DEFAULT                      1     /**< Whether or not to use EFX (if using OpenAL). */
 #define BUFFER_SIZE_DEFAULT                  128   /**< Default buffer size (if using OpenAL). */
@@ -82,6 +84,7 @@ typedef struct PlayerConf_s {
 
    /* Memory usage. */
    int engineglow; /**< Sets engine glow. */
+   int gfx_budget; /**< Memory budget for ship graphics in MiB before unused ones get evicted. */
 
    /* Video options. */
    int width; /**< Width of the window to use. */
@@ -96,6 +99,7 @@ typedef struct PlayerConf_s {
 
    /* Sound. */
    int snd_voices; /**< Number of sound voices to use. */
+   int snd_budget; /**< Memory budget for decoded sounds in MiB before unused ones get freed. */
    int snd_pilotrel; /**< Sound is relative to pilot when following. */
    int al_efx; /**< Should EFX extension be used? (only applicable for OpenAL) */
    int al_bufsize; /**< Size of the buffer (in kilobytes) to use for music. */
@@ -377,6 +377,7 @@ static void sysedit_btnNew( unsigned int wid_unused, char *unused )
    p        = planet_new();
    p->real  = ASSET_REAL;
    p->name  = name;
+   space_invalidateIndex();
 
    /* Base planet data off another. */
    b                    = planet_get( space_getRndPlanet(0, 0, NULL) );
@@ -449,6 +450,7 @@ static void sysedit_btnRename( unsigned int wid_unused, char *unused )
          free(p->name);
 
          p->name = name;
+         space_invalidateIndex();
          window_modifyText( sysedit_widEdit, "txtName", p->name );
          dpl_savePlanet( p );
       }
@@ -1482,6 +1484,7 @@ static void sysedit_editJumpClose( unsigned int wid, char *unused )
       jp_rmFlag( j, JP_HIDDEN );
       jp_rmFlag( j, JP_EXITONLY );
    }
+   map_invalidateDistances();
    j->hide  = pow2( atof(window_getInput( sysedit_widEdit, "inpHide" )) );
 
    window_close( wid, unused );
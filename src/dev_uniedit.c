@@ -718,6 +718,7 @@ static void uniedit_renameSys (void)
       free(sys->name);
 
       sys->name = name;
+      space_invalidateIndex();
       dsys_saveSystem(sys);
 
       /* Re-save adjacent systems. */
@@ -50,72 +50,63 @@ policies, either expressed or implied, of the freetype-gl project.
 /**
  * @brief Like the original: perform a Euclidean Distance Transform on the input and
  *        normalize to [0,1], with a value of 0.5 on the boundary.
+ *
+ * Works in single precision and only uses the memory it is given, so it can be
+ * run from several threads at once.
+ *
  * @param data width*height values, row-major order. Positive values are object pixels.
  *             Negative/zero values are background pixels.
  * @param width Number of columns.
  * @param height Number of rows.
  * @param explicit_max If a positive number is passed in, saturate at that outer distance.
- * @return Allocated distance field, values ranging from 0 (outermost) to 1 (innermost).
+ * @return The data, overwritten with values ranging from 0 (outermost) to 1 (innermost).
  */
-double *
-make_distance_mapd( double *data, unsigned int width, unsigned int height, double explicit_max )
+float *
+make_distance_mapf( float *data, unsigned int width, unsigned int height, float explicit_max )
 {
-    short * xdist = (short *)  malloc( width * height * sizeof(short) );
-    short * ydist = (short *)  malloc( width * height * sizeof(short) );
-    double * gx   = (double *) calloc( width * height, sizeof(double) );
-    double * gy      = (double *) calloc( width * height, sizeof(double) );
-    double * outside = (double *) calloc( width * height, sizeof(double) );
-    double * inside  = (double *) calloc( width * height, sizeof(double) );
-    double vmin = DBL_MAX, vmax = -DBL_MAX;
-    unsigned int i;
+    unsigned int i, n = width * height;
+    short * xdist = (short *) malloc( 2 * n * sizeof(short) );
+    short * ydist = xdist + n;
+    float * work  = (float *) calloc( 4 * n, sizeof(float) );
+    float * gx      = work;
+    float * gy      = work + n;
+    float * outside = work + 2*n;
+    float * inside  = work + 3*n;
+    float vmin = FLT_MAX, vmax;
 
     // Compute outside = edtaa3(bitmap); % Transform background (0's)
     computegradient( data, width, height, gx, gy);
     edtaa3(data, gx, gy, width, height, xdist, ydist, outside);
-    for( i=0; i<width*height; ++i)
-        if( outside[i] < 0.0 )
-            outside[i] = 0.0;
 
     // Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
-    memset( gx, 0, sizeof(double)*width*height );
-    memset( gy, 0, sizeof(double)*width*height );
-    for( i=0; i<width*height; ++i)
-        data[i] = 1 - data[i];
+    memset( gx, 0, 2*n*sizeof(float) );
+    for( i=0; i<n; ++i)
+        data[i] = 1.0f - data[i];
     computegradient( data, width, height, gx, gy );
     edtaa3( data, gx, gy, width, height, xdist, ydist, inside );
-    for( i=0; i<width*height; ++i )
-        if( inside[i] < 0 )
-            inside[i] = 0.0;
 
     // distmap = outside - inside; % Bipolar distance field
-    for( i=0; i<width*height; ++i)
+    for( i=0; i<n; ++i)
     {
-        outside[i] -= inside[i];
-        if( outside[i] < vmin )
-            vmin = outside[i];
+        outside[i] = fmaxf( outside[i], 0.0f ) - fmaxf( inside[i], 0.0f );
+        vmin = fminf( vmin, outside[i] );
     }
 
-    vmax = explicit_max > 0 ? explicit_max : fabs(vmin);
+    vmax = explicit_max > 0 ? explicit_max : fabsf(vmin);
 
-    for( i=0; i<width*height; ++i)
+    for( i=0; i<n; ++i)
     {
-        double v = outside[i];
-        if ( v < vmin)
-            data[i] = 0;
-        else if( v < 0)
-            data[i] = .5-.5*outside[i]/vmin;
+        float v = outside[i];
+        if( v < 0)
+            data[i] = .5f-.5f*v/vmin;
         else if( v <= vmax)
-            data[i] = .5+.5*outside[i]/vmax;
+            data[i] = .5f+.5f*v/vmax;
         else
-            data[i] = +1;
+            data[i] = 1.0f;
     }
 
     free( xdist );
-    free( ydist );
-    free( gx );
-    free( gy );
-    free( outside );
-    free( inside );
+    free( work );
     return data;
 }
 
@@ -132,35 +123,30 @@ float*
 make_distance_mapbf( unsigned char *img,
                     unsigned int width, unsigned int height, double explicit_max )
 {
-    double * data    = (double *) calloc( width * height, sizeof(double) );
-    float *out       = (float *) malloc( width * height * sizeof(float) );
+    float *data = (float *) malloc( width * height * sizeof(float) );
     unsigned int i;
 
     // find minimum and maximum values
-    double img_min = DBL_MAX;
-    double img_max = DBL_MIN;
+    unsigned char img_min = 255;
+    unsigned char img_max = 0;
 
     for( i=0; i<width*height; ++i)
     {
-        double v = img[i];
-        data[i] = v;
-        if (v > img_max)
-            img_max = v;
-        if (v < img_min)
-            img_min = v;
+        if (img[i] > img_max)
+            img_max = img[i];
+        if (img[i] < img_min)
+            img_min = img[i];
     }
 
     // Map values from 0 - 255 to 0.0 - 1.0
     for( i=0; i<width*height; ++i)
-        data[i] = (img[i]-img_min)/img_max;
+        data[i] = (float)(img[i]-img_min) / (float)(img_max > 0 ? img_max : 1);
 
-    data = make_distance_mapd(data, width, height, explicit_max);
+    make_distance_mapf(data, width, height, (float)explicit_max);
 
-    // lower to float
+    // invert in place
     for( i=0; i<width*height; ++i)
-        out[i] = (float)(1-data[i]);
+        data[i] = 1.0f - data[i];
 
-    free( data );
-
-    return out;
+    return data;
 }
@@ -10,6 +10,10 @@
  * Economy is handled with Nodal Analysis.  Systems are modelled as nodes,
  *  jump routes are resistances and production is modelled as node intensity.
  *  This is then solved with linear algebra after each time increment.
+ *
+ * The price parameters of every planet are also copied into a dense table with
+ *  a column per commodity indexed by planet id, so prices can be looked up
+ *  without searching and evaluated for all the planets at once.
  */
 
 
@@ -68,6 +72,25 @@ static cs *econ_G             = NULL; /**< Admittance matrix. */
 int *econ_comm         = NULL; /**< Commodities to calculate. */
 
 
+/**
+ * @brief Price parameters of a commodity on all the planets, indexed by planet id.
+ */
+typedef struct EconPriceColumn_ {
+   int *slot; /**< Index into the planet commodity arrays, -1 if not sold there. */
+   double *price; /**< Base price. */
+   double *sysVariation; /**< System level variation. */
+   double *sysPeriod; /**< System level period. */
+   double *planetVariation; /**< Planet level variation. */
+   double *planetPeriod; /**< Planet level period. */
+} EconPriceColumn;
+static EconPriceColumn *econ_table = NULL; /**< Price table, a column per commodity in econ_comm. */
+static int *econ_commIndex    = NULL; /**< Column of each commodity in commodity_stack, -1 if none. */
+static int econ_tablePlanets  = 0; /**< Number of planets the table was built for. */
+static int econ_tableComms    = 0; /**< Number of commodities the table was built for. */
+static int econ_tableStack    = 0; /**< Size of commodity_stack when the table was built. */
+static int econ_tableDirty    = 1; /**< Whether the prices changed since building the table. */
+
+
 /*
  * Prototypes.
  */
@@ -76,6 +99,12 @@ int *econ_comm         = NULL; /**< Commodities to calculate. */
 //static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price );
 //static int econ_createGMatrix (void);
 
+/* Price table. */
+static int economy_checkPriceTable (void);
+static void economy_freePriceTable (void);
+static const EconPriceColumn* economy_getColumn( const Commodity *com );
+static double economy_evalPrice( const EconPriceColumn *ec, int i, double t );
+
 /*
  * Externed prototypes.
  */
@@ -83,6 +112,230 @@ int economy_sysSave( xmlTextWriterPtr writer );
 int economy_sysLoad( xmlNodePtr parent );
 
 
+/**
+ * @brief Rebuilds the price table if the prices, planets or commodities changed.
+ *
+ *    @return 0 on success.
+ */
+static int economy_checkPriceTable (void)
+{
+   int i, j, k, col, np, nc, ns;
+   double *data;
+   Planet *planets, *p;
+   EconPriceColumn *ec;
+   CommodityPrice *cp;
+
+   planets  = planet_getAll();
+   np       = array_size( planets );
+   nc       = array_size( econ_comm );
+   ns       = array_size( commodity_stack );
+   if (!econ_tableDirty && (econ_table != NULL) &&
+         (np == econ_tablePlanets) && (nc == econ_tableComms) &&
+         (ns == econ_tableStack))
+      return 0;
+   economy_freePriceTable();
+
+   /* Map the commodities to columns. */
+   econ_commIndex = malloc( MAX(ns,1) * sizeof(int) );
+   for (i=0; i<ns; i++)
+      econ_commIndex[i] = -1;
+   for (i=0; i<nc; i++)
+      econ_commIndex[ econ_comm[i] ] = i;
+
+   /* Allocate the columns, the parameters are contiguous per column. */
+   econ_table = calloc( MAX(nc,1), sizeof(EconPriceColumn) );
+   for (i=0; i<nc; i++) {
+      ec = &econ_table[i];
+      ec->slot = malloc( MAX(np,1) * sizeof(int) );
+      for (j=0; j<np; j++)
+         ec->slot[j] = -1;
+      data = calloc( 5*MAX(np,1), sizeof(double) );
+      ec->price            = &data[0];
+      ec->sysVariation     = &data[np];
+      ec->sysPeriod        = &data[2*np];
+      ec->planetVariation  = &data[3*np];
+      ec->planetPeriod     = &data[4*np];
+   }
+
+   /* Fill them in. */
+   for (j=0; j<np; j++) {
+      p = &planets[j];
+      for (k=0; k<array_size(p->commodities); k++) {
+         col = econ_commIndex[ p->commodities[k] - commodity_stack ];
+         if (col < 0)
+            continue;
+         ec = &econ_table[col];
+         /* Keep the first, like searching would. */
+         if (ec->slot[p->id] >= 0)
+            continue;
+         cp = &p->commodityPrice[k];
+         ec->slot[p->id]            = k;
+         ec->price[p->id]           = cp->price;
+         ec->sysVariation[p->id]    = cp->sysVariation;
+         ec->sysPeriod[p->id]       = cp->sysPeriod;
+         ec->planetVariation[p->id] = cp->planetVariation;
+         ec->planetPeriod[p->id]    = cp->planetPeriod;
+      }
+   }
+
+   econ_tablePlanets = np;
+   econ_tableComms   = nc;
+   econ_tableStack   = ns;
+   econ_tableDirty   = 0;
+   return 0;
+}
+
+
+/**
+ * @brief Frees the price table.
+ */
+static void economy_freePriceTable (void)
+{
+   int i;
+
+   for (i=0; i<econ_tableComms; i++) {
+      free( econ_table[i].slot );
+      free( econ_table[i].price );
+   }
+   free( econ_table );
+   econ_table = NULL;
+   free( econ_commIndex );
+   econ_commIndex = NULL;
+   econ_tablePlanets = 0;
+   econ_tableComms   = 0;
+   econ_tableStack   = 0;
+}
+
+
+/**
+ * @brief Gets the price table column of a commodity.
+ *
+ *    @param com Commodity to get column of.
+ *    @return The column or NULL if the commodity is not part of the economy.
+ */
+static const EconPriceColumn* economy_getColumn( const Commodity *com )
+{
+   int col;
+   ptrdiff_t i;
+
+   economy_checkPriceTable();
+   i = com - commodity_stack;
+   if ((i < 0) || (i >= econ_tableStack))
+      return NULL;
+   col = econ_commIndex[i];
+   if (col < 0)
+      return NULL;
+   return &econ_table[col];
+}
+
+
+/**
+ * @brief Evaluates a price of the table.
+ *
+ *    @param ec Column of the commodity.
+ *    @param i Planet id.
+ *    @param t Time in periods.
+ *    @return The unrounded price.
+ */
+static double economy_evalPrice( const EconPriceColumn *ec, int i, double t )
+{
+   return (ec->price[i] + ec->sysVariation[i]
+            * sin(2 * M_PI * t / ec->sysPeriod[i])
+         + ec->planetVariation[i]
+            * sin(2 * M_PI * t / ec->planetPeriod[i]));
+}
+
+
+/**
+ * @brief Marks the price table as needing to be rebuilt.
+ */
+void economy_invalidatePrices (void)
+{
+   econ_tableDirty = 1;
+}
+
+
+/**
+ * @brief Gets the index of a commodity in the commodity arrays of a planet.
+ *
+ *    @param com Commodity to look for.
+ *    @param p Planet to look in.
+ *    @return Index in p->commodities and p->commodityPrice or -1 if not sold there.
+ */
+int economy_commodityIndex( const Commodity *com, const Planet *p )
+{
+   const EconPriceColumn *ec;
+
+   ec = economy_getColumn( com );
+   if ((ec == NULL) || (p->id < 0) || (p->id >= econ_tablePlanets))
+      return -1;
+   return ec->slot[ p->id ];
+}
+
+
+/**
+ * @brief Gets the prices of a commodity on all the planets at a time.
+ *
+ * Evaluates the whole column of the price table in a single pass.
+ *
+ *    @param com Commodity to get prices of.
+ *    @param tme Time to get prices at, eg as returned by ntime_get().
+ *    @param[out] prices Prices indexed by planet id, 0 where it is not sold.
+ *                       Must hold as many elements as there are planets.
+ *    @return Number of prices written or -1 if the commodity has no price.
+ */
+int economy_getPricesAtTime( const Commodity *com, ntime_t tme, credits_t *prices )
+{
+   int i;
+   double t;
+   const EconPriceColumn *ec;
+
+   ec = economy_getColumn( com );
+   if (ec == NULL) {
+      WARN(_("Price for commodity '%s' not known."), com->name);
+      return -1;
+   }
+
+   t = ntime_convertSeconds( tme ) / NT_PERIOD_SECONDS;
+   for (i=0; i<econ_tablePlanets; i++)
+      prices[i] = (ec->slot[i] >= 0) ? (credits_t) (economy_evalPrice( ec, i, t )+0.5) : 0;
+   return econ_tablePlanets;
+}
+
+
+/**
+ * @brief Gets the average prices of a commodity seen by the player on all the planets.
+ *
+ *    @param com Commodity to get prices of.
+ *    @param[out] prices Average prices indexed by planet id, 0 where it is not
+ *                       sold or was never seen. Must hold as many elements as
+ *                       there are planets.
+ *    @return Number of prices written or -1 if the commodity has no price.
+ */
+int economy_getSeenPrices( const Commodity *com, double *prices )
+{
+   int i;
+   const EconPriceColumn *ec;
+   const CommodityPrice *cp;
+   Planet *planets;
+
+   ec = economy_getColumn( com );
+   if (ec == NULL)
+      return -1;
+
+   planets = planet_getAll();
+   for (i=0; i<econ_tablePlanets; i++) {
+      prices[i] = 0.;
+      if (ec->slot[i] < 0)
+         continue;
+      cp = &planets[i].commodityPrice[ ec->slot[i] ];
+      if (cp->cnt > 0)
+         prices[i] = cp->sum / cp->cnt;
+   }
+   return econ_tablePlanets;
+}
+
+
 
 /**
  * @brief Gets the price of a good on a planet in a system.
@@ -112,10 +365,9 @@ credits_t economy_getPrice( const Commodity *com,
 credits_t economy_getPriceAtTime( const Commodity *com,
                                   const StarSystem *sys, const Planet *p, ntime_t tme )
 {
-   int i, k;
    double price;
    double t;
-   CommodityPrice *commPrice;
+   const EconPriceColumn *ec;
    (void) sys;
    /* Get current time in periods.
     * Note, taking off and landing takes about 1e7 ntime, which is 1 period.
@@ -124,37 +376,23 @@ credits_t economy_getPriceAtTime( const Commodity *com,
     */
    t = ntime_convertSeconds( tme ) / NT_PERIOD_SECONDS;
 
-   /* Get position in stack. */
-   k = com - commodity_stack;
-
    /* Find what commodity that is. */
-   for (i=0; i<array_size(econ_comm); i++)
-      if (econ_comm[i] == k)
-         break;
-
-   /* Check if found. */
-   if (i >= array_size(econ_comm)) {
+   ec = economy_getColumn( com );
+   if (ec == NULL) {
       WARN(_("Price for commodity '%s' not known."), com->name);
       return 0;
    }
 
-   /* and get the index on this planet */
-   for ( i=0; i<array_size(p->commodities); i++) {
-     if ( ( strcmp(p->commodities[i]->name, com->name) == 0 ) )
-       break;
-   }
-   if (i >= array_size(p->commodities)) {
+   /* and check it is sold on this planet */
+   if ((p->id >= econ_tablePlanets) || (ec->slot[ p->id ] < 0)) {
      WARN(_("Price for commodity '%s' not known on this planet."), com->name);
      return 0;
    }
-   commPrice = &p->commodityPrice[i];
+
    /* Calculate price. */
    /* price  = (double) com->price; */
    /* price *= sys->prices[i]; */
-   price = (commPrice->price + commPrice->sysVariation
-            * sin(2 * M_PI * t / commPrice->sysPeriod)
-         + commPrice->planetVariation
-            * sin(2 * M_PI * t / commPrice->planetPeriod));
+   price = economy_evalPrice( ec, p->id, t );
    return (credits_t) (price+0.5);/* +0.5 to round */
 }
 
@@ -169,18 +407,11 @@ credits_t economy_getPriceAtTime( const Commodity *com,
  */
 int economy_getAveragePlanetPrice( const Commodity *com, const Planet *p, credits_t *mean, double *std )
 {
-   int i,k;
+   int i;
    CommodityPrice *commPrice;
-   /* Get position in stack */
-   k = com - commodity_stack;
 
    /* Find what commodity this is */
-   for ( i=0; i<array_size(econ_comm); i++ )
-      if (econ_comm[i] == k)
-         break;
-
-   /* Check if found */
-   if ( i>= array_size(econ_comm)) {
+   if (economy_getColumn( com ) == NULL) {
       WARN(_("Average price for commodity '%s' not known."), com->name);
       *mean=0;
       *std=0;
@@ -188,11 +419,8 @@ int economy_getAveragePlanetPrice( const Commodity *com, const Planet *p, credit
    }
 
    /* and get the index on this planet */
-   for ( i=0; i<array_size(p->commodities); i++) {
-     if ( ( strcmp(p->commodities[i]->name, com->name) == 0 ) )
-       break;
-   }
-   if (i >= array_size(p->commodities)) {
+   i = economy_commodityIndex( com, p );
+   if (i < 0) {
       WARN(_("Price for commodity '%s' not known on this planet."), com->name);
       *mean = 0;
       *std = 0;
@@ -229,16 +457,9 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
    double av = 0;
    double av2 = 0;
    int cnt = 0;
-   /* Get position in stack */
-   k = com - commodity_stack;
 
    /* Find what commodity this is */
-   for ( i=0; i<array_size(econ_comm); i++ )
-      if (econ_comm[i] == k)
-         break;
-
-   /* Check if found */
-   if ( i>= array_size(econ_comm)) {
+   if (economy_getColumn( com ) == NULL) {
       WARN(_("Average price for commodity '%s' not known."), com->name);
       *mean = 0;
       *std = 0;
@@ -249,11 +470,8 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
       for ( j=0; j<array_size(sys->planets); j++) {
          p = sys->planets[j];
          /* and get the index on this planet */
-         for ( k=0; k<array_size(p->commodities); k++) {
-            if ( ( strcmp(p->commodities[k]->name, com->name) == 0 ) )
-               break;
-         }
-         if (k < array_size(p->commodityPrice)) {
+         k = economy_commodityIndex( com, p );
+         if (k >= 0) {
             commPrice=&p->commodityPrice[k];
             if ( commPrice->cnt>0) {
                av+=commPrice->sum/commPrice->cnt;
@@ -570,6 +788,9 @@ void economy_destroy (void)
 {
    int i;
 
+   economy_freePriceTable();
+   econ_tableDirty = 1;
+
    /* Must be initialized. */
    if (!econ_initialized)
       return;
@@ -839,6 +1060,10 @@ void economy_initialiseCommodityPrices(void)
    StarSystem *sys;
    Commodity *com;
    CommodityModifier *this, *next;
+
+   /* The price table has to be rebuilt. */
+   economy_invalidatePrices();
+
    /* First use planet attributes to set prices and variability */
    for (k=0; k<array_size(systems_stack); k++) {
       sys = &systems_stack[k];
@@ -898,6 +1123,7 @@ void economy_initialiseCommodityPrices(void)
 void economy_initialiseSingleSystem( StarSystem *sys, Planet *planet )
 {
    int i;
+   economy_invalidatePrices();
    for ( i=0; i<array_size(planet->commodities); i++ ) {
       economy_calcPrice(planet, planet->commodities[i], &planet->commodityPrice[i]);
    }
@@ -33,6 +33,10 @@ void economy_averageSeenPrices( const Planet *p );
 void economy_averageSeenPricesAtTime( const Planet *p, const ntime_t tupdate );
 credits_t economy_getPrice( const Commodity *com, const StarSystem *sys, const Planet *p );
 credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys, const Planet *p, ntime_t t );
+int economy_getPricesAtTime( const Commodity *com, ntime_t tme, credits_t *prices );
+int economy_getSeenPrices( const Commodity *com, double *prices );
+int economy_commodityIndex( const Commodity *com, const Planet *p );
+void economy_invalidatePrices (void);
 
 /*
  * Calculating the sinusoidal economy values
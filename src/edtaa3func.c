@@ -29,6 +29,9 @@
  *
  * Updated 2014 to fix a bug with the 'gy' gradient computation.
  *
+ * Changed to single precision for naev, the distance fields end up in
+ * float textures anyway.
+ *
  */
 
 /*
@@ -64,20 +67,20 @@
  * The gradient is computed only at edge pixels. At other places in the
  * image, it is never used, and it's mostly zero anyway.
  */
-void computegradient(double *img, int w, int h, double *gx, double *gy)
+void computegradient(float *img, int w, int h, float *gx, float *gy)
 {
     int i,j,k; //,p,q;
-    double glength; //, phi, phiscaled, ascaled, errsign, pfrac, qfrac, err0, err1, err;
-#define SQRT2 1.4142136
+    float glength; //, phi, phiscaled, ascaled, errsign, pfrac, qfrac, err0, err1, err;
+#define SQRT2 1.4142136f
     for(i = 1; i < h-1; i++) { // Avoid edges where the kernels would spill over
         for(j = 1; j < w-1; j++) {
             k = i*w + j;
-            if((img[k]>0.0) && (img[k]<1.0)) { // Compute gradient for edge pixels only
+            if((img[k]>0.0f) && (img[k]<1.0f)) { // Compute gradient for edge pixels only
                 gx[k] = -img[k-w-1] - SQRT2*img[k-1] - img[k+w-1] + img[k-w+1] + SQRT2*img[k+1] + img[k+w+1];
                 gy[k] = -img[k-w-1] - SQRT2*img[k-w] - img[k-w+1] + img[k+w-1] + SQRT2*img[k+w] + img[k+w+1];
                 glength = gx[k]*gx[k] + gy[k]*gy[k];
-                if(glength > 0.0) { // Avoid division by zero
-                    glength = sqrt(glength);
+                if(glength > 0.0f) { // Avoid division by zero
+                    glength = sqrtf(glength);
                     gx[k]=gx[k]/glength;
                     gy[k]=gy[k]/glength;
                 }
@@ -98,14 +101,14 @@ void computegradient(double *img, int w, int h, double *gx, double *gy)
  * accuracy at and near edges, and reduces the error even at distant pixels
  * provided that the gradient direction is accurately estimated.
  */
-double edgedf(double gx, double gy, double a)
+float edgedf(float gx, float gy, float a)
 {
-    double df, glength, temp, a1;
+    float df, glength, temp, a1;
 
     if ((gx == 0) || (gy == 0)) { // Either A) gu or gv are zero, or B) both
-        df = 0.5-a;  // Linear approximation is A) correct or B) a fair guess
+        df = 0.5f-a;  // Linear approximation is A) correct or B) a fair guess
     } else {
-        glength = sqrt(gx*gx + gy*gy);
+        glength = sqrtf(gx*gx + gy*gy);
         if(glength>0) {
             gx = gx/glength;
             gy = gy/glength;
@@ -114,28 +117,28 @@ double edgedf(double gx, double gy, double a)
          * so move to first octant (gx>=0, gy>=0, gx>=gy) to
          * avoid handling all possible edge directions.
          */
-        gx = fabs(gx);
-        gy = fabs(gy);
+        gx = fabsf(gx);
+        gy = fabsf(gy);
         if(gx<gy) {
             temp = gx;
             gx = gy;
             gy = temp;
         }
-        a1 = 0.5*gy/gx;
+        a1 = 0.5f*gy/gx;
         if (a < a1) { // 0 <= a < a1
-            df = 0.5*(gx + gy) - sqrt(2.0*gx*gy*a);
-        } else if (a < (1.0-a1)) { // a1 <= a <= 1-a1
-            df = (0.5-a)*gx;
+            df = 0.5f*(gx + gy) - sqrtf(2.0f*gx*gy*a);
+        } else if (a < (1.0f-a1)) { // a1 <= a <= 1-a1
+            df = (0.5f-a)*gx;
         } else { // 1-a1 < a <= 1
-            df = -0.5*(gx + gy) + sqrt(2.0*gx*gy*(1.0-a));
+            df = -0.5f*(gx + gy) + sqrtf(2.0f*gx*gy*(1.0f-a));
         }
     }
     return df;
 }
 
-double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc, int yc, int xi, int yi)
+float distaa3(float *img, float *gximg, float *gyimg, int w, int c, int xc, int yc, int xi, int yi)
 {
-  double di, df, dx, dy, gx, gy, a;
+  float di, df, dx, dy, gx, gy, a;
   int closest;
 
   closest = c-xc-yc*w; // Index to the edge pixel pointed to from c
@@ -143,13 +146,13 @@ double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc,
   gx = gximg[closest]; // X gradient component at the edge pixel
   gy = gyimg[closest]; // Y gradient component at the edge pixel
 
-  if(a > 1.0) a = 1.0;
-  if(a < 0.0) a = 0.0; // Clip grayscale values outside the range [0,1]
-  if(a == 0.0) return 1000000.0; // Not an object pixel, return "very far" ("don't know yet")
+  if(a > 1.0f) a = 1.0f;
+  if(a < 0.0f) a = 0.0f; // Clip grayscale values outside the range [0,1]
+  if(a == 0.0f) return 1000000.0f; // Not an object pixel, return "very far" ("don't know yet")
 
-  dx = (double)xi;
-  dy = (double)yi;
-  di = sqrt(dx*dx + dy*dy); // Length of integer vector, like a traditional EDT
+  dx = (float)xi;
+  dy = (float)yi;
+  di = sqrtf(dx*dx + dy*dy); // Length of integer vector, like a traditional EDT
   if(di==0) { // Use local gradient only at edges
       // Estimate based on local gradient only
       df = edgedf(gx, gy, a);
@@ -163,15 +166,15 @@ double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc,
 // Shorthand macro: add ubiquitous parameters dist, gx, gy, img and w and call distaa3()
 #define DISTAA(c,xc,yc,xi,yi) (distaa3(img, gx, gy, w, c, xc, yc, xi, yi))
 
-void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, short *disty, double *dist)
+void edtaa3(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist)
 {
   int x, y, i, c;
   int offset_u, offset_ur, offset_r, offset_rd,
   offset_d, offset_dl, offset_l, offset_lu;
-  double olddist, newdist;
+  float olddist, newdist;
   int cdistx, cdisty, newdistx, newdisty;
   int changed;
-  double epsilon = 1e-3;
+  float epsilon = 1e-3f;
 
   /* Initialize index offsets for the current image width */
   offset_u = -w;
@@ -187,15 +190,15 @@ void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, sho
   for(i=0; i<w*h; i++) {
     distx[i] = 0; // At first, all pixels point to
     disty[i] = 0; // themselves as the closest known.
-    if(img[i] <= 0.0)
+    if(img[i] <= 0.0f)
       {
-	dist[i]= 1000000.0; // Big value, means "not set yet"
+	dist[i]= 1000000.0f; // Big value, means "not set yet"
       }
-    else if (img[i]<1.0) {
+    else if (img[i]<1.0f) {
       dist[i] = edgedf(gx[i], gy[i], img[i]); // Gradient-assisted estimate
     }
     else {
-      dist[i]= 0.0; // Inside the object
+      dist[i]= 0.0f; // Inside the object
     }
   }
 
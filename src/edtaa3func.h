@@ -72,7 +72,7 @@ namespace ftgl {
  * The gradient is computed only at edge pixels. At other places in the
  * image, it is never used, and it's mostly zero anyway.
  */
-void computegradient(double *img, int w, int h, double *gx, double *gy);
+void computegradient(float *img, int w, int h, float *gx, float *gy);
 
 /*
  * A somewhat tricky function to approximate the distance to an edge in a
@@ -83,15 +83,15 @@ void computegradient(double *img, int w, int h, double *gx, double *gy);
  * accuracy at and near edges, and reduces the error even at distant pixels
  * provided that the gradient direction is accurately estimated.
  */
-double edgedf(double gx, double gy, double a);
+float edgedf(float gx, float gy, float a);
 
 
-double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc, int yc, int xi, int yi);
+float distaa3(float *img, float *gximg, float *gyimg, int w, int c, int xc, int yc, int xi, int yi);
 
 // Shorthand macro: add ubiquitous parameters dist, gx, gy, img and w and call distaa3()
 #define DISTAA(c,xc,yc,xi,yi) (distaa3(img, gx, gy, w, c, xc, yc, xi, yi))
 
-void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, short *disty, double *dist);
+void edtaa3(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist);
 
 
 #ifdef __cplusplus
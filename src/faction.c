@@ -11,6 +11,7 @@
 
 /** @cond */
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "naev.h"
@@ -30,6 +31,7 @@
 #include "opengl.h"
 #include "rng.h"
 #include "space.h"
+#include "strindex.h"
 
 
 #define XML_FACTION_ID     "Factions"   /**< XML section identifier */
@@ -46,6 +48,12 @@
 #define faction_isFlag(fa,f)  ((fa)->flags & (f))
 #define faction_isKnown_(fa)   ((fa)->flags & (FACTION_KNOWN))
 
+#define FACTION_PREL_VALID    (1<<0) /**< Cached player relationship is valid. */
+#define FACTION_PREL_FRIEND   (1<<1) /**< Player is a friend of the faction. */
+#define FACTION_PREL_ENEMY    (1<<2) /**< Player is an enemy of the faction. */
+
+#define FACTION_GRID_BITS     32 /**< Bits per word of the relationship grid. */
+
 /**
  * @struct Faction
  *
@@ -71,6 +79,8 @@ typedef struct Faction_ {
    /* Player information. */
    double player_def; /**< Default player standing. */
    double player; /**< Standing with player - from -100 to 100 */
+   double player_cache; /**< Standing player_rel was computed at. */
+   unsigned int player_rel; /**< Cached player relationship (FACTION_PREL_*). */
 
    /* Scheduler. */
    nlua_env sched_env; /**< Lua scheduler script. */
@@ -87,6 +97,11 @@ typedef struct Faction_ {
 } Faction;
 
 static Faction* faction_stack = NULL; /**< Faction stack. */
+static StrIndex* faction_index = NULL; /**< Name index of the faction stack. */
+static uint32_t *faction_grid_enemies = NULL; /**< Symmetric enemy bitset matrix. */
+static uint32_t *faction_grid_allies = NULL; /**< Symmetric ally bitset matrix. */
+static int faction_grid_n = 0; /**< Number of factions in the relationship grid. */
+static int faction_grid_words = 0; /**< Words per row of the relationship grid. */
 
 
 /*
@@ -94,6 +109,12 @@ static Faction* faction_stack = NULL; /**< Faction stack. */
  */
 /* static */
 static int faction_getRaw( const char *name );
+static void faction_buildIndex (void);
+static void faction_buildGrid (void);
+static void faction_updateGrid( int a, int b );
+static int faction_inList( const int *list, int f );
+static unsigned int faction_playerRel( Faction *faction );
+static int faction_playerRelLua( const Faction *faction, const char *func );
 static void faction_freeOne( Faction *f );
 static void faction_sanitizePlayer( Faction* faction );
 static void faction_modPlayerLua( int f, double mod, const char *source, int secondary );
@@ -112,20 +133,106 @@ int pfaction_load( xmlNodePtr parent );
  */
 static int faction_getRaw( const char* name )
 {
-   int i;
    /* Escorts are part of the "player" faction. */
    if (strcmp(name, "Escort") == 0)
       return FACTION_PLAYER;
 
-   if (name != NULL) {
-      for (i=0; i<array_size(faction_stack); i++)
-         if (strcmp(faction_stack[i].name, name)==0)
-            break;
+   return strindex_get( faction_index, name );
+}
+
+
+/**
+ * @brief Rebuilds the name index of the faction stack.
+ */
+static void faction_buildIndex (void)
+{
+   int i;
+
+   strindex_free( faction_index );
+   faction_index = strindex_create( array_size(faction_stack) );
+   for (i=0; i<array_size(faction_stack); i++)
+      strindex_add( faction_index, faction_stack[i].name, i );
+}
+
+
+/**
+ * @brief Checks to see if a faction is in a list of faction IDs.
+ */
+static int faction_inList( const int *list, int f )
+{
+   int i;
+   for (i=0; i<array_size(list); i++)
+      if (list[i] == f)
+         return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Recomputes the relationship grid entries between two factions.
+ *
+ * Relationships are symmetric, so they hold if either faction lists the other.
+ */
+static void faction_updateGrid( int a, int b )
+{
+   Faction *fa, *fb;
+   uint32_t ma, mb;
+   int wa, wb;
+
+   if ((a < 0) || (b < 0) || (a >= faction_grid_n) || (b >= faction_grid_n) || (a == b))
+      return;
+
+   fa = &faction_stack[a];
+   fb = &faction_stack[b];
+   wa = a*faction_grid_words + b/FACTION_GRID_BITS;
+   wb = b*faction_grid_words + a/FACTION_GRID_BITS;
+   ma = 1u << (b % FACTION_GRID_BITS);
+   mb = 1u << (a % FACTION_GRID_BITS);
+
+   if (faction_inList( fa->enemies, b ) || faction_inList( fb->enemies, a )) {
+      faction_grid_enemies[wa] |= ma;
+      faction_grid_enemies[wb] |= mb;
+   }
+   else {
+      faction_grid_enemies[wa] &= ~ma;
+      faction_grid_enemies[wb] &= ~mb;
+   }
 
-      if (i != array_size(faction_stack))
-         return i;
+   if (faction_inList( fa->allies, b ) || faction_inList( fb->allies, a )) {
+      faction_grid_allies[wa] |= ma;
+      faction_grid_allies[wb] |= mb;
+   }
+   else {
+      faction_grid_allies[wa] &= ~ma;
+      faction_grid_allies[wb] &= ~mb;
+   }
+}
+
+
+/**
+ * @brief Rebuilds the relationship grid of the faction stack.
+ */
+static void faction_buildGrid (void)
+{
+   int i, j;
+   Faction *f;
+   size_t size;
+
+   faction_grid_n     = array_size(faction_stack);
+   faction_grid_words = (faction_grid_n + FACTION_GRID_BITS - 1) / FACTION_GRID_BITS;
+   size = sizeof(uint32_t) * faction_grid_n * faction_grid_words;
+   faction_grid_enemies = realloc( faction_grid_enemies, size );
+   faction_grid_allies  = realloc( faction_grid_allies, size );
+   memset( faction_grid_enemies, 0, size );
+   memset( faction_grid_allies, 0, size );
+
+   for (i=0; i<faction_grid_n; i++) {
+      f = &faction_stack[i];
+      for (j=0; j<array_size(f->enemies); j++)
+         faction_updateGrid( i, f->enemies[j] );
+      for (j=0; j<array_size(f->allies); j++)
+         faction_updateGrid( i, f->allies[j] );
    }
-   return -1;
 }
 
 
@@ -512,6 +619,7 @@ void faction_addEnemy( int f, int o )
 
    tmp = &array_grow( &ff->enemies );
    *tmp = o;
+   faction_updateGrid( f, o );
 }
 
 
@@ -538,6 +646,7 @@ void faction_rmEnemy( int f, int o )
    for (i=0;i<array_size(ff->enemies);i++) {
       if (ff->enemies[i] == o) {
          array_erase( &ff->enemies, &ff->enemies[i], &ff->enemies[i+1] );
+         faction_updateGrid( f, o );
          return;
       }
    }
@@ -586,6 +695,7 @@ void faction_addAlly( int f, int o )
 
    tmp = &array_grow( &ff->allies );
    *tmp = o;
+   faction_updateGrid( f, o );
 }
 
 
@@ -612,6 +722,7 @@ void faction_rmAlly( int f, int o )
    for (i=0;i<array_size(ff->allies);i++) {
       if (ff->allies[i] == o) {
          array_erase( &ff->allies, &ff->allies[i], &ff->allies[i+1] );
+         faction_updateGrid( f, o );
          return;
       }
    }
@@ -899,96 +1010,94 @@ double faction_getPlayerDef( int f )
 
 
 /**
- * @brief Gets whether or not the player is a friend of the faction.
+ * @brief Runs one of the player standing checks of a faction's script.
  *
- *    @param f Faction to check friendliness of.
- *    @return 1 if the player is a friend, 0 otherwise.
+ *    @param faction Faction to run the check for.
+ *    @param func Name of the Lua function to call with the standing.
+ *    @return The boolean returned by the function, 0 on error.
  */
-int faction_isPlayerFriend( int f )
+static int faction_playerRelLua( const Faction *faction, const char *func )
 {
-   Faction *faction;
    int r;
 
-   faction = &faction_stack[f];
+   /* Set up the function:
+    * func( standing ) */
+   nlua_getenv( faction->env, func );
+   lua_pushnumber( naevL, faction->player );
 
-   if ( faction->env == LUA_NOREF )
-      return 0;
-   else
+   /* Call function. */
+   if ( nlua_pcall( faction->env, 1, 1 ) )
    {
-
-      /* Set up the function:
-       * faction_player_friend( standing ) */
-      nlua_getenv( faction->env, "faction_player_friend" );
-      lua_pushnumber( naevL, faction->player );
-
-      /* Call function. */
-      if ( nlua_pcall( faction->env, 1, 1 ) )
-      {
-         /* An error occurred. */
-         WARN( _("Faction '%s': %s"), faction->name, lua_tostring( naevL, -1 ) );
-         lua_pop( naevL, 1 );
-         return 0;
-      }
-
-      /* Parse return. */
-      if ( !lua_isboolean( naevL, -1 ) )
-      {
-         WARN( _("Lua script for faction '%s' did not return a boolean from 'faction_player_friend(...)'."), faction->name );
-         r = 0;
-      }
-      else
-         r = lua_toboolean( naevL, -1 );
+      /* An error occurred. */
+      WARN( _("Faction '%s': %s"), faction->name, lua_tostring( naevL, -1 ) );
       lua_pop( naevL, 1 );
+      return 0;
+   }
 
-      return r;
+   /* Parse return. */
+   if ( !lua_isboolean( naevL, -1 ) )
+   {
+      WARN( _("Lua script for faction '%s' did not return a boolean from '%s(...)'."), faction->name, func );
+      r = 0;
    }
+   else
+      r = lua_toboolean( naevL, -1 );
+   lua_pop( naevL, 1 );
+
+   return r;
 }
 
 
 /**
- * @brief Gets whether or not the player is an enemy of the faction.
+ * @brief Gets the player relationship flags of a faction.
  *
- *    @param f Faction to check hostility of.
- *    @return 1 if the player is an enemy, 0 otherwise.
+ * The faction script thresholds only depend on the standing, so they are
+ * cached and only rerun when the standing changes.
+ *
+ *    @param faction Faction to get the relationship of.
+ *    @return The FACTION_PREL_* flags of the faction.
  */
-int faction_isPlayerEnemy( int f )
+static unsigned int faction_playerRel( Faction *faction )
 {
-   Faction *faction;
-   int r;
+   if ((faction->player_rel & FACTION_PREL_VALID) &&
+         (faction->player_cache == faction->player))
+      return faction->player_rel;
 
-   faction = &faction_stack[f];
+   faction->player_rel   = FACTION_PREL_VALID;
+   faction->player_cache = faction->player;
+   if (faction->env == LUA_NOREF)
+      return faction->player_rel;
 
-   if ( faction->env == LUA_NOREF )
-      return 0;
-   else
-   {
+   if (faction_playerRelLua( faction, "faction_player_friend" ))
+      faction->player_rel |= FACTION_PREL_FRIEND;
+   if (faction_playerRelLua( faction, "faction_player_enemy" ))
+      faction->player_rel |= FACTION_PREL_ENEMY;
 
-      /* Set up the function:
-       * faction_player_enemy( standing ) */
-      nlua_getenv( faction->env, "faction_player_enemy" );
-      lua_pushnumber( naevL, faction->player );
+   return faction->player_rel;
+}
 
-      /* Call function. */
-      if ( nlua_pcall( faction->env, 1, 1 ) )
-      {
-         /* An error occurred. */
-         WARN( _("Faction '%s': %s"), faction->name, lua_tostring( naevL, -1 ) );
-         lua_pop( naevL, 1 );
-         return 0;
-      }
 
-      /* Parse return. */
-      if ( !lua_isboolean( naevL, -1 ) )
-      {
-         WARN( _("Lua script for faction '%s' did not return a boolean from 'faction_player_enemy(...)'."), faction->name );
-         r = 0;
-      }
-      else
-         r = lua_toboolean( naevL, -1 );
-      lua_pop( naevL, 1 );
+/**
+ * @brief Gets whether or not the player is a friend of the faction.
+ *
+ *    @param f Faction to check friendliness of.
+ *    @return 1 if the player is a friend, 0 otherwise.
+ */
+int faction_isPlayerFriend( int f )
+{
+   return !!(faction_playerRel( &faction_stack[f] ) & FACTION_PREL_FRIEND);
+}
 
-      return r;
-   }
+
+/**
+ * @brief Gets whether or not the player is an enemy of the faction.
+ *
+ *    @param f Faction to check hostility of.
+ *    @return 1 if the player is an enemy, 0 otherwise.
+ */
+int faction_isPlayerEnemy( int f )
+{
+   return !!(faction_playerRel( &faction_stack[f] ) & FACTION_PREL_ENEMY);
 }
 
 
@@ -1141,23 +1250,16 @@ const char *faction_getStandingBroad( int f, int bribed, int override )
  */
 int areEnemies( int a, int b)
 {
-   Faction *fa, *fb;
-   int i;
-
    if (a==b) return 0; /* luckily our factions aren't masochistic */
 
    /* handle a */
-   if (faction_isFaction(a))
-      fa = &faction_stack[a];
-   else { /* a is invalid */
+   if (!faction_isFaction(a)) { /* a is invalid */
       WARN(_("Faction id '%d' is invalid."), a);
       return 0;
    }
 
    /* handle b */
-   if (faction_isFaction(b))
-      fb = &faction_stack[b];
-   else { /* b is invalid */
+   if (!faction_isFaction(b)) { /* b is invalid */
       WARN(_("Faction id '%d' is invalid."), b);
       return 0;
    }
@@ -1170,14 +1272,8 @@ int areEnemies( int a, int b)
       return faction_isPlayerEnemy(a);
    }
 
-   for (i=0;i<array_size(fa->enemies);i++)
-      if (fa->enemies[i] == b)
-         return 1;
-   for (i=0;i<array_size(fb->enemies);i++)
-      if (fb->enemies[i] == a)
-         return 1;
-
-   return 0;
+   return !!(faction_grid_enemies[ a*faction_grid_words + b/FACTION_GRID_BITS ]
+         & (1u << (b % FACTION_GRID_BITS)));
 }
 
 
@@ -1190,24 +1286,17 @@ int areEnemies( int a, int b)
  */
 int areAllies( int a, int b )
 {
-   Faction *fa, *fb;
-   int i;
-
    /* If they are the same they must be allies. */
    if (a==b) return 1;
 
    /* handle a */
-   if (faction_isFaction(a))
-      fa = &faction_stack[a];
-   else { /* a is invalid */
+   if (!faction_isFaction(a)) { /* a is invalid */
       WARN(_("Faction id '%d' is invalid."), a);
       return 0;
    }
 
    /* handle b */
-   if (faction_isFaction(b))
-      fb = &faction_stack[b];
-   else { /* b is invalid */
+   if (!faction_isFaction(b)) { /* b is invalid */
       WARN(_("Faction id '%d' is invalid."), b);
       return 0;
    }
@@ -1220,14 +1309,8 @@ int areAllies( int a, int b )
       return faction_isPlayerFriend(a);
    }
 
-   for (i=0;i<array_size(fa->allies);i++)
-      if (fa->allies[i] == b)
-         return 1;
-   for (i=0;i<array_size(fb->allies);i++)
-      if (fb->allies[i] == a)
-         return 1;
-
-   return 0;
+   return !!(faction_grid_allies[ a*faction_grid_words + b/FACTION_GRID_BITS ]
+         & (1u << (b % FACTION_GRID_BITS)));
 }
 
 
@@ -1526,6 +1609,7 @@ int factions_load (void)
          f->oflags = f->flags;
       }
    } while (xml_nextNode(node));
+   faction_buildIndex();
 
    /* Second pass - sets allies and enemies */
    node = factions;
@@ -1572,6 +1656,9 @@ int factions_load (void)
 
    xmlFreeDoc(doc);
 
+   /* Build the relationship grid. */
+   faction_buildGrid();
+
    DEBUG( n_( "Loaded %d Faction", "Loaded %d Factions", array_size(faction_stack) ), array_size(faction_stack) );
 
    return 0;
@@ -1612,6 +1699,14 @@ void factions_free (void)
       faction_freeOne( &faction_stack[i] );
    array_free(faction_stack);
    faction_stack = NULL;
+   strindex_free(faction_index);
+   faction_index = NULL;
+   free(faction_grid_enemies);
+   free(faction_grid_allies);
+   faction_grid_enemies = NULL;
+   faction_grid_allies  = NULL;
+   faction_grid_n       = 0;
+   faction_grid_words   = 0;
 }
 
 
@@ -1772,6 +1867,10 @@ void factions_clearDynamic (void)
          i--;
       }
    }
+
+   /* Positions changed. */
+   faction_buildIndex();
+   faction_buildGrid();
 }
 
 
@@ -1826,5 +1925,8 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
       f->equip_env = bf->equip_env;
    }
 
+   strindex_add( faction_index, f->name, f-faction_stack );
+   faction_buildGrid();
+
    return f-faction_stack;
 }
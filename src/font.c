@@ -10,6 +10,23 @@
  * We use distance fields [1] to render high quality fonts with the help of
  * some shaders. Characters are generated on demand using a texture atlas.
  *
+ * Computing the distance fields is by far the slowest part, so the generated
+ * glyphs are also kept in a cache file per font and size, keyed by the identity
+ * of the font files.  gl_fontPrewarm() can be used to generate a whole set of
+ * characters ahead of time, the distance fields of those not in the cache are
+ * then computed on the threadpool.  gl_fontPrewarmLanguage() does so for the
+ * characters of the active translation, so only characters outside of it are
+ * still generated when first drawn.
+ *
+ * Most of the strings drawn by the GUI are the same from one frame to the
+ * next, so single line strings are also laid out once into a small vertex
+ * buffer of positioned glyph quads, keyed by font, width limit and text.
+ * Drawing them again is then a draw call per texture or colour change instead
+ * of a kerning lookup, matrix update and draw call per character.  Strings are
+ * only laid out once they are drawn again on a later frame, so values that
+ * change every frame don't churn through the cache.  Layouts not drawn for
+ * FONT_LAYOUT_TTL frames are dropped by gl_fontFrameEnd().
+ *
  * [1]: https://steamcdn-a.akamaihd.net/apps/valve/2007/SIGGRAPH2007_AlphaTestedMagnification.pdf
  */
 
@@ -19,6 +36,8 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 #include FT_MODULE_H
+#include <inttypes.h>
+#include "physfs.h"
 
 #include "naev.h"
 /** @endcond */
@@ -28,9 +47,12 @@
 #include "array.h"
 #include "conf.h"
 #include "distance_field.h"
+#include "gettext.h"
 #include "log.h"
 #include "ndata.h"
 #include "nfile.h"
+#include "nstring.h"
+#include "threadpool.h"
 #include "utf8.h"
 
 
@@ -39,6 +61,14 @@
 #define HASH_LUT_SIZE 512 /**< Size of glyph look up table. */
 #define DEFAULT_TEXTURE_SIZE 1024 /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_CACHE_DIR     "fonts/" /**< Directory of the glyph caches in the cache path. */
+#define FONT_CACHE_MAGIC   "NAEVFNT" /**< Identifies glyph caches, with the NUL makes 8 bytes. */
+#define FONT_CACHE_VERSION 1 /**< Format version, bump when changing what is stored or how glyphs are rendered. */
+#define FONT_HASH_INIT     14695981039346656037ULL /**< Initial value of the FNV-1a hash. */
+#define FONT_LAYOUT_MAX    512 /**< Maximum number of cached layouts. */
+#define FONT_LAYOUT_LUT    1024 /**< Size of the layout look up table. */
+#define FONT_LAYOUT_TTL    60 /**< Frames a layout is kept without being drawn. */
+#define FONT_LAYOUT_LEN    256 /**< Longest string that gets its layout cached. */
 
 
 /**
@@ -89,7 +119,7 @@ typedef struct glFontGlyph_s {
  */
 typedef struct font_char_s {
    GLubyte *data; /**< Data of the character. */
-   GLfloat *dataf; /**< Float data of the character. */
+   double sdf_max; /**< Distance field saturation, 0. once data holds the final values. */
    int w; /**< Width. */
    int h; /**< Height. */
    int ft_index; /**< HACK: Index into the array of fallback fonts. */
@@ -111,9 +141,43 @@ typedef struct glFontFile_s {
    int refcount; /**< Reference counting. */
    FT_Byte *data; /**< Font data buffer. */
    size_t datasize; /**< Font data size. */
+   uint64_t hash; /**< Hash of the identity of the font file. */
 } glFontFile;
 
 
+/**
+ * @brief Header of a glyph cache file.
+ */
+typedef struct glFontCacheHeader_s {
+   char magic[8]; /**< FONT_CACHE_MAGIC. */
+   uint64_t key; /**< Key of the font stash the glyphs were generated for. */
+} glFontCacheHeader;
+
+
+/**
+ * @brief Glyph record of a cache file, followed by w*h bytes of distance field.
+ */
+typedef struct glFontCacheGlyph_s {
+   uint32_t codepoint; /**< Real character. */
+   int32_t ft_index; /**< Index into the array of fallback fonts. */
+   int16_t w; /**< Width. */
+   int16_t h; /**< Height. */
+   int16_t off_x; /**< X offset when rendering. */
+   int16_t off_y; /**< Y offset when rendering. */
+   float adv_x; /**< X advancement on the screen. */
+} glFontCacheGlyph;
+
+
+/**
+ * @brief Index entry of a cached glyph.
+ */
+typedef struct glFontCacheEntry_s {
+   uint32_t codepoint; /**< Real character. */
+   size_t offset; /**< Offset of the record in the cache data. */
+   int next; /**< Stored as a linked list. */
+} glFontCacheEntry;
+
+
 /**
  * @brief Freetype Font structure.
  */
@@ -149,9 +213,68 @@ typedef struct glFontStash_s {
    /* Freetype stuff. */
    glFontStashFreetype *ft;
 
+   /* Glyph cache file. */
+   int cache_open; /**< Whether or not the cache file was read. */
+   int cache_dirty; /**< Whether or not glyphs were added since reading it. */
+   uint64_t cache_key; /**< Hash of the font files and rendering parameters. */
+   char *cache_data; /**< Contents of the cache file (array.h). */
+   glFontCacheEntry *cache_glyphs; /**< Index of the cached glyphs (array.h). */
+   int cache_lut[HASH_LUT_SIZE]; /**< Look up table of the cached glyphs. */
+
    int refcount; /**< Reference counting. */
 } glFontStash;
 
+
+/**
+ * @brief Vertex of a cached layout.
+ */
+typedef struct glFontLayoutVertex_s {
+   GLfloat x; /**< X position, in distance field units. */
+   GLfloat y; /**< Y position, in distance field units. */
+   GLfloat s; /**< Texture s coordinate. */
+   GLfloat t; /**< Texture t coordinate. */
+} glFontLayoutVertex;
+
+
+/**
+ * @brief Glyphs of a cached layout sharing texture and colour.
+ */
+typedef struct glFontLayoutRun_s {
+   GLuint tex; /**< Texture of the glyphs. */
+   int first; /**< First vertex. */
+   int count; /**< Number of vertices, may be 0 for trailing colour changes. */
+   int setcol; /**< Whether or not the run starts with a colour change. */
+   const glColour *col; /**< Colour to change to, NULL restores the base colour. */
+} glFontLayoutRun;
+
+
+/**
+ * @brief Laid out single line string.
+ */
+typedef struct glFontLayout_s {
+   char *text; /**< Text laid out. */
+   uint64_t hash; /**< Hash of the font, max and text. */
+   int font; /**< Font stash id. */
+   int max; /**< Width the text was limited to, -1 if none. */
+   int width; /**< Width of the drawn text. */
+   size_t ret; /**< Bytes of text drawn. */
+   glFontLayoutRun *runs; /**< Draw runs (array.h). */
+   glFontLayoutVertex *vert; /**< Vertices until uploaded (array.h). */
+   gl_vbo *vbo; /**< Uploaded vertices, created on first draw. */
+   unsigned int lastuse; /**< Frame the layout was last drawn. */
+   int next; /**< Stored as a linked list. */
+} glFontLayout;
+
+
+/**
+ * @brief String drawn once that will be laid out if drawn again.
+ */
+typedef struct glFontLayoutSeen_s {
+   uint64_t hash; /**< Hash of the font, max and text. */
+   unsigned int frame; /**< Frame the string was drawn. */
+} glFontLayoutSeen;
+
+
 /**
  * Available fonts stashes.
  */
@@ -168,6 +291,17 @@ static const glColour *font_lastCol    = NULL; /**< Stores last colour used (act
 static int font_restoreLast      = 0; /**< Restore last colour. */
 
 
+/* Layout cache. */
+static glFontLayout *font_layouts = NULL; /**< Cached layouts (array.h). */
+static int font_layoutLUT[FONT_LAYOUT_LUT]; /**< Look up table of the cached layouts. */
+static glFontLayoutSeen font_layoutSeen[FONT_LAYOUT_LUT]; /**< Strings waiting to be drawn again, by hash. */
+static unsigned int font_layoutFrame       = 0; /**< Current frame. */
+static unsigned int font_layoutHits        = 0; /**< Layout hits this frame. */
+static unsigned int font_layoutLookups     = 0; /**< Layout lookups this frame. */
+static unsigned int font_layoutHitsLast    = 0; /**< Layout hits last frame. */
+static unsigned int font_layoutLookupsLast = 0; /**< Layout lookups last frame. */
+
+
 /*
  * prototypes
  */
@@ -175,7 +309,34 @@ static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsign
 static size_t font_limitSize( glFontStash *stsh, int *width, const char *text, const int max );
 static const glColour* gl_fontGetColour( uint32_t ch );
 /* Get unicode glyphs from cache. */
+static int gl_fontFindGlyph( glFontStash *stsh, uint32_t ch );
 static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
+static glFontGlyph* gl_fontAddGlyph( glFontStash *stsh, font_char_t *ft_char, uint32_t ch );
+static int font_codepointCmp( const void *p1, const void *p2 );
+/* Generate glyphs. */
+static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch );
+static int font_makeSDF( void *data );
+static int font_loadChar( glFontStash *stsh, font_char_t *c, uint32_t ch );
+/* Glyph cache file. */
+static uint64_t font_hash( uint64_t h, const void *data, size_t len );
+static uint64_t font_hashFile( const char *fname );
+static void font_cacheOpen( glFontStash *stsh );
+static void font_cacheIndex( glFontStash *stsh, uint32_t ch, size_t offset );
+static void font_cachePath( const glFontStash *stsh, char *path, size_t len );
+static int font_cacheGet( glFontStash *stsh, font_char_t *c, uint32_t ch );
+static void font_cacheAdd( glFontStash *stsh, const font_char_t *c, uint32_t ch );
+static void font_cacheSave( glFontStash *stsh );
+static void font_cacheClose( glFontStash *stsh );
+/* Layout cache. */
+static uint64_t font_layoutHash( int font, int max, const char *text, size_t len );
+static glFontLayout* font_layoutFind( int font, int max, const char *text );
+static glFontLayout* font_layoutGet( glFontStash *stsh, int font, int max, const char *text );
+static int font_layoutBuild( glFontStash *stsh, glFontLayout *l );
+static void font_layoutRender( glFontStash *stsh, glFontLayout *l,
+      double x, double y, const glColour *c, double outlineR );
+static void font_layoutFree( glFontLayout *l );
+static void font_layoutIndex (void);
+static void font_layoutPurge( int font );
 /* Render.
  * TODO this should be changed to be more like font-stash (https://github.com/akrinke/Font-Stash)
  * In particular, instead of writing char by char, they should be batched up by textures and rendered
@@ -183,6 +344,7 @@ static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
  */
 static void gl_fontRenderStart( const glFontStash *stsh, double x, double y, const glColour *c, double outlineR );
 static int gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch, const glColour *c, int state );
+static void gl_fontRenderColour( const glColour *col, const glColour *c );
 static void gl_fontRenderEnd (void);
 /* Fussy layout concerns. */
 static void gl_fontKernStart (void);
@@ -287,12 +449,8 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
    /* Upload data. */
    glBindTexture( GL_TEXTURE_2D, tex->id );
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-   if (ch->dataf != NULL)
-      glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h,
-            GL_RED, GL_FLOAT, ch->dataf );
-   else
-      glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h,
-            GL_RED, GL_UNSIGNED_BYTE, ch->data );
+   glTexSubImage2D( GL_TEXTURE_2D, 0, gr->x, gr->y, ch->w, ch->h,
+         GL_RED, GL_UNSIGNED_BYTE, ch->data );
 
    /* Check for error. */
    gl_checkErr();
@@ -620,11 +778,19 @@ void gl_printRaw( const glFont *ft_font, double x, double y, const glColour* c,
    int s;
    size_t i;
    uint32_t ch;
+   glFontLayout *l;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   /* Use the cached layout if possible. */
+   l = font_layoutGet( stsh, ft_font->id, -1, text );
+   if (l != NULL) {
+      font_layoutRender( stsh, l, x, y, c, outlineR );
+      return;
+   }
+
    /* Render it. */
    s = 0;
    i = 0;
@@ -695,11 +861,19 @@ int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
    int s;
    size_t ret, i;
    uint32_t ch;
+   glFontLayout *l;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   /* Use the cached layout if possible. */
+   l = font_layoutGet( stsh, ft_font->id, max, text );
+   if (l != NULL) {
+      font_layoutRender( stsh, l, x, y, c, outlineR );
+      return l->ret;
+   }
+
    /* Limit size. */
    ret = font_limitSize( stsh, NULL, text, max );
 
@@ -770,11 +944,20 @@ int gl_printMidRaw(
    int n, s;
    size_t ret, i;
    uint32_t ch;
+   glFontLayout *l;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   /* Use the cached layout if possible. */
+   l = font_layoutGet( stsh, ft_font->id, width, text );
+   if (l != NULL) {
+      x += (double)(width - l->width)/2.;
+      font_layoutRender( stsh, l, x, y, c, outlineR );
+      return l->ret;
+   }
+
    /* limit size */
    n = 0;
    ret = font_limitSize( stsh, &n, text, width );
@@ -952,11 +1135,17 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
    GLfloat n;
    size_t i;
    uint32_t ch;
+   glFontLayout *l;
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   /* Strings that are drawn already have their width. */
+   l = font_layoutFind( ft_font->id, -1, text );
+   if (l != NULL)
+      return l->width;
+
    gl_fontKernStart();
    n = 0.;
    i = 0;
@@ -1070,6 +1259,15 @@ int gl_printHeight( const glFont *ft_font,
  *
  */
 /**
+ * @brief Renders a character with FreeType.
+ *
+ * Only rasterizes the glyph, font_makeSDF() has to be run on it afterwards to
+ * turn it into a distance field.
+ *
+ *    @param stsh Font stash to render with.
+ *    @param[out] c Character to fill.
+ *    @param ch Character to render.
+ *    @return 0 on success.
  */
 static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
 {
@@ -1112,7 +1310,7 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
 
       /* Store data. */
       c->data = NULL;
-      c->dataf = NULL;
+      c->sdf_max = 0.;
       if (bitmap.buffer == NULL) {
          /* Space characters tend to have no buffer. */
          b = 0;
@@ -1130,10 +1328,9 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
          for (v=0; v<h; v++)
             for (u=0; u<w; u++)
                buffer[ (b+v)*rw+(b+u) ] = bitmap.buffer[ v*w+u ];
-         /* Compute signed fdistance field with buffered glyph. */
-         c->dataf = make_distance_mapbf( buffer, rw, rh,
-               (double)(MAX_EFFECT_RADIUS*FONT_DISTANCE_FIELD_SIZE) / stsh->h);
-         free( buffer );
+         /* The signed distance field is computed later on the buffered glyph. */
+         c->data = buffer;
+         c->sdf_max = (double)(MAX_EFFECT_RADIUS*FONT_DISTANCE_FIELD_SIZE) / stsh->h;
       }
       c->w     = rw;
       c->h     = rh;
@@ -1149,6 +1346,55 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
 }
 
 
+/**
+ * @brief Turns a rasterized character into a signed distance field.
+ *
+ * Doesn't touch FreeType nor OpenGL so it can be run on the threadpool.
+ *
+ *    @param data Character to process (font_char_t).
+ *    @return 0 always.
+ */
+static int font_makeSDF( void *data )
+{
+   int i;
+   float *dataf;
+   font_char_t *c;
+
+   c = (font_char_t*) data;
+   if (c->sdf_max <= 0.)
+      return 0;
+
+   /* Textures are 8 bit anyway, so quantize back into the bitmap. */
+   dataf = make_distance_mapbf( c->data, c->w, c->h, c->sdf_max );
+   for (i=0; i<c->w*c->h; i++)
+      c->data[i] = (GLubyte) round( CLAMP( 0., 1., dataf[i] ) * 255. );
+   free( dataf );
+   c->sdf_max = 0.;
+   return 0;
+}
+
+
+/**
+ * @brief Loads a character from the cache file or generates it.
+ *
+ *    @param stsh Font stash to load from.
+ *    @param[out] c Character to fill.
+ *    @param ch Character to load.
+ *    @return 0 on success.
+ */
+static int font_loadChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
+{
+   if (font_cacheGet( stsh, c, ch ) == 0)
+      return 0;
+
+   if (font_makeChar( stsh, c, ch ))
+      return -1;
+   font_makeSDF( c );
+   font_cacheAdd( stsh, c, ch );
+   return 0;
+}
+
+
 /**
  * @brief Starts the rendering engine.
  */
@@ -1247,40 +1493,72 @@ static uint32_t hashint( uint32_t a )
 }
 
 /**
- * @brief Gets or caches a glyph to render.
+ * @brief Looks up a glyph that was already uploaded.
+ *
+ *    @param stsh Font stash to look in.
+ *    @param ch Character to look for.
+ *    @return Index of the glyph or -1 if not found.
  */
-static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+static int gl_fontFindGlyph( glFontStash *stsh, uint32_t ch )
 {
    int i;
-   unsigned int h;
 
    /* Use hash table and linked lists to find the glyph. */
-   h = hashint(ch) & (HASH_LUT_SIZE-1);
-   i = stsh->lut[h];
+   i = stsh->lut[ hashint(ch) & (HASH_LUT_SIZE-1) ];
    while (i != -1) {
       if (stsh->glyphs[i].codepoint == ch)
-         return &stsh->glyphs[i];
+         return i;
       i = stsh->glyphs[i].next;
    }
+   return -1;
+}
 
-   /* Glyph not found, have to generate. */
-   glFontGlyph *glyph;
+
+/**
+ * @brief Gets or caches a glyph to render.
+ */
+static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+{
+   int i;
    font_char_t ft_char;
-   int idx;
 
-   /* Load data from freetype. */
-   if (font_makeChar( stsh, &ft_char, ch ))
+   i = gl_fontFindGlyph( stsh, ch );
+   if (i != -1)
+      return &stsh->glyphs[i];
+
+   /* Glyph not found, have to load or generate. */
+   font_cacheOpen( stsh );
+   if (font_loadChar( stsh, &ft_char, ch ))
       return NULL;
 
+   return gl_fontAddGlyph( stsh, &ft_char, ch );
+}
+
+
+/**
+ * @brief Uploads a loaded character and adds it to the glyphs.
+ *
+ *    @param stsh Font stash to add to.
+ *    @param ft_char Character to upload, its data gets freed.
+ *    @param ch Character being added.
+ *    @return The new glyph.
+ */
+static glFontGlyph* gl_fontAddGlyph( glFontStash *stsh, font_char_t *ft_char, uint32_t ch )
+{
+   int i, idx;
+   unsigned int h;
+   glFontGlyph *glyph;
+
    /* Create new character. */
    glyph = &array_grow( &stsh->glyphs );
    glyph->codepoint = ch;
-   glyph->adv_x = ft_char.adv_x;
-   glyph->ft_index = ft_char.ft_index;
+   glyph->adv_x = ft_char->adv_x;
+   glyph->ft_index = ft_char->ft_index;
    glyph->next  = -1;
    idx = glyph - stsh->glyphs;
 
    /* Insert in linked list. */
+   h = hashint(ch) & (HASH_LUT_SIZE-1);
    i = stsh->lut[h];
    if (i == -1) {
       stsh->lut[h] = idx;
@@ -1296,15 +1574,416 @@ static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
    }
 
    /* Find empty texture and render char. */
-   gl_fontAddGlyphTex( stsh, &ft_char, glyph );
+   gl_fontAddGlyphTex( stsh, ft_char, glyph );
 
-   free(ft_char.data);
-   free(ft_char.dataf);
+   free(ft_char->data);
+   ft_char->data = NULL;
 
    return glyph;
 }
 
 
+/**
+ * @brief Compares two codepoints for qsort.
+ */
+static int font_codepointCmp( const void *p1, const void *p2 )
+{
+   uint32_t a, b;
+   a = *(const uint32_t*) p1;
+   b = *(const uint32_t*) p2;
+   return (a > b) - (a < b);
+}
+
+
+/**
+ * @brief Generates glyphs ahead of time.
+ *
+ * Characters not in the cache file are rasterized on the main thread, then
+ * their distance fields are computed on the threadpool.  Once all are done
+ * they are uploaded and the cache file is updated.
+ *
+ *    @param ft_font Font to prewarm (NULL defaults to gl_defFont).
+ *    @param charset UTF-8 characters to generate, NULL for printable ASCII.
+ *    @return Number of glyphs generated.
+ */
+int gl_fontPrewarm( const glFont *ft_font, const char *charset )
+{
+   int i, n;
+   size_t pos;
+   uint32_t ch;
+   uint32_t *codes;
+   font_char_t *chars, *c;
+   glFontStash *stsh;
+   ThreadQueue *queue;
+
+   if (ft_font == NULL)
+      ft_font = &gl_defFont;
+   stsh = gl_fontGetStash( ft_font );
+   font_cacheOpen( stsh );
+
+   /* Gather the missing characters. */
+   codes = array_create( uint32_t );
+   if (charset == NULL) {
+      for (ch=' '; ch<='~'; ch++)
+         array_push_back( &codes, ch );
+   }
+   else {
+      pos = 0;
+      while ((ch = u8_nextchar( charset, &pos )))
+         array_push_back( &codes, ch );
+   }
+
+   qsort( codes, array_size(codes), sizeof(uint32_t), font_codepointCmp );
+
+   /* Load them from the cache or rasterize them, codes is compacted to
+    * match chars as we go. */
+   chars = array_create_size( font_char_t, array_size(codes) );
+   n = 0;
+   for (i=0; i<array_size(codes); i++) {
+      ch = codes[i];
+      if ((i > 0) && (ch == codes[i-1]))
+         continue;
+      if (gl_fontFindGlyph( stsh, ch ) != -1)
+         continue;
+      c = &array_grow( &chars );
+      if ((font_cacheGet( stsh, c, ch ) != 0) && (font_makeChar( stsh, c, ch ) != 0)) {
+         array_resize( &chars, n );
+         continue;
+      }
+      codes[n++] = ch;
+   }
+
+   /* Compute the distance fields in parallel. */
+   queue = NULL;
+   for (i=0; i<array_size(chars); i++) {
+      if (chars[i].sdf_max <= 0.)
+         continue;
+      if (queue == NULL)
+         queue = vpool_create();
+      vpool_enqueue( queue, font_makeSDF, &chars[i] );
+   }
+   if (queue != NULL)
+      vpool_wait( queue );
+
+   /* Upload and update the cache. */
+   for (i=0; i<n; i++) {
+      font_cacheAdd( stsh, &chars[i], codes[i] );
+      gl_fontAddGlyph( stsh, &chars[i], codes[i] );
+   }
+   font_cacheSave( stsh );
+
+   array_free( chars );
+   array_free( codes );
+   return n;
+}
+
+
+/**
+ * @brief Generates the glyphs of the default fonts ahead of time.
+ *
+ * Covers printable ASCII and, for the proportional fonts, every character of
+ * the active translation.  Should be run again when the language changes.
+ */
+void gl_fontPrewarmLanguage (void)
+{
+   char *charset;
+
+   gl_fontPrewarm( &gl_defFont, NULL );
+   gl_fontPrewarm( &gl_smallFont, NULL );
+   gl_fontPrewarm( &gl_defFontMono, NULL );
+
+   /* The monospace font is only used for the console. */
+   charset = gettext_getCharset();
+   if (charset == NULL)
+      return;
+   gl_fontPrewarm( &gl_defFont, charset );
+   gl_fontPrewarm( &gl_smallFont, charset );
+   free( charset );
+}
+
+
+/**
+ * @brief Hashes data (64-bit FNV-1a).
+ *
+ *    @param h Hash so far.
+ *    @param data Data to hash.
+ *    @param len Length of the data.
+ *    @return The updated hash.
+ */
+static uint64_t font_hash( uint64_t h, const void *data, size_t len )
+{
+   size_t i;
+   const unsigned char *s;
+
+   s = (const unsigned char*) data;
+   for (i=0; i<len; i++) {
+      h ^= s[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Hashes the identity of a font file.
+ *
+ * Fonts can be several megabytes, so rather than their data this covers the
+ * path, the real directory, the size and the modification time, which change
+ * whenever the file is replaced or overridden.
+ *
+ *    @param fname Path of the font file.
+ *    @return Hash of the font file.
+ */
+static uint64_t font_hashFile( const char *fname )
+{
+   PHYSFS_Stat stat;
+   const char *dir;
+   uint64_t h;
+
+   h = font_hash( FONT_HASH_INIT, fname, strlen(fname)+1 );
+   dir = PHYSFS_getRealDir( fname );
+   if (dir != NULL)
+      h = font_hash( h, dir, strlen(dir)+1 );
+   if (PHYSFS_stat( fname, &stat )) {
+      h = font_hash( h, &stat.filesize, sizeof(stat.filesize) );
+      h = font_hash( h, &stat.modtime, sizeof(stat.modtime) );
+   }
+   return h;
+}
+
+
+/**
+ * @brief Gets the path of the cache file of a font stash.
+ */
+static void font_cachePath( const glFontStash *stsh, char *path, size_t len )
+{
+   nsnprintf( path, len, "%s"FONT_CACHE_DIR"%016"PRIx64".bin",
+         nfile_cachePath(), stsh->cache_key );
+}
+
+
+/**
+ * @brief Reads the cache file of a font stash if not done already.
+ *
+ * The key covers the font files (including fallbacks), the size and how the
+ * glyphs are rendered, so anything that changes the glyphs uses another file.
+ *
+ *    @param stsh Font stash to read the cache of.
+ */
+static void font_cacheOpen( glFontStash *stsh )
+{
+   int i, ok;
+   uint64_t h;
+   uint32_t v;
+   size_t bufsize, pos, len;
+   char *buf;
+   char path[PATH_MAX];
+   glFontCacheHeader hdr;
+   glFontCacheGlyph g;
+
+   if (stsh->cache_open)
+      return;
+   stsh->cache_open  = 1;
+   stsh->cache_dirty = 0;
+
+   /* Compute the key. */
+   h = FONT_HASH_INIT;
+   for (i=0; i<array_size(stsh->ft); i++)
+      h = font_hash( h, &stsh->ft[i].file->hash, sizeof(uint64_t) );
+   v = stsh->h;
+   h = font_hash( h, &v, sizeof(v) );
+   v = FONT_DISTANCE_FIELD_SIZE;
+   h = font_hash( h, &v, sizeof(v) );
+   v = MAX_EFFECT_RADIUS;
+   h = font_hash( h, &v, sizeof(v) );
+   v = FONT_CACHE_VERSION;
+   h = font_hash( h, &v, sizeof(v) );
+   stsh->cache_key = h;
+
+   for (i=0; i<HASH_LUT_SIZE; i++)
+      stsh->cache_lut[i] = -1;
+   stsh->cache_glyphs = array_create( glFontCacheEntry );
+
+   /* Start with an empty cache. */
+   memset( &hdr, 0, sizeof(hdr) );
+   strncpy( hdr.magic, FONT_CACHE_MAGIC, sizeof(hdr.magic) );
+   hdr.key = h;
+
+   /* Try to read the file. */
+   font_cachePath( stsh, path, sizeof(path) );
+   buf = NULL;
+   bufsize = 0;
+   if (nfile_fileExists( path ))
+      buf = nfile_readFile( &bufsize, path );
+   ok = (buf != NULL) && (bufsize >= sizeof(hdr)) &&
+         (memcmp( buf, &hdr, sizeof(hdr) ) == 0);
+   if (!ok) {
+      free( buf );
+      buf = (char*) &hdr;
+      bufsize = sizeof(hdr);
+   }
+
+   /* Index the glyphs, stopping at anything truncated. */
+   pos = sizeof(hdr);
+   while (pos + sizeof(g) <= bufsize) {
+      memcpy( &g, &buf[pos], sizeof(g) );
+      len = sizeof(g) + (size_t)MAX(g.w,0) * (size_t)MAX(g.h,0);
+      if (pos + len > bufsize)
+         break;
+      font_cacheIndex( stsh, g.codepoint, pos );
+      pos += len;
+   }
+
+   stsh->cache_data = array_create_size( char, pos );
+   array_resize( &stsh->cache_data, pos );
+   memcpy( stsh->cache_data, buf, pos );
+   if (ok)
+      free( buf );
+}
+
+
+/**
+ * @brief Adds a glyph record to the index of the cache.
+ *
+ *    @param stsh Font stash to add to.
+ *    @param ch Character of the record.
+ *    @param offset Offset of the record in the cache data.
+ */
+static void font_cacheIndex( glFontStash *stsh, uint32_t ch, size_t offset )
+{
+   unsigned int h;
+   glFontCacheEntry *e;
+
+   h = hashint(ch) & (HASH_LUT_SIZE-1);
+   e = &array_grow( &stsh->cache_glyphs );
+   e->codepoint   = ch;
+   e->offset      = offset;
+   e->next        = stsh->cache_lut[h];
+   stsh->cache_lut[h] = e - stsh->cache_glyphs;
+}
+
+
+/**
+ * @brief Loads a character from the cache.
+ *
+ *    @param stsh Font stash to load from.
+ *    @param[out] c Character to fill.
+ *    @param ch Character to load.
+ *    @return 0 on success, -1 if not cached.
+ */
+static int font_cacheGet( glFontStash *stsh, font_char_t *c, uint32_t ch )
+{
+   int i;
+   size_t n;
+   glFontCacheGlyph g;
+
+   i = stsh->cache_lut[ hashint(ch) & (HASH_LUT_SIZE-1) ];
+   while ((i != -1) && (stsh->cache_glyphs[i].codepoint != ch))
+      i = stsh->cache_glyphs[i].next;
+   if (i == -1)
+      return -1;
+
+   memcpy( &g, &stsh->cache_data[ stsh->cache_glyphs[i].offset ], sizeof(g) );
+   if ((g.ft_index < 0) || (g.ft_index >= array_size(stsh->ft)))
+      return -1;
+
+   n = (size_t)MAX(g.w,0) * (size_t)MAX(g.h,0);
+   c->data     = malloc( n );
+   memcpy( c->data, &stsh->cache_data[ stsh->cache_glyphs[i].offset + sizeof(g) ], n );
+   c->sdf_max  = 0.;
+   c->w        = g.w;
+   c->h        = g.h;
+   c->off_x    = g.off_x;
+   c->off_y    = g.off_y;
+   c->adv_x    = g.adv_x;
+   c->ft_index = g.ft_index;
+   return 0;
+}
+
+
+/**
+ * @brief Adds a generated character to the cache.
+ *
+ *    @param stsh Font stash to add to.
+ *    @param c Character to add, must already be a distance field.
+ *    @param ch Character being added.
+ */
+static void font_cacheAdd( glFontStash *stsh, const font_char_t *c, uint32_t ch )
+{
+   int i;
+   size_t pos, n;
+   glFontCacheGlyph g;
+
+   if (!stsh->cache_open || (c->sdf_max > 0.))
+      return;
+
+   /* Already there. */
+   i = stsh->cache_lut[ hashint(ch) & (HASH_LUT_SIZE-1) ];
+   while (i != -1) {
+      if (stsh->cache_glyphs[i].codepoint == ch)
+         return;
+      i = stsh->cache_glyphs[i].next;
+   }
+
+   memset( &g, 0, sizeof(g) );
+   g.codepoint = ch;
+   g.ft_index  = c->ft_index;
+   g.w         = c->w;
+   g.h         = c->h;
+   g.off_x     = c->off_x;
+   g.off_y     = c->off_y;
+   g.adv_x     = c->adv_x;
+
+   n   = (size_t)c->w * (size_t)c->h;
+   pos = array_size( stsh->cache_data );
+   array_resize( &stsh->cache_data, pos + sizeof(g) + n );
+   memcpy( &stsh->cache_data[pos], &g, sizeof(g) );
+   memcpy( &stsh->cache_data[pos+sizeof(g)], c->data, n );
+   font_cacheIndex( stsh, ch, pos );
+   stsh->cache_dirty = 1;
+}
+
+
+/**
+ * @brief Writes the cache file of a font stash if glyphs were added.
+ *
+ *    @param stsh Font stash to save the cache of.
+ */
+static void font_cacheSave( glFontStash *stsh )
+{
+   char path[PATH_MAX];
+
+   if (!stsh->cache_open || !stsh->cache_dirty)
+      return;
+
+   nsnprintf( path, sizeof(path), "%s"FONT_CACHE_DIR, nfile_cachePath() );
+   nfile_dirMakeExist( path );
+   font_cachePath( stsh, path, sizeof(path) );
+   if (nfile_writeFile( stsh->cache_data, array_size(stsh->cache_data), path ) != 0)
+      WARN(_("Unable to write glyph cache '%s'!"), path);
+   stsh->cache_dirty = 0;
+}
+
+
+/**
+ * @brief Saves and frees the cache of a font stash.
+ *
+ *    @param stsh Font stash to close the cache of.
+ */
+static void font_cacheClose( glFontStash *stsh )
+{
+   if (!stsh->cache_open)
+      return;
+
+   font_cacheSave( stsh );
+   array_free( stsh->cache_data );
+   stsh->cache_data = NULL;
+   array_free( stsh->cache_glyphs );
+   stsh->cache_glyphs = NULL;
+   stsh->cache_open = 0;
+}
+
+
 /**
  * @brief Call at the start of a string/line.
  */
@@ -1342,8 +2021,6 @@ static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph
 static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c, int state )
 {
    double scale;
-   double a;
-   const glColour *col;
    int kern_adv_x;
 
    /* Handle escape sequences. */
@@ -1351,15 +2028,7 @@ static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c
       return 1;
    }
    if (state == 1) {
-      col = gl_fontGetColour( ch );
-      a = (c==NULL) ? 1. : c->a;
-      if (col != NULL)
-         gl_uniformAColor(shaders.font.color, col, a );
-      else if (c==NULL)
-         gl_uniformColor(shaders.font.color, &cWhite);
-      else
-         gl_uniformColor(shaders.font.color, c);
-      font_lastCol = col;
+      gl_fontRenderColour( gl_fontGetColour( ch ), c );
       return 0;
    }
 
@@ -1396,6 +2065,27 @@ static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c
 }
 
 
+/**
+ * @brief Changes the colour when rendering, after an escape sequence.
+ *
+ *    @param col Colour of the escape sequence, NULL restores the base colour.
+ *    @param c Base colour of the text, NULL is white.
+ */
+static void gl_fontRenderColour( const glColour *col, const glColour *c )
+{
+   double a;
+
+   a = (c==NULL) ? 1. : c->a;
+   if (col != NULL)
+      gl_uniformAColor(shaders.font.color, col, a );
+   else if (c==NULL)
+      gl_uniformColor(shaders.font.color, &cWhite);
+   else
+      gl_uniformColor(shaders.font.color, c);
+   font_lastCol = col;
+}
+
+
 /**
  * @brief Ends the rendering engine.
  */
@@ -1410,6 +2100,366 @@ static void gl_fontRenderEnd (void)
 }
 
 
+/**
+ * @brief Hashes the key of a layout.
+ *
+ *    @param font Font stash id.
+ *    @param max Width the text is limited to, -1 if none.
+ *    @param text Text to lay out.
+ *    @param len Length of the text.
+ *    @return The hash of the key.
+ */
+static uint64_t font_layoutHash( int font, int max, const char *text, size_t len )
+{
+   uint64_t h;
+   h = font_hash( FONT_HASH_INIT, &font, sizeof(font) );
+   h = font_hash( h, &max, sizeof(max) );
+   return font_hash( h, text, len );
+}
+
+
+/**
+ * @brief Looks up a cached layout.
+ *
+ *    @param font Font stash id.
+ *    @param max Width the text is limited to, -1 if none.
+ *    @param text Text to look for.
+ *    @return The layout or NULL if not cached.
+ */
+static glFontLayout* font_layoutFind( int font, int max, const char *text )
+{
+   int i;
+   size_t len;
+   uint64_t h;
+   glFontLayout *l;
+
+   if ((font_layouts == NULL) || (text == NULL))
+      return NULL;
+   len = strlen( text );
+   if (len > FONT_LAYOUT_LEN)
+      return NULL;
+
+   h = font_layoutHash( font, max, text, len );
+   i = font_layoutLUT[ h & (FONT_LAYOUT_LUT-1) ];
+   while (i != -1) {
+      l = &font_layouts[i];
+      if ((l->hash == h) && (l->font == font) && (l->max == max) &&
+            (strcmp( l->text, text ) == 0))
+         return l;
+      i = l->next;
+   }
+   return NULL;
+}
+
+
+/**
+ * @brief Gets the layout of a string to draw, laying it out if needed.
+ *
+ *    @param stsh Font stash to use.
+ *    @param font Font stash id.
+ *    @param max Width to limit the text to, -1 if none.
+ *    @param text Text to draw.
+ *    @return The layout or NULL if it can't be cached and has to be drawn
+ *            character by character.
+ */
+static glFontLayout* font_layoutGet( glFontStash *stsh, int font, int max, const char *text )
+{
+   int idx;
+   size_t len;
+   uint64_t h;
+   glFontLayout *l;
+   glFontLayoutSeen *seen;
+
+   if (text == NULL)
+      return NULL;
+   len = strlen( text );
+   if (len > FONT_LAYOUT_LEN)
+      return NULL;
+
+   font_layoutLookups++;
+   l = font_layoutFind( font, max, text );
+   if (l != NULL) {
+      font_layoutHits++;
+      l->lastuse = font_layoutFrame;
+      return l;
+   }
+
+   /* Only lay out strings that were already drawn on an earlier frame. */
+   h     = font_layoutHash( font, max, text, len );
+   seen  = &font_layoutSeen[ h & (FONT_LAYOUT_LUT-1) ];
+   if ((seen->hash != h) || (seen->frame == font_layoutFrame)) {
+      seen->hash  = h;
+      seen->frame = font_layoutFrame;
+      return NULL;
+   }
+
+   /* Create the cache. */
+   if (font_layouts == NULL) {
+      font_layouts = array_create_size( glFontLayout, 64 );
+      font_layoutIndex();
+   }
+   /* Full, have to wait for some to expire. */
+   if (array_size(font_layouts) >= FONT_LAYOUT_MAX)
+      return NULL;
+
+   l = &array_grow( &font_layouts );
+   memset( l, 0, sizeof(glFontLayout) );
+   l->text     = strdup( text );
+   l->hash     = h;
+   l->font     = font;
+   l->max      = max;
+   l->lastuse  = font_layoutFrame;
+   if (font_layoutBuild( stsh, l )) {
+      font_layoutFree( l );
+      array_erase( &font_layouts, l, l+1 );
+      return NULL;
+   }
+
+   /* Insert at the head of the list. */
+   idx = l - font_layouts;
+   l->next = font_layoutLUT[ l->hash & (FONT_LAYOUT_LUT-1) ];
+   font_layoutLUT[ l->hash & (FONT_LAYOUT_LUT-1) ] = idx;
+   return l;
+}
+
+
+/**
+ * @brief Lays out a string, mirroring what gl_fontRenderGlyph does.
+ *
+ *    @param stsh Font stash to use.
+ *    @param l Layout to fill, with the key already set.
+ *    @return 0 on success.
+ */
+static int font_layoutBuild( glFontStash *stsh, glFontLayout *l )
+{
+   int j, s, kern_adv_x;
+   size_t i, len;
+   uint32_t ch;
+   GLfloat n, scale, px;
+   GLuint tex;
+   const GLshort *vert;
+   const GLfloat *texc;
+   glFontGlyph *glyph;
+   glFontLayoutRun *run;
+   glFontLayoutVertex *v;
+   const int quad[6] = { 0, 1, 2, 2, 1, 3 }; /* Triangle strip as triangles. */
+
+   /* Limit size. */
+   if (l->max >= 0)
+      len = font_limitSize( stsh, &l->width, l->text, l->max );
+   else
+      len = strlen( l->text );
+   l->ret   = len;
+   l->runs  = array_create( glFontLayoutRun );
+   l->vert  = array_create( glFontLayoutVertex );
+
+   scale = (GLfloat)stsh->h / FONT_DISTANCE_FIELD_SIZE;
+   gl_fontKernStart();
+   run   = NULL;
+   n     = 0.;
+   s     = 0;
+   i     = 0;
+   while ((ch = u8_nextchar( l->text, &i )) && (i <= len)) {
+      /* Escape sequences start a new run with a colour change. */
+      if ((ch == FONT_COLOUR_CODE) && (s==0)) {
+         s = 1;
+         continue;
+      }
+      if (s == 1) {
+         run         = &array_grow( &l->runs );
+         run->tex    = 0;
+         run->first  = array_size( l->vert );
+         run->count  = 0;
+         run->setcol = 1;
+         run->col    = gl_fontGetColour( ch );
+         s = 0;
+         continue;
+      }
+
+      glyph = gl_fontGetGlyph( stsh, ch );
+      if (glyph == NULL)
+         return -1;
+      kern_adv_x = gl_fontKernGlyph( stsh, ch, glyph );
+      n += kern_adv_x;
+
+      /* Texture changes need a new run too. */
+      tex = stsh->tex[glyph->tex_index].id;
+      if ((run == NULL) || ((run->count > 0) && (run->tex != tex))) {
+         run         = &array_grow( &l->runs );
+         run->first  = array_size( l->vert );
+         run->count  = 0;
+         run->setcol = 0;
+         run->col    = NULL;
+      }
+      run->tex = tex;
+
+      /* Copy the quad of the glyph at the pen position. */
+      px    = n / scale;
+      vert  = &stsh->vbo_vert_data[ 2*glyph->vbo_id ];
+      texc  = &stsh->vbo_tex_data[ 2*glyph->vbo_id ];
+      for (j=0; j<6; j++) {
+         v     = &array_grow( &l->vert );
+         v->x  = vert[ 2*quad[j] ] + px;
+         v->y  = vert[ 2*quad[j]+1 ];
+         v->s  = texc[ 2*quad[j] ];
+         v->t  = texc[ 2*quad[j]+1 ];
+      }
+      run->count += 6;
+
+      n += glyph->adv_x;
+   }
+
+   if (l->max < 0)
+      l->width = (int)round(n);
+   return 0;
+}
+
+
+/**
+ * @brief Renders a cached layout.
+ *
+ *    @param stsh Font stash of the layout.
+ *    @param l Layout to render.
+ *    @param x X position to put text at.
+ *    @param y Y position to put text at.
+ *    @param c Colour to use (uses white if NULL)
+ *    @param outlineR Radius in px of outline (-1 for default, 0 for none)
+ */
+static void font_layoutRender( glFontStash *stsh, glFontLayout *l,
+      double x, double y, const glColour *c, double outlineR )
+{
+   int i;
+   const glFontLayoutRun *run;
+
+   /* Upload on first use, the CPU copy is no longer needed afterwards. */
+   if ((l->vbo == NULL) && (array_size(l->vert) > 0)) {
+      l->vbo = gl_vboCreateStatic( sizeof(glFontLayoutVertex)*array_size(l->vert), l->vert );
+      array_free( l->vert );
+      l->vert = NULL;
+   }
+
+   gl_fontRenderStart( stsh, x, y, c, outlineR );
+   if (l->vbo != NULL) {
+      gl_vboActivateAttribOffset( l->vbo, shaders.font.vertex, 0,
+            2, GL_FLOAT, sizeof(glFontLayoutVertex) );
+      gl_vboActivateAttribOffset( l->vbo, shaders.font.tex_coord, 2*sizeof(GLfloat),
+            2, GL_FLOAT, sizeof(glFontLayoutVertex) );
+   }
+   gl_Matrix4_Uniform( shaders.font.projection, font_projection_mat );
+
+   for (i=0; i<array_size(l->runs); i++) {
+      run = &l->runs[i];
+      if (run->setcol)
+         gl_fontRenderColour( run->col, c );
+      if (run->count <= 0)
+         continue;
+      glBindTexture( GL_TEXTURE_2D, run->tex );
+      glDrawArrays( GL_TRIANGLES, run->first, run->count );
+   }
+   gl_fontRenderEnd();
+}
+
+
+/**
+ * @brief Frees the contents of a layout.
+ *
+ *    @param l Layout to free.
+ */
+static void font_layoutFree( glFontLayout *l )
+{
+   free( l->text );
+   array_free( l->runs );
+   array_free( l->vert );
+   if (l->vbo != NULL)
+      gl_vboDestroy( l->vbo );
+}
+
+
+/**
+ * @brief Rebuilds the look up table of the layouts.
+ */
+static void font_layoutIndex (void)
+{
+   int i, h;
+
+   for (i=0; i<FONT_LAYOUT_LUT; i++)
+      font_layoutLUT[i] = -1;
+   for (i=0; i<array_size(font_layouts); i++) {
+      h = font_layouts[i].hash & (FONT_LAYOUT_LUT-1);
+      font_layouts[i].next = font_layoutLUT[h];
+      font_layoutLUT[h] = i;
+   }
+}
+
+
+/**
+ * @brief Drops layouts from the cache.
+ *
+ *    @param font Font stash id to drop the layouts of, or -1 to drop those not
+ *           drawn in the last FONT_LAYOUT_TTL frames.
+ */
+static void font_layoutPurge( int font )
+{
+   int i, j;
+   glFontLayout *l;
+
+   if (font_layouts == NULL)
+      return;
+
+   j = 0;
+   for (i=0; i<array_size(font_layouts); i++) {
+      l = &font_layouts[i];
+      if ((font >= 0) ? (l->font == font) :
+            (font_layoutFrame - l->lastuse > FONT_LAYOUT_TTL)) {
+         font_layoutFree( l );
+         continue;
+      }
+      if (i != j)
+         font_layouts[j] = *l;
+      j++;
+   }
+   if (j == array_size(font_layouts))
+      return;
+
+   if (j == 0) {
+      array_free( font_layouts );
+      font_layouts = NULL;
+      return;
+   }
+   array_resize( &font_layouts, j );
+   font_layoutIndex();
+}
+
+
+/**
+ * @brief Marks the end of a frame for the layout cache.
+ *
+ * Updates the statistics and drops the layouts that are no longer drawn.
+ */
+void gl_fontFrameEnd (void)
+{
+   font_layoutHitsLast     = font_layoutHits;
+   font_layoutLookupsLast  = font_layoutLookups;
+   font_layoutHits         = 0;
+   font_layoutLookups      = 0;
+   font_layoutFrame++;
+   font_layoutPurge( -1 );
+}
+
+
+/**
+ * @brief Gets the layout cache statistics of the last frame.
+ *
+ *    @param[out] hits Number of strings drawn from the cache.
+ *    @param[out] lookups Number of strings drawn that could be cached.
+ */
+void gl_fontLayoutStats( unsigned int *hits, unsigned int *lookups )
+{
+   *hits    = font_layoutHitsLast;
+   *lookups = font_layoutLookupsLast;
+}
+
+
 /**
  * @brief Sets the minification and magnification filters for a font.
  *
@@ -1569,6 +2619,9 @@ static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsign
    FT_Matrix scale;
    int i, j;
 
+   /* Glyphs get another cache key. */
+   font_cacheClose( stsh );
+
    /* Set up file data. Reference a loaded copy if we have one. */
    ft = &array_grow( &stsh->ft );
    ft->file = NULL;
@@ -1594,6 +2647,7 @@ static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsign
          WARN(_("Unable to read font: %s"), fname );
          return -1;
       }
+      ft->file->hash = font_hashFile( fname );
    }
 
    /* Object which freetype uses to store font info. */
@@ -1651,6 +2705,9 @@ void gl_freeFont( glFont* font )
       return;
    /* Not references and must eliminate. */
 
+   font_cacheClose( stsh );
+   font_layoutPurge( font->id );
+
    for (i=0; i<array_size(stsh->ft); i++) {
       ft = &stsh->ft[i];
       if(--ft->file->refcount == 0) {
@@ -45,7 +45,11 @@ typedef struct glFontRestore_s {
  */
 int gl_fontInit( glFont* font, const char *fname, const unsigned int h, const char *prefix, unsigned int flags );
 int gl_fontAddFallback( glFont* font, const char *fname );
+int gl_fontPrewarm( const glFont *ft_font, const char *charset );
+void gl_fontPrewarmLanguage (void);
 void gl_freeFont( glFont* font );
+void gl_fontFrameEnd (void);
+void gl_fontLayoutStats( unsigned int *hits, unsigned int *lookups );
 
 
 /*
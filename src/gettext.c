@@ -25,6 +25,7 @@
 #include "log.h"
 #include "msgcat.h"
 #include "ndata.h"
+#include "utf8.h"
 
 
 typedef struct translation {
@@ -132,6 +133,63 @@ void gettext_setLanguage( const char* lang )
    gettext_activeTranslation = *ptrans = newtrans;
 }
 
+/**
+ * @brief Gets the characters used by the active translation.
+ *
+ * Meant for generating their glyphs ahead of time, so that they don't have to
+ * be generated the first time they are drawn.
+ *
+ * @return UTF-8 string with each non-ASCII character of the translations once
+ *         (must be freed), or NULL if there are none.
+ */
+char* gettext_getCharset (void)
+{
+   msgcat_t *chain;
+   const char *trans;
+   uint8_t *seen;
+   char *charset;
+   uint32_t i, ch;
+   size_t len, pos, n;
+   int j;
+
+   if (gettext_activeTranslation == NULL)
+      return NULL;
+   chain = gettext_activeTranslation->chain;
+
+   /* Mark the characters in a bitmap of all the code points. */
+   seen = calloc( 0x110000/8, 1 );
+   n = 0;
+   for (j=0; j<array_size(chain); j++) {
+      for (i=0; i<msgcat_nstrings( &chain[j] ); i++) {
+         trans = msgcat_translation( &chain[j], i, &len );
+         if (trans == NULL)
+            continue;
+         pos = 0;
+         while (pos < len) {
+            ch = u8_nextmemchar( trans, &pos );
+            if ((ch < 0x80) || (ch >= 0x110000) || (seen[ch/8] & (1<<(ch%8))))
+               continue;
+            seen[ch/8] |= 1<<(ch%8);
+            n++;
+         }
+      }
+   }
+   if (n == 0) {
+      free( seen );
+      return NULL;
+   }
+
+   /* Encode them, at most 4 bytes each. */
+   charset = malloc( 4*n+1 );
+   pos = 0;
+   for (ch=0x80; ch<0x110000; ch++)
+      if (seen[ch/8] & (1<<(ch%8)))
+         pos += u8_wc_toutf8( &charset[pos], ch );
+   charset[pos] = '\0';
+   free( seen );
+   return charset;
+}
+
 /**
  * @brief Return a translated version of the input, using the current language catalogs.
  *
@@ -14,6 +14,7 @@
 
 void gettext_init();
 void gettext_setLanguage( const char* lang );
+char* gettext_getCharset (void);
 
 const char* gettext_ngettext( const char* msgid, const char* msgid_plural, uint64_t n );
 FORMAT_ARG( 2 ) const char* gettext_pgettext( const char* lookup, const char* msgid );
@@ -19,6 +19,11 @@
  *  current Naev state which will most likely cause all the other hooks to fail.
  *
  * Therefore we must tread carefully. Hooks are serious business.
+ *
+ * Stack names are interned into ids and every stack keeps its own list of
+ * hooks, so running a stack only looks at its own hooks.  Timer hooks are
+ * also kept in a min-heap by expiry so the update only looks at those that
+ * expired.
  */
 
 
@@ -31,6 +36,7 @@
 
 #include "hook.h"
 
+#include "array.h"
 #include "claim.h"
 #include "event.h"
 #include "log.h"
@@ -42,6 +48,7 @@
 #include "nxml.h"
 #include "player.h"
 #include "space.h"
+#include "strindex.h"
 
 
 /**
@@ -76,9 +83,11 @@ typedef enum HookType_e {
  */
 typedef struct Hook_ {
    struct Hook_ *next; /**< Linked list. */
+   struct Hook_ *snext; /**< Linked list of the hooks of the same stack. */
 
    unsigned int id; /**< unique id */
-   char *stack; /**< stack it's a part of */
+   const char *stack; /**< stack it's a part of, owned by hook_stacks */
+   int stack_id; /**< Interned id of the stack. */
    int created; /**< Hook has just been created. */
    int delete; /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating. */
@@ -86,7 +95,8 @@ typedef struct Hook_ {
 
    /* Timer information. */
    int is_timer; /**< Whether or not is actually a timer. */
-   double ms; /**< Milliseconds left. */
+   double expire; /**< Value of hook_timer at which it expires. */
+   int heap_pos; /**< Position in hook_timers, -1 if not in it. */
 
    /* Date information. */
    int is_date; /**< Whether or not it is a date hook. */
@@ -107,6 +117,15 @@ typedef struct Hook_ {
 } Hook;
 
 
+/**
+ * @brief Hooks sharing a stack name.
+ */
+typedef struct HookStack_ {
+   char *name; /**< Name of the stack. */
+   Hook *list; /**< Hooks of the stack, linked by snext. */
+} HookStack;
+
+
 /*
  * the stack
  */
@@ -114,6 +133,11 @@ static unsigned int hook_id   = 0; /**< Unique hook id generator. */
 static Hook* hook_list        = NULL; /**< Stack of hooks. */
 static int hook_runningstack  = 0; /**< Check if stack is running. */
 static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
+static int hook_purge         = 0; /**< Whether or not some hooks are pending deletion. */
+static HookStack *hook_stacks = NULL; /**< Stacks by interned id (array.h). */
+static StrIndex *hook_stackIndex = NULL; /**< Maps stack names to ids. */
+static Hook **hook_timers     = NULL; /**< Min-heap of the timer hooks by expiry (array.h). */
+static double hook_timer      = 0.; /**< Milliseconds elapsed for the timer hooks. */
 
 
 /*
@@ -123,6 +147,8 @@ static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
 static int hooks_executeParam( const char* stack, HookParam *param );
 static void hooks_updateDateExecute( ntime_t change );
 /* intern */
+static int hook_stackID( const char *stack, int create );
+static void hook_setDelete( Hook *h );
 static void hook_rmRaw( Hook *h );
 static void hooks_purgeList (void);
 static Hook* hook_get( unsigned int id );
@@ -138,6 +164,13 @@ static int hook_parse( xmlNodePtr base );
 /* externed */
 int hook_save( xmlTextWriterPtr writer );
 int hook_load( xmlNodePtr parent );
+/* Timers. */
+static int hook_timerLess( const Hook *a, const Hook *b );
+static void hook_timerSwap( int i, int j );
+static void hook_timerSiftUp( int i );
+static void hook_timerSiftDown( int i );
+static void hook_timerPush( Hook *h );
+static void hook_timerRemove( Hook *h );
 /* Misc. */
 static Mission *hook_getMission( Hook *hook );
 
@@ -307,7 +340,7 @@ static int hook_runMisn( Hook *hook, HookParam *param, int claims )
    /* Make sure it's valid. */
    if (hook->u.misn.parent == 0) {
       WARN(_("Trying to run hook with nonexistent parent: deleting"));
-      hook->delete = 1; /* so we delete it */
+      hook_setDelete( hook ); /* so we delete it */
       return -1;
    }
 
@@ -315,7 +348,7 @@ static int hook_runMisn( Hook *hook, HookParam *param, int claims )
    misn = hook_getMission( hook );
    if (misn == NULL) {
       WARN(_("Trying to run hook with parent not in player mission stack: deleting"));
-      hook->delete = 1; /* so we delete it */
+      hook_setDelete( hook ); /* so we delete it */
       return -1;
    }
 
@@ -371,7 +404,7 @@ static int hook_runEvent( Hook *hook, HookParam *param, int claims )
    if (event_get(hook->u.event.parent) == NULL) {
       WARN(_("Hook [%s] '%d' -> '%s' failed, event does not exist. Deleting hook."), hook->stack,
             hook->id, hook->u.event.func);
-      hook->delete = 1; /* Set for deletion. */
+      hook_setDelete( hook ); /* Set for deletion. */
       return -1;
    }
 
@@ -427,7 +460,7 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
 
       default:
          WARN(_("Invalid hook type '%d', deleting."), hook->type);
-         hook->delete = 1;
+         hook_setDelete( hook );
          return -1;
    }
 
@@ -435,6 +468,146 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
 }
 
 
+/**
+ * @brief Gets the interned id of a stack.
+ *
+ *    @param stack Name of the stack.
+ *    @param create Whether or not to intern it if it's not known yet.
+ *    @return Id of the stack or -1 if not known and not created.
+ */
+static int hook_stackID( const char *stack, int create )
+{
+   int id;
+   HookStack *hs;
+
+   if (hook_stackIndex == NULL) {
+      if (!create)
+         return -1;
+      hook_stacks     = array_create( HookStack );
+      hook_stackIndex = strindex_create( 64 );
+   }
+
+   id = strindex_get( hook_stackIndex, stack );
+   if ((id >= 0) || !create)
+      return id;
+
+   hs       = &array_grow( &hook_stacks );
+   hs->name = strdup( stack );
+   hs->list = NULL;
+   id       = hs - hook_stacks;
+   strindex_add( hook_stackIndex, hs->name, id );
+   return id;
+}
+
+
+/**
+ * @brief Marks a hook for deletion, it gets freed by hooks_purgeList().
+ */
+static void hook_setDelete( Hook *h )
+{
+   h->delete   = 1;
+   hook_purge  = 1;
+}
+
+
+/**
+ * @brief Compares timer hooks by expiry, newest first when they tie like the stacks.
+ */
+static int hook_timerLess( const Hook *a, const Hook *b )
+{
+   if (a->expire != b->expire)
+      return (a->expire < b->expire);
+   return (a->id > b->id);
+}
+
+
+/**
+ * @brief Swaps two entries of the timer heap.
+ */
+static void hook_timerSwap( int i, int j )
+{
+   Hook *h;
+
+   h              = hook_timers[i];
+   hook_timers[i] = hook_timers[j];
+   hook_timers[j] = h;
+   hook_timers[i]->heap_pos = i;
+   hook_timers[j]->heap_pos = j;
+}
+
+
+/**
+ * @brief Moves an entry of the timer heap up into place.
+ */
+static void hook_timerSiftUp( int i )
+{
+   int p;
+
+   while (i > 0) {
+      p = (i-1) / 2;
+      if (!hook_timerLess( hook_timers[i], hook_timers[p] ))
+         break;
+      hook_timerSwap( i, p );
+      i = p;
+   }
+}
+
+
+/**
+ * @brief Moves an entry of the timer heap down into place.
+ */
+static void hook_timerSiftDown( int i )
+{
+   int c, n;
+
+   n = array_size( hook_timers );
+   while ((c = 2*i+1) < n) {
+      if ((c+1 < n) && hook_timerLess( hook_timers[c+1], hook_timers[c] ))
+         c++;
+      if (!hook_timerLess( hook_timers[c], hook_timers[i] ))
+         break;
+      hook_timerSwap( i, c );
+      i = c;
+   }
+}
+
+
+/**
+ * @brief Adds a timer hook to the heap.
+ */
+static void hook_timerPush( Hook *h )
+{
+   if (hook_timers == NULL)
+      hook_timers = array_create( Hook* );
+   h->heap_pos = array_size( hook_timers );
+   array_push_back( &hook_timers, h );
+   hook_timerSiftUp( h->heap_pos );
+}
+
+
+/**
+ * @brief Removes a timer hook from the heap.
+ */
+static void hook_timerRemove( Hook *h )
+{
+   int i, n;
+
+   i = h->heap_pos;
+   if (i < 0)
+      return;
+   n = array_size( hook_timers ) - 1;
+   if (i != n) {
+      hook_timerSwap( i, n );
+      array_resize( &hook_timers, n );
+      hook_timerSiftDown( i );
+      hook_timerSiftUp( i );
+   }
+   else
+      array_resize( &hook_timers, n );
+   h->heap_pos = -1;
+}
+
+
 /**
  * @brief Generates a new hook id.
  *
@@ -483,8 +656,14 @@ static Hook* hook_new( HookType_t type, const char *stack )
    /* Fill out generic details. */
    new_hook->type    = type;
    new_hook->id      = hook_genID();
-   new_hook->stack   = strdup(stack);
    new_hook->created = 1;
+   new_hook->heap_pos = -1;
+
+   /* Add to its stack, also at the front. */
+   new_hook->stack_id = hook_stackID( stack, 1 );
+   new_hook->stack   = hook_stacks[ new_hook->stack_id ].name;
+   new_hook->snext   = hook_stacks[ new_hook->stack_id ].list;
+   hook_stacks[ new_hook->stack_id ].list = new_hook;
 
    /** @TODO fix this hack. */
    if (strcmp(stack,"safe")==0)
@@ -561,7 +740,8 @@ unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms
 
    /* Timer information. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->expire        = hook_timer + ms;
+   hook_timerPush( new_hook );
 
    return new_hook->id;
 }
@@ -588,7 +768,8 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
 
    /* Timer information. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->expire        = hook_timer + ms;
+   hook_timerPush( new_hook );
 
    return new_hook->id;
 }
@@ -599,37 +780,40 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
  */
 static void hooks_purgeList (void)
 {
-   Hook *h, *hl;
+   int i;
+   Hook *h, **hp;
 
    /* Do not run while stack is being run. */
    if (hook_runningstack)
       return;
 
-   /* Second pass to delete. */
-   hl = NULL;
-   h  = hook_list;
-   while (h != NULL) {
-      /* Find valid timer hooks. */
-      if (h->delete) {
-
-         if (hl == NULL)
-            hook_list = h->next;
+   /* Nothing to delete. */
+   if (!hook_purge)
+      return;
+   hook_purge = 0;
+
+   /* Unlink from the stacks. */
+   for (i=0; i<array_size(hook_stacks); i++) {
+      hp = &hook_stacks[i].list;
+      while (*hp != NULL) {
+         if ((*hp)->delete)
+            *hp = (*hp)->snext;
          else
-            hl->next  = h->next;
+            hp = &(*hp)->snext;
+      }
+   }
 
-         /* Free. */
+   /* Second pass to delete. */
+   hp = &hook_list;
+   while (*hp != NULL) {
+      h = *hp;
+      if (h->delete) {
+         *hp = h->next;
          h->next = NULL;
          hook_free( h );
-
-         /* Last. */
-         h = hl;
       }
-
-      hl = h;
-      if (h == NULL)
-         h = hook_list;
       else
-         h = h->next;
+         hp = &h->next;
    }
 }
 
@@ -649,21 +833,26 @@ void hooks_updateDate( ntime_t change )
  */
 static void hooks_updateDateExecute( ntime_t change )
 {
-   int j;
+   int j, id;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
+   /* Date hooks are all on the "date" stack. */
+   id = hook_stackID( "date", 0 );
+   if (id < 0)
+      return;
+
    /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
+   for (h=hook_stacks[id].list; h!=NULL; h=h->snext)
       h->created = 0;
 
    /* On j=0 we increment all timers and try to run, then on j=1 we update the timers. */
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (h=hook_stacks[id].list; h!=NULL; h=h->snext) {
          /* Not be deleting. */
          if (h->delete)
             continue;
@@ -741,34 +930,38 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
  */
 void hooks_update( double dt )
 {
-   int j;
-   Hook *h;
+   int i, j;
+   double prev;
+   Hook *h, **due;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
-   /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   prev        = hook_timer;
+   hook_timer += dt;
+
+   /* Take out the expired timers, those created while running wait for the next update. */
+   due = NULL;
+   while ((array_size(hook_timers) > 0) && (hook_timers[0]->expire <= hook_timer)) {
+      h = hook_timers[0];
+      hook_timerRemove( h );
+      if (h->delete)
+         continue;
+      if (due == NULL)
+         due = array_create( Hook* );
+      array_push_back( &due, h );
+   }
 
+   /* On j=1 those that had already expired run if claimed, then on j=0 the rest. */
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (i=0; i<array_size(due); i++) {
+         h = due[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
-         /* Find valid timer hooks. */
-         if (h->is_timer == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==0)
-            h->ms -= dt;
-         if (h->ms > 0.)
+         if ((j==1) != (h->expire <= prev))
             continue;
 
          /* Run the timer hook. */
@@ -777,6 +970,7 @@ void hooks_update( double dt )
       }
    }
    hook_runningstack--; /* not running hooks anymore */
+   array_free( due );
 
    /* Second pass to delete. */
    hooks_purgeList();
@@ -819,7 +1013,7 @@ void hook_rm( unsigned int id )
  */
 static void hook_rmRaw( Hook *h )
 {
-   h->delete = 1;
+   hook_setDelete( h );
    hookL_unsetarg( h->id );
 }
 
@@ -835,7 +1029,7 @@ void hook_rmMisnParent( unsigned int parent )
 
    for (h=hook_list; h!=NULL; h=h->next)
       if ((h->type==HOOK_TYPE_MISN) && (parent == h->u.misn.parent))
-         h->delete = 1;
+         hook_setDelete( h );
 }
 
 
@@ -850,7 +1044,7 @@ void hook_rmEventParent( unsigned int parent )
 
    for (h=hook_list; h!=NULL; h=h->next)
       if ((h->type==HOOK_TYPE_EVENT) && (parent == h->u.event.parent))
-         h->delete = 1;
+         hook_setDelete( h );
 }
 
 
@@ -897,7 +1091,7 @@ int hook_hasEventParent( unsigned int parent )
 
 static int hooks_executeParam( const char* stack, HookParam *param )
 {
-   int j;
+   int j, id;
    int run;
    Hook *h;
 
@@ -905,17 +1099,21 @@ static int hooks_executeParam( const char* stack, HookParam *param )
    if ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED))
       return 0;
 
+   /* Nothing was ever hooked to it. */
+   id = hook_stackID( stack, 0 );
+   if (id < 0)
+      return 0;
+
    /* Reset the current stack's ran and creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (strcmp(stack, h->stack)==0) {
-         h->ran_once = 0;
-         h->created = 0;
-      }
+   for (h=hook_stacks[id].list; h!=NULL; h=h->snext) {
+      h->ran_once = 0;
+      h->created = 0;
+   }
 
    run = 0;
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (h=hook_stacks[id].list; h!=NULL; h=h->snext) {
          /* Should be deleted. */
          if (h->delete)
             continue;
@@ -925,9 +1123,6 @@ static int hooks_executeParam( const char* stack, HookParam *param )
          /* Don't update newly created hooks. */
          if (h->created != 0)
             continue;
-         /* Doesn't match stack. */
-         if (strcmp(stack, h->stack) != 0)
-            continue;
 
          /* Run hook. */
          hook_run( h, param, j );
@@ -1089,8 +1284,8 @@ static void hook_free( Hook *h )
    /* Remove from all the pilots. */
    pilots_rmHook( h->id );
 
-   /* Generic freeing. */
-   free( h->stack );
+   /* Generic freeing, the stack name belongs to hook_stacks. */
+   hook_timerRemove( h );
 
    /* Free type specific. */
    switch (h->type) {
@@ -1115,6 +1310,7 @@ static void hook_free( Hook *h )
  */
 void hook_cleanup (void)
 {
+   int i;
    Hook *h, *hn;
 
    if (hook_runningstack)
@@ -1131,6 +1327,18 @@ void hook_cleanup (void)
    }
    /* safe defaults just in case */
    hook_list  = NULL;
+   hook_purge = 0;
+
+   /* Clear the stacks and timers. */
+   for (i=0; i<array_size(hook_stacks); i++)
+      free( hook_stacks[i].name );
+   array_free( hook_stacks );
+   hook_stacks = NULL;
+   strindex_free( hook_stackIndex );
+   hook_stackIndex = NULL;
+   array_free( hook_timers );
+   hook_timers = NULL;
+   hook_timer  = 0.;
 }
 
 
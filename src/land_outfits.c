@@ -405,7 +405,7 @@ void outfits_update( unsigned int wid, char* str )
    outfit = iar_outfits[active][i];
 
    /* new image */
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 192, 192 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 192, 192 );
 
    if (outfit_canBuy(outfit->name, land_planet) > 0)
       window_enableButton( wid, "btnBuyOutfit" );
@@ -610,7 +610,7 @@ ImageArrayCell *outfits_imageArrayCells( Outfit **outfits, int *noutfits )
       for (i=0; i<*noutfits; i++) {
          o = outfits[i];
 
-         coutfits[i].image = gl_dupTexture( o->gfx_store );
+         coutfits[i].image = gl_dupTexture( outfit_gfxStore( o ) );
          coutfits[i].caption = strdup( _(o->name) );
          coutfits[i].quantity = player_outfitOwned(o);
 
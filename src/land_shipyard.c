@@ -164,6 +164,7 @@ void shipyard_open( unsigned int wid )
    else {
       for (i=0; i<nships; i++) {
          cships[i].caption = strdup( _(shipyard_list[i]->name) );
+         ship_gfxUse( shipyard_list[i] );
          cships[i].image = gl_dupTexture(shipyard_list[i]->gfx_store);
          cships[i].layers = gl_copyTexArray( shipyard_list[i]->gfx_overlays, &cships[i].nlayers );
          if (shipyard_list[i]->rarity > 0) {
@@ -240,6 +241,7 @@ void shipyard_update( unsigned int wid, char* str )
    shipyard_selected = ship;
 
    /* update image */
+   ship_gfxUse( ship );
    window_modifyImage( wid, "imgTarget", ship->gfx_store, 0, 0 );
 
    /* update text */
@@ -17,11 +17,13 @@
 #include "array.h"
 #include "colour.h"
 #include "dialogue.h"
+#include "economy.h"
 #include "faction.h"
 #include "gui.h"
 #include "log.h"
 #include "mapData.h"
 #include "map_find.h"
+#include "map_path.h"
 #include "map_system.h"
 #include "mission.h"
 #include "ndata.h"
@@ -38,9 +40,6 @@
 #define BUTTON_HEIGHT   30 /**< Map button height. */
 
 
-#define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before
-                                 aborting. */
-
 #define MAP_MARKER_CYCLE  750 /**< Time of a mission marker's animation cycle in milliseconds. */
 
 /* map decorator stack */
@@ -61,6 +60,7 @@ static Commodity **commod_known = NULL; /**< index of known commodities */
 static char** map_modes = NULL; /**< Array (array.h) of the map modes' names, e.g. "Gold: Cost". */
 static int listMapModeVisible = 0; /**< Whether the map mode list widget is visible. */
 static double commod_av_gal_price = 0; /**< Average price across the galaxy. */
+static double *commod_prices = NULL; /**< Average seen prices of the commodity being shown, by planet id (array.h). */
 /* VBO. */
 static gl_vbo *map_vbo = NULL; /**< Map VBO. */
 static gl_vbo *marker_vbo = NULL;
@@ -100,7 +100,9 @@ static void map_buttonCommodity( unsigned int wid, char* str );
 static void map_selectCur (void);
 static void map_genModeList(void);
 static void map_update_commod_av_price();
+static const double* map_commodPrices( const Commodity *c );
 static void map_window_close( unsigned int wid, char *str );
+static void map_freeDistances (void);
 
 
 /**
@@ -147,6 +149,11 @@ void map_exit (void)
       array_free( decorator_stack );
       decorator_stack = NULL;
    }
+
+   map_freeDistances();
+
+   array_free( commod_prices );
+   commod_prices = NULL;
 }
 
 
@@ -330,15 +337,15 @@ void map_open (void)
 static void map_update_commod_av_price()
 {
    Commodity *c;
-   int i,j,k;
+   int i,j;
    StarSystem *sys;
-   Planet *p;
    if (cur_commod == -1 || map_selected == -1) {
       commod_av_gal_price = 0;
       return;
    }
    c=commod_known[cur_commod];
    if ( cur_commod_mode !=0 ) {
+      const double *prices = map_commodPrices( c );
       double totPrice = 0;
       int totPriceCnt = 0;
       for (i=0; i<array_size(systems_stack); i++) {
@@ -353,16 +360,10 @@ static void map_update_commod_av_price()
             int sumCnt=0;
             double thisPrice;
             for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice+=thisPrice;
-                        sumCnt+=1;
-                        break;
-                     }
-                  }
+               thisPrice = prices[ sys->planets[j]->id ];
+               if ( thisPrice > 0 ) {/*commodity is known about*/
+                  sumPrice+=thisPrice;
+                  sumCnt+=1;
                }
             }
             if ( sumCnt>0 ) {
@@ -380,6 +381,26 @@ static void map_update_commod_av_price()
    }
 }
 
+/**
+ * @brief Gets the average seen prices of a commodity on all the planets.
+ *
+ *    @param c Commodity to get prices of.
+ *    @return Prices indexed by planet id, 0 where unknown.
+ */
+static const double* map_commodPrices( const Commodity *c )
+{
+   int n;
+
+   n = array_size( planet_getAll() );
+   if (commod_prices == NULL)
+      commod_prices = array_create_size( double, n );
+   array_resize( &commod_prices, n );
+   if (economy_getSeenPrices( c, commod_prices ) < 0)
+      memset( commod_prices, 0, n*sizeof(double) );
+   return commod_prices;
+}
+
+
 /**
  * @brief Updates the map window.
  *
@@ -1320,7 +1341,7 @@ void map_renderCommod( double bx, double by, double x, double y,
    int i,j,k;
    StarSystem *sys;
    double tx, ty;
-   Planet *p;
+   const double *prices;
    Commodity *c;
    glColour ccol;
    double best,worst,maxPrice,minPrice,curMaxPrice,curMinPrice,thisPrice;
@@ -1329,6 +1350,7 @@ void map_renderCommod( double bx, double by, double x, double y,
       return;
 
    c=commod_known[cur_commod];
+   prices = map_commodPrices( c );
    if ( cur_commod_mode == 0 ) {/*showing price difference to selected system*/
      /* Get commodity price in selected system.  If selected system is current
         system, and if landed, then get price of commodity where we are */
@@ -1336,15 +1358,13 @@ void map_renderCommod( double bx, double by, double x, double y,
       curMinPrice=0.;
       sys = system_getIndex( map_selected );
       if ( sys == cur_system && landed ) {
-         for ( k=0; k<array_size(land_planet->commodities); k++ ) {
-            if ( land_planet->commodities[k] == c ) {
-               /* current planet has the commodity of interest */
-               curMinPrice = land_planet->commodityPrice[k].sum / land_planet->commodityPrice[k].cnt;
-               curMaxPrice = curMinPrice;
-               break;
-            }
+         k = economy_commodityIndex( c, land_planet );
+         if ( k >= 0 ) {
+            /* current planet has the commodity of interest */
+            curMinPrice = land_planet->commodityPrice[k].sum / land_planet->commodityPrice[k].cnt;
+            curMaxPrice = curMinPrice;
          }
-         if ( k == array_size(land_planet->commodities) ) { /* commodity of interest not found */
+         else { /* commodity of interest not found */
             map_renderCommodIgnorance( x, y, sys, c );
             map_renderSysBlack(bx,by,x,y,w,h,r,editor);
             return;
@@ -1355,16 +1375,10 @@ void map_renderCommod( double bx, double by, double x, double y,
             minPrice=0;
             maxPrice=0;
             for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        if (thisPrice > maxPrice)maxPrice=thisPrice;
-                        if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
-                        break;
-                     }
-                  }
+               thisPrice = prices[ sys->planets[j]->id ];
+               if ( thisPrice > 0 ) {/*commodity is known about*/
+                  if (thisPrice > maxPrice)maxPrice=thisPrice;
+                  if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
                }
 
             }
@@ -1401,16 +1415,10 @@ void map_renderCommod( double bx, double by, double x, double y,
             minPrice=0;
             maxPrice=0;
             for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        if (thisPrice > maxPrice)maxPrice=thisPrice;
-                        if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
-                        break;
-                     }
-                  }
+               thisPrice = prices[ sys->planets[j]->id ];
+               if ( thisPrice > 0 ) {/*commodity is known about*/
+                  if (thisPrice > maxPrice)maxPrice=thisPrice;
+                  if (minPrice == 0 || thisPrice < minPrice)minPrice = thisPrice;
                }
             }
 
@@ -1463,16 +1471,10 @@ void map_renderCommod( double bx, double by, double x, double y,
             double sumPrice=0;
             int sumCnt=0;
             for ( j=0 ; j<array_size(sys->planets); j++) {
-               p=sys->planets[j];
-               for ( k=0; k<array_size(p->commodities); k++) {
-                  if ( p->commodities[k] == c ) {
-                     if ( p->commodityPrice[k].cnt > 0 ) {/*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice+=thisPrice;
-                        sumCnt+=1;
-                        break;
-                     }
-                  }
+               thisPrice = prices[ sys->planets[j]->id ];
+               if ( thisPrice > 0 ) {/*commodity is known about*/
+                  sumPrice+=thisPrice;
+                  sumCnt+=1;
                }
             }
 
@@ -2045,140 +2047,188 @@ void map_select( StarSystem *sys, char shifted )
    gui_setNav();
 }
 
-/*
- * A* algorithm for shortest path finding
- *
- * Note since that we can't actually get an admissible heurestic for A* this is
- * in reality just Djikstras. I've removed the heurestic bit to make sure I
- * don't try to implement an admissible heuristic when I'm pretty sure there is
- * none.
- */
 /**
- * @brief Node structure for A* pathfinding.
+ * @brief Jump distances from or to the current system.
+ *
+ * Computed on demand and kept until the current system or the player's
+ * knowledge of the jumps changes, see map_invalidateDistances().
  */
-typedef struct SysNode_ {
-   struct SysNode_ *next; /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem* sys; /**< System in node. */
-   int g; /**< step */
-} SysNode; /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
+typedef struct MapDistances_ {
+   int valid; /**< Whether or not the table is up to date. */
+   int source; /**< Id of the system it was computed for. */
+   int *dist; /**< Jumps by system id, -1 if unreachable (array.h). */
+   int *parent; /**< Previous system in the path by system id, forward only (array.h). */
+} MapDistances;
+static MapDistances map_dist[2][2][2]; /**< Tables by direction, ignore_known and show_hidden. */
+static int *map_distQueue  = NULL; /**< Work queue of the reverse search (array.h). */
+static int **map_distPred  = NULL; /**< Systems jumping into each system (array.h). */
+
 /* prototypes */
-static SysNode* A_newNode( StarSystem* sys );
-static int A_g( SysNode* n );
-static SysNode* A_add( SysNode *first, SysNode *cur );
-static SysNode* A_rm( SysNode *first, StarSystem *cur );
-static SysNode* A_in( SysNode *first, StarSystem *cur );
-static SysNode* A_lowest( SysNode *first );
-static void A_freeList( SysNode *first );
+static MapDistances* map_distances( int reverse, int ignore_known, int show_hidden );
 static int map_decorator_parse( MapDecorator *temp, xmlNodePtr parent );
-/** @brief Creates a new node link to star system. */
-static SysNode* A_newNode( StarSystem* sys )
-{
-   SysNode* n;
-
-   n        = malloc(sizeof(SysNode));
-
-   n->next  = NULL;
-   n->sys   = sys;
-
-   n->gnext = A_gc;
-   A_gc     = n;
-
-   return n;
-}
-/** @brief Gets the g from a node. */
-static int A_g( SysNode* n )
-{
-   return n->g;
-}
-/** @brief Adds a node to the linked list. */
-static SysNode* A_add( SysNode *first, SysNode *cur )
+/**
+ * @brief Gets the table of jump distances from or to the current system.
+ *
+ *    @param reverse Whether to get the distances to the current system instead
+ *           of from it.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return The table or NULL if there is no current system.
+ */
+static MapDistances* map_distances( int reverse, int ignore_known, int show_hidden )
 {
-   SysNode *n;
-
-   if (first == NULL)
-      return cur;
-
-   n = first;
-   while (n->next != NULL)
-      n = n->next;
-   n->next = cur;
+   int i, j, id, n, head;
+   JumpPoint *jp;
+   MapDistances *d;
 
-   return first;
-}
-/* @brief Removes a node from a linked list. */
-static SysNode* A_rm( SysNode *first, StarSystem *cur )
-{
-   SysNode *n, *p;
+   if (cur_system == NULL)
+      return NULL;
 
-   if (first->sys == cur) {
-      n = first->next;
-      first->next = NULL;
-      return n;
+   d = &map_dist[reverse!=0][ignore_known!=0][show_hidden!=0];
+   n = array_size(systems_stack);
+   if (d->valid && (d->source == cur_system->id) && (array_size(d->dist) == n))
+      return d;
+
+   if (d->dist == NULL)
+      d->dist = array_create_size( int, n );
+   array_resize( &d->dist, n );
+   for (i=0; i<n; i++)
+      d->dist[i] = -1;
+
+   if (!reverse) {
+      /* Same search as map_getJumpPath() so that the paths are identical. */
+      if (d->parent == NULL)
+         d->parent = array_create_size( int, n );
+      array_resize( &d->parent, n );
+      map_pathRun( cur_system, NULL, ignore_known, show_hidden );
+      for (i=0; i<n; i++) {
+         d->dist[i]   = map_pathJumps( i );
+         d->parent[i] = map_pathParent( i );
+      }
    }
+   else {
+      /* Breadth first search over the jumps going into each system. */
+      if (map_distPred == NULL)
+         map_distPred = array_create( int* );
+      for (i=n; i<array_size(map_distPred); i++)
+         array_free( map_distPred[i] );
+      for (i=array_size(map_distPred); i<n; i++)
+         array_push_back( &map_distPred, NULL );
+      array_resize( &map_distPred, n );
+      for (i=0; i<n; i++) {
+         if (map_distPred[i] == NULL)
+            map_distPred[i] = array_create( int );
+         array_resize( &map_distPred[i], 0 );
+      }
+      for (i=0; i<n; i++) {
+         for (j=0; j<array_size(systems_stack[i].jumps); j++) {
+            jp = &systems_stack[i].jumps[j];
+            if (map_pathCanJump( jp, ignore_known, show_hidden ))
+               array_push_back( &map_distPred[ jp->target->id ], i );
+         }
+      }
 
-   p = first;
-   n = p->next;
-   do {
-      if (n->sys == cur) {
-         n->next = NULL;
-         p->next = n->next;
-         break;
+      if (map_distQueue == NULL)
+         map_distQueue = array_create_size( int, n );
+      array_resize( &map_distQueue, 0 );
+      array_push_back( &map_distQueue, cur_system->id );
+      d->dist[ cur_system->id ] = 0;
+      for (head=0; head<array_size(map_distQueue); head++) {
+         id = map_distQueue[head];
+         for (j=0; j<array_size(map_distPred[id]); j++) {
+            i = map_distPred[id][j];
+            if (d->dist[i] >= 0)
+               continue;
+            d->dist[i] = d->dist[id] + 1;
+            array_push_back( &map_distQueue, i );
+         }
       }
-      p = n;
-   } while ((n=n->next) != NULL);
+   }
 
-   return first;
+   d->valid    = 1;
+   d->source   = cur_system->id;
+   return d;
 }
-/** @brief Checks to see if node is in linked list. */
-static SysNode* A_in( SysNode *first, StarSystem *cur )
-{
-   SysNode *n;
 
-   if (first == NULL)
-      return NULL;
+/**
+ * @brief Marks the cached jump distances as outdated.
+ *
+ * Must be called whenever the jumps or the player's knowledge of systems and
+ * jumps change.
+ */
+void map_invalidateDistances (void)
+{
+   int i, j, k;
 
-   n = first;
-   do {
-      if (n->sys == cur)
-         return n;
-   } while ((n=n->next) != NULL);
-   return NULL;
+   for (i=0; i<2; i++)
+      for (j=0; j<2; j++)
+         for (k=0; k<2; k++)
+            map_dist[i][j][k].valid = 0;
 }
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode* A_lowest( SysNode *first )
-{
-   SysNode *lowest, *n;
 
-   if (first == NULL)
-      return NULL;
+/**
+ * @brief Gets the amount of jumps from the current system to another.
+ *
+ * Answered from a table computed once per current system and knowledge state.
+ *
+ *    @param sys System to get the distance to.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Amount of jumps (0 for the current system) or -1 if unreachable.
+ */
+int map_jumpDistance( const StarSystem *sys, int ignore_known, int show_hidden )
+{
+   MapDistances *d;
 
-   n = first;
-   lowest = n;
-   do {
-      if (n->g < lowest->g)
-         lowest = n;
-   } while ((n=n->next) != NULL);
-   return lowest;
+   d = map_distances( 0, ignore_known, show_hidden );
+   if ((d == NULL) || (sys == NULL))
+      return -1;
+   return d->dist[ sys->id ];
 }
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
+
+/**
+ * @brief Gets the amount of jumps from a system to the current one.
+ *
+ *    @param sys System to get the distance from.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Amount of jumps (0 for the current system) or -1 if unreachable.
+ */
+int map_jumpDistanceTo( const StarSystem *sys, int ignore_known, int show_hidden )
 {
-   SysNode *p, *n;
+   MapDistances *d;
 
-   if (first == NULL)
-      return;
+   d = map_distances( 1, ignore_known, show_hidden );
+   if ((d == NULL) || (sys == NULL))
+      return -1;
+   return d->dist[ sys->id ];
+}
 
-   p = NULL;
-   n = first;
-   do {
-      free(p);
-      p = n;
-   } while ((n=n->gnext) != NULL);
-   free(p);
+/**
+ * @brief Frees the pathfinding data.
+ */
+static void map_freeDistances (void)
+{
+   int i, j, k;
+   MapDistances *d;
+
+   for (i=0; i<2; i++) {
+      for (j=0; j<2; j++) {
+         for (k=0; k<2; k++) {
+            d = &map_dist[i][j][k];
+            array_free( d->dist );
+            array_free( d->parent );
+            memset( d, 0, sizeof(MapDistances) );
+         }
+      }
+   }
+   for (i=0; i<array_size(map_distPred); i++)
+      array_free( map_distPred[i] );
+   array_free( map_distPred );
+   map_distPred = NULL;
+   array_free( map_distQueue );
+   map_distQueue = NULL;
+   map_pathFree();
 }
 
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
@@ -2202,16 +2252,10 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
     const char* sysend, int ignore_known, int show_hidden,
     StarSystem** old_data )
 {
-   int i, j, cost, ojumps;
-
-   StarSystem *sys, *ssys, *esys, **res;
-   JumpPoint *jp;
-
-   SysNode *cur,   *neighbour;
-   SysNode *open,  *closed;
-   SysNode *ocost, *ccost;
-
-   A_gc = NULL;
+   int i, id, ojumps, found;
+   const int *parent;
+   StarSystem *ssys, *esys, **res;
+   MapDistances *d;
 
    /* initial and target systems */
    ssys = system_get(sysstart); /* start */
@@ -2239,77 +2283,20 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
       return NULL;
    }
 
-   /* start the linked lists */
-   open     = closed = NULL;
-   cur      = A_newNode( ssys );
-   cur->parent = NULL;
-   cur->g   = 0;
-   open     = A_add( open, cur ); /* Initial open node is the start system */
-
-   j = 0;
-   while ((cur = A_lowest(open))) {
-      /* End condition. */
-      if (cur->sys == esys)
-         break;
-
-      /* Break if infinite loop. */
-      j++;
-      if (j > MAP_LOOP_PROT)
-         break;
-
-      /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost   = A_g(cur) + 1; /* Base unit is jump and always increases by 1. */
-
-      for (i=0; i<array_size(cur->sys->jumps); i++) {
-         jp  = &cur->sys->jumps[i];
-         sys = jp->target;
-
-         /* Make sure it's reachable */
-         if (!ignore_known) {
-            if (!jp_isKnown(jp))
-               continue;
-            if (!sys_isKnown(sys) && !space_sysReachable(sys))
-               continue;
-         }
-         if (jp_isFlag( jp, JP_EXITONLY ))
-            continue;
-
-         /* Skip hidden jumps if they're not specifically requested */
-         if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ))
-            continue;
-
-         /* Check to see if it's already in the closed set. */
-         ccost = A_in(closed, sys);
-         if ((ccost != NULL) && (cost >= A_g(ccost)))
-            continue;
-            //closed = A_rm( closed, sys );
-
-         /* Remove if it exists and current is better. */
-         ocost = A_in(open, sys);
-         if (ocost != NULL) {
-            if (cost < A_g(ocost))
-               open = A_rm( open, sys ); /* New path is better */
-            else
-               continue; /* This node is worse, so ignore it. */
-         }
-
-         /* Create the node. */
-         neighbour         = A_newNode( sys );
-         neighbour->parent = cur;
-         neighbour->g      = cost;
-         open              = A_add( open, neighbour );
-      }
-
-      /* Safety check in case not linked. */
-      if (open == NULL)
-         break;
+   /* Paths from the current system come from the cached table. */
+   d = (ssys == cur_system) ? map_distances( 0, ignore_known, show_hidden ) : NULL;
+   if (d != NULL) {
+      found  = (d->dist[ esys->id ] > 0);
+      parent = d->parent;
+   }
+   else {
+      found  = map_pathRun( ssys, esys, ignore_known, show_hidden );
+      parent = NULL;
    }
 
    /* Build path backwards if not broken from loop. */
-   if ( cur != NULL && esys == cur->sys ) {
-      (*njumps) = A_g(cur);
+   if (found) {
+      (*njumps) = (d != NULL) ? d->dist[ esys->id ] : map_pathJumps( esys->id );
       assert( *njumps > 0 );
       if (old_data == NULL)
          res      = malloc( sizeof(StarSystem*) * (*njumps) );
@@ -2318,9 +2305,10 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
          res      = realloc( old_data, sizeof(StarSystem*) * (*njumps) );
       }
       /* Build path. */
+      id = esys->id;
       for (i=0; i<((*njumps)-ojumps); i++) {
-         res[(*njumps)-i-1] = cur->sys;
-         cur                = cur->parent;
+         res[(*njumps)-i-1] = &systems_stack[id];
+         id = (parent != NULL) ? parent[id] : map_pathParent( id );
       }
    }
    else {
@@ -2329,8 +2317,6 @@ StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
       free( old_data );
    }
 
-   /* free the linked lists */
-   A_freeList(A_gc);
    return res;
 }
 
@@ -2355,6 +2341,7 @@ int map_map( const Outfit *map )
    for (i=0; i<array_size(map->u.map->jumps);i++)
       jp_setFlag(map->u.map->jumps[i], JP_KNOWN);
 
+   map_invalidateDistances();
    return 1;
 }
 
@@ -2423,6 +2410,7 @@ int localmap_map( const Outfit *lmap )
       if (mod*p->hide <= detect)
          planet_setKnown( p );
    }
+   map_invalidateDistances();
    return 0;
 }
 
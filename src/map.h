@@ -39,6 +39,9 @@ void map_jump (void);
 /* manipulate universe stuff */
 StarSystem **map_getJumpPath( int *njumps, const char *sysstart, const char *sysend, int ignore_known, int show_hidden,
                               StarSystem **old_data ) WARN_IF( *njumps < 0, "njumps must be >= 0" );
+int map_jumpDistance( const StarSystem *sys, int ignore_known, int show_hidden );
+int map_jumpDistanceTo( const StarSystem *sys, int ignore_known, int show_hidden );
+void map_invalidateDistances (void);
 int map_map( const Outfit *map );
 int map_isUseless( const Outfit* map );
 
@@ -0,0 +1,313 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+/**
+ * @file map_path.c
+ *
+ * @brief A* algorithm for shortest path finding between systems.
+ *
+ * Note since that we can't actually get an admissible heurestic for A* this is
+ * in reality just Djikstras. I've removed the heurestic bit to make sure I
+ * don't try to implement an admissible heuristic when I'm pretty sure there is
+ * none.
+ *
+ * The open set is a binary heap of system ids and the per-system state lives
+ * in an array indexed by system id, so that no list has to be scanned.  Ties
+ * are broken by the order systems were queued in, which gives the same paths
+ * as the previous list based implementation.
+ */
+
+
+/** @cond */
+#include <limits.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "map_path.h"
+
+#include "array.h"
+
+
+#define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before
+                                 aborting. */
+
+
+extern StarSystem *systems_stack; /**< Star system stack, defined in space.c. */
+
+
+/**
+ * @brief Node structure for A* pathfinding.
+ */
+typedef struct SysNode_ {
+   unsigned int search; /**< Search the node was last touched by. */
+   int parent; /**< Id of the parent system, -1 for the start. */
+   int g; /**< step */
+   int seq; /**< Order in which it was queued, to break ties. */
+   int pos; /**< Position in the open heap, -1 if not in it. */
+   int closed; /**< Whether or not it has been expanded. */
+} SysNode; /**< System Node for use in A* pathfinding. */
+
+
+static SysNode *A_nodes    = NULL; /**< Nodes indexed by system id (array.h). */
+static int *A_heap         = NULL; /**< Open set as a binary heap of system ids (array.h). */
+static unsigned int A_search = 0; /**< Current search, nodes of older ones are stale. */
+static int A_seq           = 0; /**< Queueing counter of the current search. */
+
+
+/*
+ * Prototypes.
+ */
+static SysNode* A_node( int id );
+static int A_less( int a, int b );
+static void A_swap( int i, int j );
+static void A_siftUp( int i );
+static void A_siftDown( int i );
+static void A_push( int id, int parent, int g );
+static int A_pop (void);
+
+
+/** @brief Gets the node of a system, resetting it if stale. */
+static SysNode* A_node( int id )
+{
+   SysNode *n;
+
+   n = &A_nodes[id];
+   if (n->search != A_search) {
+      n->search   = A_search;
+      n->parent   = -1;
+      n->g        = INT_MAX;
+      n->seq      = 0;
+      n->pos      = -1;
+      n->closed   = 0;
+   }
+   return n;
+}
+
+
+/** @brief Checks to see if a node has to be expanded before another. */
+static int A_less( int a, int b )
+{
+   if (A_nodes[a].g != A_nodes[b].g)
+      return (A_nodes[a].g < A_nodes[b].g);
+   return (A_nodes[a].seq < A_nodes[b].seq);
+}
+
+
+/** @brief Swaps two heap entries. */
+static void A_swap( int i, int j )
+{
+   int t;
+
+   t           = A_heap[i];
+   A_heap[i]   = A_heap[j];
+   A_heap[j]   = t;
+   A_nodes[ A_heap[i] ].pos = i;
+   A_nodes[ A_heap[j] ].pos = j;
+}
+
+
+/** @brief Moves a heap entry up to its place. */
+static void A_siftUp( int i )
+{
+   int p;
+
+   while (i > 0) {
+      p = (i-1) / 2;
+      if (!A_less( A_heap[i], A_heap[p] ))
+         break;
+      A_swap( i, p );
+      i = p;
+   }
+}
+
+
+/** @brief Moves a heap entry down to its place. */
+static void A_siftDown( int i )
+{
+   int l, m, n;
+
+   n = array_size(A_heap);
+   for (;;) {
+      l = 2*i + 1;
+      if (l >= n)
+         break;
+      m = ((l+1 < n) && A_less( A_heap[l+1], A_heap[l] )) ? l+1 : l;
+      if (!A_less( A_heap[m], A_heap[i] ))
+         break;
+      A_swap( i, m );
+      i = m;
+   }
+}
+
+
+/** @brief Adds a system to the open set or updates it if already there. */
+static void A_push( int id, int parent, int g )
+{
+   SysNode *n;
+
+   n           = A_node( id );
+   n->parent   = parent;
+   n->g        = g;
+   n->seq      = A_seq++;
+   if (n->pos < 0) {
+      n->pos = array_size(A_heap);
+      array_push_back( &A_heap, id );
+   }
+   /* Costs only ever decrease, but the new sequence number can move it down. */
+   A_siftUp( n->pos );
+   A_siftDown( n->pos );
+}
+
+
+/** @brief Takes the lowest ranking system out of the open set. */
+static int A_pop (void)
+{
+   int id, n;
+
+   n  = array_size(A_heap);
+   id = A_heap[0];
+   A_swap( 0, n-1 );
+   array_resize( &A_heap, n-1 );
+   A_nodes[id].pos = -1;
+   if (n > 1)
+      A_siftDown( 0 );
+   return id;
+}
+
+
+/** @brief Checks to see if a jump can be used by the pathfinding. */
+int map_pathCanJump( const JumpPoint *jp, int ignore_known, int show_hidden )
+{
+   /* Make sure it's reachable */
+   if (!ignore_known) {
+      if (!jp_isKnown(jp))
+         return 0;
+      if (!sys_isKnown(jp->target) && !space_sysReachable(jp->target))
+         return 0;
+   }
+   if (jp_isFlag( jp, JP_EXITONLY ))
+      return 0;
+
+   /* Skip hidden jumps if they're not specifically requested */
+   if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ))
+      return 0;
+
+   return 1;
+}
+
+
+/**
+ * @brief Runs the search, see map_pathJumps() and map_pathParent() for the results.
+ *
+ *    @param ssys System to start from.
+ *    @param esys System to end at, or NULL to expand everything reachable.
+ *    @return 1 if esys was reached.
+ */
+int map_pathRun( StarSystem *ssys, StarSystem *esys, int ignore_known, int show_hidden )
+{
+   int i, j, n, id, cost;
+   StarSystem *sys;
+   JumpPoint *jp;
+   SysNode *cur, *neighbour;
+
+   /* Start a new search, only wiping the nodes when the counter wraps. */
+   if (A_nodes == NULL)
+      A_nodes = array_create_size( SysNode, array_size(systems_stack) );
+   n = array_size(A_nodes);
+   if (n < array_size(systems_stack)) {
+      /* Grown tail is uninitialized and could alias the current search. */
+      array_resize( &A_nodes, array_size(systems_stack) );
+      memset( &A_nodes[n], 0, sizeof(SysNode) * (array_size(A_nodes)-n) );
+   }
+   if (++A_search == 0) {
+      memset( A_nodes, 0, sizeof(SysNode) * array_size(A_nodes) );
+      A_search = 1;
+   }
+   if (A_heap == NULL)
+      A_heap = array_create( int );
+   array_resize( &A_heap, 0 );
+   A_seq = 0;
+
+   A_push( ssys->id, -1, 0 ); /* Initial open node is the start system */
+
+   j = 0;
+   while (array_size(A_heap) > 0) {
+      /* Get best from open and toss to closed */
+      id          = A_pop();
+      cur         = &A_nodes[id];
+      cur->closed = 1;
+
+      /* End condition. */
+      if ((esys != NULL) && (id == esys->id))
+         return 1;
+
+      /* Break if infinite loop. */
+      j++;
+      if (j > MAP_LOOP_PROT)
+         break;
+
+      cost = cur->g + 1; /* Base unit is jump and always increases by 1. */
+      for (i=0; i<array_size(systems_stack[id].jumps); i++) {
+         jp  = &systems_stack[id].jumps[i];
+         sys = jp->target;
+         if (!map_pathCanJump( jp, ignore_known, show_hidden ))
+            continue;
+
+         /* Only keep it if the new path is better. */
+         neighbour = A_node( sys->id );
+         if (neighbour->closed || (cost >= neighbour->g))
+            continue;
+         A_push( sys->id, id, cost );
+      }
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Gets the jumps to a system found by the last search.
+ *
+ *    @param id Id of the system.
+ *    @return Jumps from the start system or -1 if the last search didn't
+ *            expand it.
+ */
+int map_pathJumps( int id )
+{
+   if ((id < 0) || (id >= array_size(A_nodes)) ||
+         (A_nodes[id].search != A_search) || !A_nodes[id].closed)
+      return -1;
+   return A_nodes[id].g;
+}
+
+
+/**
+ * @brief Gets the previous system in the path found by the last search.
+ *
+ *    @param id Id of the system.
+ *    @return Id of the previous system or -1 for the start system and the
+ *            systems the last search didn't expand.
+ */
+int map_pathParent( int id )
+{
+   if (map_pathJumps( id ) < 0)
+      return -1;
+   return A_nodes[id].parent;
+}
+
+
+/**
+ * @brief Frees the pathfinding state.
+ */
+void map_pathFree (void)
+{
+   array_free( A_nodes );
+   A_nodes = NULL;
+   array_free( A_heap );
+   A_heap = NULL;
+   A_search = 0;
+}
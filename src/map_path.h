@@ -0,0 +1,27 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef MAP_PATH_H
+#  define MAP_PATH_H
+
+
+#include "space.h"
+
+
+/*
+ * Searching.
+ */
+int map_pathCanJump( const JumpPoint *jp, int ignore_known, int show_hidden );
+int map_pathRun( StarSystem *ssys, StarSystem *esys, int ignore_known, int show_hidden );
+void map_pathFree (void);
+
+/*
+ * Results of the last search.
+ */
+int map_pathJumps( int id );
+int map_pathParent( int id );
+
+
+#endif /* MAP_PATH_H */
@@ -927,6 +927,7 @@ static void map_system_genShipsList( unsigned int wid, float goodsSpace, float o
    if (nships > 0) {
       cships = calloc( nships, sizeof(ImageArrayCell) );
       for ( i=0; i<nships; i++ ) {
+         ship_gfxUse( cur_planet_sel_ships[i] );
          cships[i].image = gl_dupTexture( cur_planet_sel_ships[i]->gfx_store );
          cships[i].caption = strdup( _(cur_planet_sel_ships[i]->name) );
       }
@@ -39,6 +39,7 @@
 #include "player.h"
 #include "rng.h"
 #include "space.h"
+#include "strindex.h"
 
 
 #define XML_MISSION_TAG       "mission" /**< XML mission tag. */
@@ -55,6 +56,7 @@ Mission *player_missions[MISSION_MAX]; /**< Player's active missions. */
  * mission stack
  */
 static MissionData *mission_stack = NULL; /**< Unmutable after creation */
+static StrIndex *mission_index = NULL; /**< Name index of the mission stack. */
 
 
 /*
@@ -109,9 +111,9 @@ int mission_getID( const char* name )
 {
    int i;
 
-   for (i=0; i<array_size(mission_stack); i++)
-      if (strcmp(name,mission_stack[i].name)==0)
-         return i;
+   i = strindex_get( mission_index, name );
+   if (i >= 0)
+      return i;
 
    DEBUG(_("Mission '%s' not found in stack"), name);
    return -1;
@@ -878,6 +880,11 @@ int missions_load (void)
    /* Sort based on priority so higher priority missions can establish claims first. */
    qsort( mission_stack, array_size(mission_stack), sizeof(MissionData), missions_cmp );
 
+   /* Index by name, once positions are final. */
+   mission_index = strindex_create( array_size(mission_stack) );
+   for (i=0; i<array_size(mission_stack); i++)
+      strindex_add( mission_index, mission_stack[i].name, i );
+
    DEBUG( n_("Loaded %d Mission", "Loaded %d Missions", array_size(mission_stack) ), array_size(mission_stack) );
 
    return 0;
@@ -978,6 +985,8 @@ void missions_free (void)
       mission_freeData( &mission_stack[i] );
    array_free( mission_stack );
    mission_stack = NULL;
+   strindex_free( mission_index );
+   mission_index = NULL;
 
    /* Free the player mission stack. */
    for (i=0; i<MISSION_MAX; i++)
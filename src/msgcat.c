@@ -48,6 +48,7 @@
 /* Internal implementations, corresponding to Musl's __pleval and __mo_lookup. */
 static uint64_t msgcat_plural_eval( const char *, uint64_t );
 static const char* msgcat_mo_lookup( const void *p, size_t size, const char *s );
+static inline uint32_t swapc(uint32_t x, int c);
 
 
 /* ==================== https://git.musl-libc.org/cgit/musl/tree/src/locale/dcngettext.c ===================== */
@@ -121,6 +122,44 @@ const char* msgcat_ngettext( const msgcat_t* p, const char* msgid1, const char*
 }
 
 
+/**
+ * @brief Gets the number of strings in the given message catalog.
+ */
+uint32_t msgcat_nstrings( const msgcat_t* p )
+{
+   const uint32_t *mo = p->map;
+   int sw = *mo - 0x950412de;
+   uint32_t n = swapc(mo[2], sw);
+   if (n >= p->map_size/4)
+      return 0;
+   return n;
+}
+
+/**
+ * @brief Gets a translation by its position in the message catalog.
+ *
+ * @param p The message catalog.
+ * @param i Position of the translation, less than msgcat_nstrings().
+ * @param[out] len Length of the translation, plural forms are separated by NUL characters.
+ * @return The translation, or NULL if the catalog is malformed.
+ */
+const char* msgcat_translation( const msgcat_t* p, uint32_t i, size_t *len )
+{
+   const uint32_t *mo = p->map;
+   int sw = *mo - 0x950412de;
+   uint32_t n = swapc(mo[2], sw);
+   uint32_t t = swapc(mo[4], sw);
+   if (i>=n || n>=p->map_size/4 || t>=p->map_size-4*n || (t%4))
+      return NULL;
+   t/=4;
+   uint32_t tl = swapc(mo[t+2*i], sw);
+   uint32_t ts = swapc(mo[t+2*i+1], sw);
+   if (ts >= p->map_size || tl >= p->map_size-ts)
+      return NULL;
+   *len = tl;
+   return (const char *)p->map + ts;
+}
+
 
 /* ===================== https://git.musl-libc.org/cgit/musl/tree/src/locale/__mo_lookup.c =================== */
 static inline uint32_t swapc(uint32_t x, int c)
@@ -18,5 +18,7 @@ typedef struct msgcat {
 
 void msgcat_init( msgcat_t* p, const void* map, size_t map_size );
 const char* msgcat_ngettext( const msgcat_t* p, const char* msgid1, const char* msgid2, uint64_t n );
+uint32_t msgcat_nstrings( const msgcat_t* p );
+const char* msgcat_translation( const msgcat_t* p, uint32_t i, size_t *len );
 
 #endif
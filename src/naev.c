@@ -72,12 +72,14 @@
 #include "physics.h"
 #include "pilot.h"
 #include "player.h"
+#include "prefetch.h"
 #include "rng.h"
 #include "semver.h"
 #include "ship.h"
 #include "slots.h"
 #include "sound.h"
 #include "space.h"
+#include "space_cache.h"
 #include "spfx.h"
 #include "start.h"
 #include "tech.h"
@@ -97,6 +99,8 @@ static unsigned int time_ms   = 0; /**< used to calculate FPS and movement. */
 static glTexture *loading     = NULL; /**< Loading screen. */
 static SDL_Surface *naev_icon = NULL; /**< Icon. */
 static int fps_skipped        = 0; /**< Skipped last frame? */
+static const char *load_stageMsg = NULL; /**< Message of the current loading stage. */
+static Uint64 load_stageStart = 0; /**< Start of the current loading stage. */
 /* Version stuff. */
 static semver_t version_binary; /**< Naev binary version. */
 //static semver_t version_data; /**< Naev data version. */
@@ -132,6 +136,8 @@ static void update_all (void);
 static void render_all (void);
 /* Misc. */
 static void loadscreen_render( double done, const char *msg );
+static void load_stage( double done, const char *msg );
+static void load_prefetch (void);
 void main_loop( int update ); /* dialogue.c */
 
 
@@ -281,6 +287,7 @@ int main( int argc, char** argv )
    gl_fontInit( &gl_defFont, _(FONT_DEFAULT_PATH), conf.font_size_def, FONT_PATH_PREFIX, 0 ); /* initializes default font to size */
    gl_fontInit( &gl_smallFont, _(FONT_DEFAULT_PATH), conf.font_size_small, FONT_PATH_PREFIX, 0 ); /* small font */
    gl_fontInit( &gl_defFontMono, _(FONT_MONOSPACE_PATH), conf.font_size_def, FONT_PATH_PREFIX, 0 );
+   gl_fontPrewarmLanguage();
 
    /* Detect size changes that occurred after window creation. */
    naev_resize();
@@ -584,43 +591,100 @@ static void loadscreen_unload (void)
 }
 
 
+/**
+ * @brief Starts a new loading stage, reporting the time taken by the previous one.
+ *
+ *    @param done Amount of loading done, from 0 to 1.
+ *    @param msg Message of the stage, NULL to just end the previous one.
+ */
+static void load_stage( double done, const char *msg )
+{
+   Uint64 t;
+
+   t = SDL_GetPerformanceCounter();
+   if (load_stageMsg != NULL)
+      DEBUG( _("%s took %.1f ms"), load_stageMsg,
+            1000. * (double)(t - load_stageStart) / (double)SDL_GetPerformanceFrequency() );
+
+   load_stageMsg   = msg;
+   load_stageStart = t;
+   if (msg != NULL)
+      loadscreen_render( done, msg );
+}
+
+
+/**
+ * @brief Queues the data files needed by the loaders to be read in the background.
+ *
+ * Queued in the order the loaders need them, so that the main thread rarely
+ * has to wait on the workers.
+ */
+static void load_prefetch (void)
+{
+   prefetch_xml( COMMODITY_DATA_PATH );
+   prefetch_xml( FACTION_DATA_PATH );
+   prefetch_imageDir( FACTION_LOGO_PATH );
+   prefetch_xml( SPFX_DATA_PATH );
+   prefetch_imageDir( SPFX_GFX_PATH );
+   prefetch_xml( DTYPE_DATA_PATH );
+   prefetch_xmlDir( OUTFIT_DATA_PATH );
+   prefetch_imageDir( OUTFIT_GFX_PATH"space/" );
+   prefetch_xmlDir( SHIP_DATA_PATH );
+   prefetch_xml( FLEET_DATA_PATH );
+   prefetch_xml( TECH_DATA_PATH );
+   prefetch_xmlDir( UNIDIFF_DATA_PATH );
+   /* Assets and systems are not parsed when the universe cache is used. */
+   if (!space_cacheFresh()) {
+      prefetch_xmlDir( PLANET_DATA_PATH );
+      prefetch_xmlDir( SYSTEM_DATA_PATH );
+   }
+}
+
+
 /**
  * @brief Loads all the data, makes main() simpler.
  */
 #define LOADING_STAGES     13. /**< Amount of loading stages. */
 void load_all (void)
 {
+   Uint64 start;
+
+   start = SDL_GetPerformanceCounter();
+
+   /* Parse and decode files on the threadpool while the loaders run. */
+   load_prefetch();
+
    /* We can do fast stuff here. */
    sp_load();
 
    /* order is very important as they're interdependent */
-   loadscreen_render( 1./LOADING_STAGES, _("Loading Commodities...") );
+   load_stage( 1./LOADING_STAGES, _("Loading Commodities...") );
    commodity_load(); /* dep for space */
-   loadscreen_render( 2./LOADING_STAGES, _("Loading Factions...") );
+   load_stage( 2./LOADING_STAGES, _("Loading Factions...") );
    factions_load(); /* dep for fleet, space, missions, AI */
-   loadscreen_render( 3./LOADING_STAGES, _("Loading AI...") );
+   load_stage( 3./LOADING_STAGES, _("Loading AI...") );
    ai_load(); /* dep for fleets */
-   loadscreen_render( 4./LOADING_STAGES, _("Loading Missions...") );
+   load_stage( 4./LOADING_STAGES, _("Loading Missions...") );
    missions_load(); /* no dep */
-   loadscreen_render( 5./LOADING_STAGES, _("Loading Events...") );
+   load_stage( 5./LOADING_STAGES, _("Loading Events...") );
    events_load(); /* no dep */
-   loadscreen_render( 6./LOADING_STAGES, _("Loading Special Effects...") );
+   load_stage( 6./LOADING_STAGES, _("Loading Special Effects...") );
    spfx_load(); /* no dep */
-   loadscreen_render( 6./LOADING_STAGES, _("Loading Damage Types...") );
+   load_stage( 6./LOADING_STAGES, _("Loading Damage Types...") );
    dtype_load(); /* no dep */
-   loadscreen_render( 7./LOADING_STAGES, _("Loading Outfits...") );
+   load_stage( 7./LOADING_STAGES, _("Loading Outfits...") );
    outfit_load(); /* dep for ships */
-   loadscreen_render( 8./LOADING_STAGES, _("Loading Ships...") );
+   load_stage( 8./LOADING_STAGES, _("Loading Ships...") );
    ships_load(); /* dep for fleet */
-   loadscreen_render( 9./LOADING_STAGES, _("Loading Fleets...") );
+   load_stage( 9./LOADING_STAGES, _("Loading Fleets...") );
    fleet_load(); /* dep for space */
-   loadscreen_render( 10./LOADING_STAGES, _("Loading Techs...") );
+   load_stage( 10./LOADING_STAGES, _("Loading Techs...") );
    tech_load(); /* dep for space */
-   loadscreen_render( 11./LOADING_STAGES, _("Loading the Universe...") );
+   load_stage( 11./LOADING_STAGES, _("Loading the Universe...") );
    space_load();
-   loadscreen_render( 12./LOADING_STAGES, _("Loading the UniDiffs...") );
+   load_stage( 12./LOADING_STAGES, _("Loading the UniDiffs...") );
    diff_loadAvailable();
-   loadscreen_render( 13./LOADING_STAGES, _("Populating Maps...") );
+   load_stage( 13./LOADING_STAGES, _("Populating Maps...") );
    outfit_mapParse();
    background_init();
    map_load();
@@ -628,7 +692,14 @@ void load_all (void)
    pilots_init();
    weapon_init();
    player_init(); /* Initialize player stuff. */
+   load_stage( 1., NULL );
+
+   /* Anything not claimed by a loader is no longer needed. */
+   prefetch_free();
+
    loadscreen_render( 1., _("Loading Completed!") );
+   DEBUG( _("Loaded data in %.1f ms"),
+         1000. * (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency() );
 }
 /**
  * @brief Unloads all data, simplifies main().
@@ -883,6 +954,7 @@ static void update_all (void)
  *
  *    @param[in] dt Current delta tick.
  *    @param[in] enter_sys Whether this is the initial update upon entering the system.
+ *                         Visual only updates are skipped in that case.
  */
 void update_routine( double dt, int enter_sys )
 {
@@ -896,11 +968,13 @@ void update_routine( double dt, int enter_sys )
    /* Update engine stuff. */
    space_update(dt);
    weapons_update(dt);
-   spfx_update(dt);
+   if (!enter_sys)
+      spfx_update(dt);
    pilots_update(dt);
 
    /* Update camera. */
-   cam_update( dt );
+   if (!enter_sys)
+      cam_update( dt );
 
    if (!enter_sys)
       hook_exclusionEnd( dt );
@@ -959,6 +1033,9 @@ static void render_all (void)
 
    /* check error every loop */
    gl_checkErr();
+
+   gl_renderFrameEnd();
+   gl_fontFrameEnd();
 }
 
 
@@ -973,6 +1050,7 @@ static void display_fps( const double dt )
 {
    double x,y;
    double dt_mod_base = 1.;
+   unsigned int hits, lookups, misses;
 
    fps_dt  += dt;
    fps_cur += 1.;
@@ -986,6 +1064,19 @@ static void display_fps( const double dt )
    if (conf.fps_show) {
       gl_print( NULL, x, y, NULL, "%3.2f", fps );
       y -= gl_defFont.h + 5.;
+      gl_print( NULL, x, y, NULL, _("%u draws"), gl_renderDrawCalls() );
+      y -= gl_defFont.h + 5.;
+      gl_fontLayoutStats( &hits, &lookups );
+      if (lookups > 0) {
+         gl_print( NULL, x, y, NULL, _("%.0f%% text cache hits"), 100. * (double)hits / (double)lookups );
+         y -= gl_defFont.h + 5.;
+      }
+      cond_stats( &hits, &misses );
+      if ((hits > 0) || (misses > 0)) {
+         gl_print( NULL, x, y, NULL, _("%.0f%% conditional cache hits"),
+               100. * (double)hits / ((double)hits + (double)misses) );
+         y -= gl_defFont.h + 5.;
+      }
    }
 
    if ((player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
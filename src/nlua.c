@@ -16,6 +16,7 @@
 
 #include "nlua.h"
 
+#include "array.h"
 #include "log.h"
 #include "lutf8lib.h"
 #include "ndata.h"
@@ -41,15 +42,41 @@
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "strindex.h"
+
+
+/**
+ * @brief Compiled Lua chunk kept around to skip the parser on reloads.
+ */
+typedef struct LuaChunk_ {
+   char *key; /**< Source name, length and hash of the chunk. */
+   char *data; /**< Dumped bytecode. */
+   size_t size; /**< Size of the bytecode. */
+} LuaChunk;
+
+
+/**
+ * @brief Buffer used to collect the output of lua_dump.
+ */
+typedef struct LuaDump_ {
+   char *data; /**< Bytecode written so far. */
+   size_t size; /**< Bytes used. */
+   size_t cap; /**< Bytes allocated. */
+} LuaDump;
 
 
 lua_State *naevL = NULL;
 nlua_env __NLUA_CURENV = LUA_NOREF;
+static LuaChunk *lua_chunks = NULL; /**< Compiled chunk cache. */
+static StrIndex *lua_chunk_index = NULL; /**< Key index of the chunk cache. */
 
 
 /*
  * prototypes
  */
+static int nlua_loadbuffer( lua_State *L, const char *buff, size_t sz, const char *name );
+static int nlua_dumpWriter( lua_State *L, const void *p, size_t sz, void *ud );
+static void nlua_chunksFree (void);
 static int nlua_require( lua_State* L );
 static lua_State *nlua_newState (void); /* creates a new state */
 static int nlua_loadBasic( lua_State* L );
@@ -133,6 +160,99 @@ void lua_init(void) {
 void lua_exit(void) {
    lua_close(naevL);
    naevL = NULL;
+   nlua_chunksFree();
+}
+
+
+/**
+ * @brief Frees the compiled chunk cache.
+ */
+static void nlua_chunksFree (void)
+{
+   int i;
+   for (i=0; i<array_size(lua_chunks); i++) {
+      free( lua_chunks[i].key );
+      free( lua_chunks[i].data );
+   }
+   array_free( lua_chunks );
+   lua_chunks = NULL;
+   strindex_free( lua_chunk_index );
+   lua_chunk_index = NULL;
+}
+
+
+/**
+ * @brief lua_Writer that appends the bytecode to a LuaDump.
+ */
+static int nlua_dumpWriter( lua_State *L, const void *p, size_t sz, void *ud )
+{
+   LuaDump *dump = (LuaDump*) ud;
+
+   if (dump->size+sz > dump->cap) {
+      dump->cap  = MAX( 2*dump->cap, dump->size+sz );
+      dump->data = realloc( dump->data, dump->cap );
+   }
+   memcpy( &dump->data[ dump->size ], p, sz );
+   dump->size += sz;
+   return 0;
+}
+
+
+/**
+ * @brief Loads a chunk, going through the compiled chunk cache.
+ *
+ * Chunks are keyed by their name, length and a hash of their source, so
+ * an edited file or different source under the same name gets recompiled.
+ * Behaves like luaL_loadbuffer.
+ *
+ *    @param L Lua state to load the chunk into.
+ *    @param buff Source of the chunk.
+ *    @param sz Size of the source.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, Lua error code on failure.
+ */
+static int nlua_loadbuffer( lua_State *L, const char *buff, size_t sz, const char *name )
+{
+   char key[PATH_MAX];
+   uint64_t hash;
+   size_t i;
+   int ret, idx;
+   LuaDump dump;
+   LuaChunk *chunk;
+
+   /* 64-bit FNV-1a of the source. */
+   hash = 14695981039346656037ULL;
+   for (i=0; i<sz; i++) {
+      hash ^= (unsigned char) buff[i];
+      hash *= 1099511628211ULL;
+   }
+   nsnprintf( key, sizeof(key), "%016"PRIx64"%zx:%s", hash, sz, name );
+
+   /* Cache hit, skip the parser. */
+   idx = strindex_get( lua_chunk_index, key );
+   if (idx >= 0)
+      return luaL_loadbuffer( L, lua_chunks[idx].data, lua_chunks[idx].size, name );
+
+   ret = luaL_loadbuffer( L, buff, sz, name );
+   if (ret != 0)
+      return ret;
+
+   /* Store the bytecode for next time. */
+   memset( &dump, 0, sizeof(dump) );
+   if ((lua_dump( L, nlua_dumpWriter, &dump ) != 0) || (dump.data == NULL)) {
+      free( dump.data );
+      return 0;
+   }
+   if (lua_chunks == NULL) {
+      lua_chunks      = array_create( LuaChunk );
+      lua_chunk_index = strindex_create( 0 );
+   }
+   chunk       = &array_grow( &lua_chunks );
+   chunk->key  = strdup( key );
+   chunk->data = dump.data;
+   chunk->size = dump.size;
+   strindex_add( lua_chunk_index, chunk->key, array_size(lua_chunks)-1 );
+   return 0;
 }
 
 
@@ -148,7 +268,7 @@ int nlua_dobufenv(nlua_env env,
                   const char *buff,
                   size_t sz,
                   const char *name) {
-   if (luaL_loadbuffer(naevL, buff, sz, name) != 0)
+   if (nlua_loadbuffer(naevL, buff, sz, name) != 0)
       return -1;
    nlua_pushenv(env);
    lua_setfenv(naevL, -2);
@@ -493,7 +613,7 @@ static int nlua_require( lua_State* L )
    }
 
    /* Try to process the Lua. */
-   if (luaL_loadbuffer(L, buf, bufsize, path_filename) != 0) {
+   if (nlua_loadbuffer(L, buf, bufsize, path_filename) != 0) {
       lua_error(L);
       return 1;
    }
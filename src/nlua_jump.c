@@ -21,6 +21,7 @@
 #include "nlua_system.h"
 #include "land_outfits.h"
 #include "log.h"
+#include "map.h"
 
 
 RETURNS_NONNULL static JumpPoint *luaL_validjumpSystem( lua_State *L, int ind, int *offset );
@@ -447,8 +448,10 @@ static int jumpL_setKnown( lua_State *L )
       jp_rmFlag( jp, JP_KNOWN );
 
    /* Update outfits image array. */
-   if (changed)
+   if (changed) {
+      map_invalidateDistances();
       outfits_updateEquipmentOutfits();
+   }
 
    return 0;
 }
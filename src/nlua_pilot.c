@@ -116,6 +116,8 @@ static int pilotL_setNoJump( lua_State *L );
 static int pilotL_setNoLand( lua_State *L );
 static int pilotL_addOutfit( lua_State *L );
 static int pilotL_rmOutfit( lua_State *L );
+static int pilotL_outfitsBegin( lua_State *L );
+static int pilotL_outfitsCommit( lua_State *L );
 static int pilotL_setFuel( lua_State *L );
 static int pilotL_changeAI( lua_State *L );
 static int pilotL_setTemp( lua_State *L );
@@ -223,6 +225,8 @@ static const luaL_Reg pilotL_methods[] = {
    /* Outfits. */
    { "addOutfit", pilotL_addOutfit },
    { "rmOutfit", pilotL_rmOutfit },
+   { "outfitsBegin", pilotL_outfitsBegin },
+   { "outfitsCommit", pilotL_outfitsCommit },
    { "setFuel", pilotL_setFuel },
    /* Ship. */
    { "ship", pilotL_ship },
@@ -2412,7 +2416,7 @@ static int pilotL_addOutfit( lua_State *L )
 
       /* Add outfit - already tested. */
       ret = pilot_addOutfitRaw( p, o, p->outfits[i] );
-      pilot_calcStats( p );
+      pilot_outfitsAdded( p, o );
 
       /* Add ammo if needed. */
       if ((ret==0) && (outfit_ammo(o) != NULL))
@@ -2423,8 +2427,8 @@ static int pilotL_addOutfit( lua_State *L )
       added++;
    }
 
-   /* Update the weapon sets. */
-   if ((added > 0) && p->autoweap)
+   /* Update the weapon sets, batches do it when committed. */
+   if ((added > 0) && p->autoweap && (p->outfit_batch <= 0))
       pilot_weaponAuto(p);
 
    /* Update equipment window if operating on the player's pilot. */
@@ -2524,6 +2528,52 @@ static int pilotL_rmOutfit( lua_State *L )
 }
 
 
+/**
+ * @brief Starts adding outfits to a pilot in a batch.
+ *
+ * Until the batch is committed, pilot.addOutfit only updates the CPU usage of
+ * the pilot, and the rest of the stats and the weapon sets are recalculated
+ * once by pilot.outfitsCommit. Other stats such as the cargo space are not up
+ * to date until then. Batches may be nested.
+ *
+ * @usage p:outfitsBegin()
+ * @usage p:addOutfit( "Laser Cannon MK1", 2 )
+ * @usage p:addOutfit( "Unicorp Fury Launcher" )
+ * @usage p:outfitsCommit()
+ *
+ *    @luatparam Pilot p Pilot to start the batch of.
+ * @luafunc outfitsBegin
+ */
+static int pilotL_outfitsBegin( lua_State *L )
+{
+   Pilot *p;
+   NLUA_CHECKRW(L);
+   p = luaL_validpilot(L,1);
+   pilot_outfitsBegin( p );
+   return 0;
+}
+
+
+/**
+ * @brief Commits a batch of outfits started with pilot.outfitsBegin.
+ *
+ *    @luatparam Pilot p Pilot to commit the batch of.
+ * @luafunc outfitsCommit
+ */
+static int pilotL_outfitsCommit( lua_State *L )
+{
+   Pilot *p;
+   NLUA_CHECKRW(L);
+   p = luaL_validpilot(L,1);
+   pilot_outfitsEnd( p );
+
+   /* Update equipment window if operating on the player's pilot. */
+   if ((player.p != NULL) && (player.p == p))
+      outfits_updateEquipmentOutfits();
+   return 0;
+}
+
+
 /**
  * @brief Sets the fuel of a pilot.
  *
@@ -471,6 +471,7 @@ static int shipL_gfxTarget( lua_State *L )
    s  = luaL_validship(L,1);
 
    /* Push graphic. */
+   ship_gfxUse( s );
    tex = gl_dupTexture( s->gfx_target );
    if (tex == NULL) {
       WARN(_("Unable to get ship target graphic for '%s'."), s->name);
@@ -501,6 +502,7 @@ static int shipL_gfx( lua_State *L )
    s  = luaL_validship(L,1);
 
    /* Push graphic. */
+   ship_gfxUse( s );
    tex = gl_dupTexture( s->gfx_space );
    if (tex == NULL) {
       WARN(_("Unable to get ship graphic for '%s'."), s->name);
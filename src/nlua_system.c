@@ -444,8 +444,15 @@ static int systemL_jumpdistance( lua_State *L )
    else
       goal = cur_system->name;
 
-   s = map_getJumpPath( &jumps, start, goal, k, h, NULL );
-   free(s);
+   /* Distances from or to the current system are cached. */
+   if (sys == cur_system)
+      jumps = MAX( 0, map_jumpDistance( system_get(goal), k, h ) );
+   else if (strcmp( goal, cur_system->name ) == 0)
+      jumps = MAX( 0, map_jumpDistanceTo( sys, k, h ) );
+   else {
+      s = map_getJumpPath( &jumps, start, goal, k, h, NULL );
+      free(s);
+   }
 
    lua_pushnumber(L,jumps);
    return 1;
@@ -995,6 +1002,7 @@ static int systemL_setknown( lua_State *L )
             jp_rmFlag( &sys->jumps[i], JP_KNOWN );
      }
    }
+   map_invalidateDistances();
 
    /* Update outfits image array. */
    outfits_updateEquipmentOutfits();
@@ -20,6 +20,7 @@
 
 #include "nlua_tex.h"
 
+#include "array.h"
 #include "log.h"
 #include "ndata.h"
 #include "nlua_data.h"
@@ -40,6 +41,7 @@ static int texL_sprites( lua_State *L );
 static int texL_spriteFromDir( lua_State *L );
 static int texL_setFilter( lua_State *L );
 static int texL_setWrap( lua_State *L );
+static int texL_stats( lua_State *L );
 static const luaL_Reg texL_methods[] = {
    { "__gc", texL_close },
    { "new", texL_new },
@@ -50,6 +52,7 @@ static const luaL_Reg texL_methods[] = {
    { "spriteFromDir", texL_spriteFromDir },
    { "setFilter", texL_setFilter },
    { "setWrap", texL_setWrap },
+   { "stats", texL_stats },
    {0,0}
 }; /**< Texture metatable methods. */
 
@@ -514,3 +517,47 @@ static int texL_setWrap( lua_State *L )
    return 0;
 }
 
+
+/**
+ * @brief Gets the memory statistics of the loaded textures.
+ *
+ * Textures are grouped by category, which is the directory under "gfx/" they
+ * were loaded from. Textures without a name are not accounted for.
+ *
+ * @usage for k,v in ipairs(tex.stats()) do print(v.name, v.n, v.mem) end
+ *
+ *    @luatreturn table Table of categories, each with the fields "name",
+ *       "n" (amount of textures), "refs" (total references), "mem" (estimated
+ *       memory in bytes) and "lastuse" (last frame they were requested).
+ *    @luatreturn number Total estimated memory in bytes.
+ * @luafunc stats
+ */
+static int texL_stats( lua_State *L )
+{
+   int i;
+   glTexStats *stats;
+   size_t total;
+
+   stats = gl_texStats();
+   total = 0;
+   lua_newtable(L);
+   for (i=0; i<array_size(stats); i++) {
+      lua_pushnumber(L, i+1);
+      lua_newtable(L);
+      lua_pushstring(L, stats[i].name);
+      lua_setfield(L, -2, "name");
+      lua_pushinteger(L, stats[i].n);
+      lua_setfield(L, -2, "n");
+      lua_pushinteger(L, stats[i].refs);
+      lua_setfield(L, -2, "refs");
+      lua_pushnumber(L, stats[i].mem);
+      lua_setfield(L, -2, "mem");
+      lua_pushnumber(L, stats[i].lastuse);
+      lua_setfield(L, -2, "lastuse");
+      lua_rawset(L, -3);
+      total += stats[i].mem;
+   }
+   array_free( stats );
+   lua_pushnumber(L, total);
+   return 2;
+}
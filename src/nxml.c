@@ -17,6 +17,7 @@
 
 #include "ndata.h"
 #include "nstring.h"
+#include "prefetch.h"
 
 
 /**
@@ -81,6 +82,11 @@ xmlDocPtr xml_parsePhysFS( const char* filename )
    size_t bufsize;
    xmlDocPtr doc;
 
+   /* May have already been parsed in the background. */
+   doc = prefetch_takeXML( filename );
+   if (doc != NULL)
+      return doc;
+
    /* @TODO: Don't slurp?
     * Can we directly create an InputStream backed by PHYSFS_*, or use SAX? */
    buf = ndata_read( filename, &bufsize );
@@ -32,6 +32,7 @@
 
 #include "opengl_render.h"
 
+#include "array.h"
 #include "camera.h"
 #include "conf.h"
 #include "gui.h"
@@ -42,6 +43,18 @@
 
 
 #define OPENGL_RENDER_VBO_SIZE      256 /**< Size of VBO. */
+#define OPENGL_BATCH_VERTEX         9 /**< Floats per batched vertex: x, y, s, t, r, g, b, a, inter. */
+#define OPENGL_BATCH_QUAD           (6*OPENGL_BATCH_VERTEX) /**< Floats per batched quad. */
+
+
+/**
+ * @brief A textured quad waiting to be drawn by the sprite batch.
+ */
+typedef struct glBatchQuad_ {
+   GLuint ta; /**< Texture to draw. */
+   GLuint tb; /**< Texture to interpolate with, same as ta if not interpolating. */
+   GLfloat v[OPENGL_BATCH_QUAD]; /**< Transformed vertices. */
+} glBatchQuad;
 
 
 static gl_vbo *gl_renderVBO = 0; /**< VBO for rendering stuff. */
@@ -53,15 +66,35 @@ static gl_vbo *gl_triangleVBO = 0;
 static int gl_renderVBOtexOffset = 0; /**< VBO texture offset. */
 static int gl_renderVBOcolOffset = 0; /**< VBO colour offset. */
 
+/*
+ * Sprite batching.
+ */
+static int gl_batchActive = 0; /**< Nesting depth of gl_batchBegin. */
+static glBatchQuad *gl_batchQuads = NULL; /**< Queued quads. */
+static GLfloat *gl_batchVertex = NULL; /**< Vertex data for uploading. */
+static gl_vbo *gl_batchVBO = NULL; /**< Streaming VBO for the batch. */
+
+/*
+ * Statistics.
+ */
+static unsigned int gl_ndraws = 0; /**< Draw calls issued this frame. */
+static unsigned int gl_ndrawsLast = 0; /**< Draw calls issued last frame. */
+static unsigned int gl_nframes = 0; /**< Frames rendered so far. */
+
 /*
  * prototypes
  */
 static void gl_drawCircleEmpty( const double cx, const double cy,
       const double r, const glColour *c );
+static void gl_batchAdd( const glTexture *ta, const glTexture *tb, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle );
 
 
 void gl_beginSolidProgram(gl_Matrix4 projection, const glColour *c)
 {
+   gl_batchFlush();
    glUseProgram(shaders.solid.program);
    glEnableVertexAttribArray(shaders.solid.vertex);
    gl_uniformColor(shaders.solid.color, c);
@@ -78,6 +111,7 @@ void gl_endSolidProgram (void)
 
 void gl_beginSmoothProgram(gl_Matrix4 projection)
 {
+   gl_batchFlush();
    glUseProgram(shaders.smooth.program);
    glEnableVertexAttribArray(shaders.smooth.vertex);
    glEnableVertexAttribArray(shaders.smooth.vertex_color);
@@ -113,6 +147,7 @@ void gl_renderRect( double x, double y, double w, double h, const glColour *c )
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_ndraws++;
    gl_endSolidProgram();
 }
 
@@ -137,6 +172,7 @@ void gl_renderRectEmpty( double x, double y, double w, double h, const glColour
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_squareEmptyVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
    glDrawArrays( GL_LINE_STRIP, 0, 5 );
+   gl_ndraws++;
    gl_endSolidProgram();
 }
 
@@ -159,6 +195,7 @@ void gl_renderCross( double x, double y, double r, const glColour *c )
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_crossVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
    glDrawArrays( GL_LINES, 0, 4 );
+   gl_ndraws++;
    gl_endSolidProgram();
 }
 
@@ -185,6 +222,7 @@ void gl_renderTriangleEmpty( double x, double y, double a, double s, double leng
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_triangleVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
    glDrawArrays( GL_LINE_STRIP, 0, 4 );
+   gl_ndraws++;
    gl_endSolidProgram();
 }
 
@@ -214,6 +252,12 @@ void gl_blitTexture(  const glTexture* texture,
    double hw, hh;
    gl_Matrix4 projection, tex_mat;
 
+   /* Defer to the sprite batch. */
+   if (gl_batchActive) {
+      gl_batchAdd( texture, texture, 1., x, y, w, h, tx, ty, tw, th, c, angle );
+      return;
+   }
+
    glUseProgram(shaders.texture.program);
 
    /* Bind the texture. */
@@ -253,6 +297,7 @@ void gl_blitTexture(  const glTexture* texture,
 
    /* Draw. */
    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_ndraws++;
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture.vertex );
@@ -307,6 +352,12 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
 
    gl_Matrix4 projection, tex_mat;
 
+   /* Defer to the sprite batch. */
+   if (gl_batchActive) {
+      gl_batchAdd( ta, tb, inter, x, y, w, h, tx, ty, tw, th, c, 0. );
+      return;
+   }
+
    glUseProgram(shaders.texture_interpolate.program);
 
    /* Bind the textures. */
@@ -341,6 +392,7 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
 
    /* Draw. */
    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_ndraws++;
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_interpolate.vertex );
@@ -353,6 +405,199 @@ void gl_blitTextureInterpolate(  const glTexture* ta,
 }
 
 
+/**
+ * @brief Starts batching texture blits.
+ *
+ * While batching, gl_blitTexture and gl_blitTextureInterpolate (and all the
+ * sprite blitting functions built on them) only queue their quads. The quads
+ * are drawn in the order they were queued when the batch is flushed, with one
+ * draw call per run of consecutive quads using the same textures. Flushing
+ * happens at gl_batchEnd or before any other rendering from this file.
+ *
+ * Batches may be nested, only the outermost gl_batchEnd flushes.
+ */
+void gl_batchBegin (void)
+{
+   gl_batchActive++;
+}
+
+
+/**
+ * @brief Stops batching texture blits and draws everything queued.
+ */
+void gl_batchEnd (void)
+{
+   if (gl_batchActive <= 0) {
+      WARN(_("Ending sprite batch that was never started!"));
+      return;
+   }
+   if (--gl_batchActive == 0)
+      gl_batchFlush();
+}
+
+
+/**
+ * @brief Queues a textured quad in the sprite batch.
+ *
+ * Vertices are transformed by the current view matrix here so the batch can
+ * be drawn without per-quad uniforms.
+ */
+static void gl_batchAdd( const glTexture *ta, const glTexture *tb, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle )
+{
+   static const GLfloat corners[6][2] = {
+      { 0., 0. }, { 1., 0. }, { 0., 1. },
+      { 0., 1. }, { 1., 0. }, { 1., 1. } };
+   glBatchQuad *q;
+   GLfloat *v;
+   double hw, hh, ca, sa, px, py, lx, ly, t;
+   const gl_Matrix4 *m;
+   int i;
+
+   /* Must have colour for now. */
+   if (c == NULL)
+      c = &cWhite;
+
+   q        = &array_grow( &gl_batchQuads );
+   q->ta    = ta->texture;
+   q->tb    = tb->texture;
+
+   m  = &gl_view_matrix;
+   hw = w/2.;
+   hh = h/2.;
+   if (angle != 0.) {
+      ca = cos(angle);
+      sa = sin(angle);
+   }
+   else {
+      ca = 1.;
+      sa = 0.;
+   }
+   for (i=0; i<6; i++) {
+      v = &q->v[ i*OPENGL_BATCH_VERTEX ];
+
+      /* Position, rotated around the center. */
+      lx = corners[i][0]*w - hw;
+      ly = corners[i][1]*h - hh;
+      px = x + hw + ca*lx - sa*ly;
+      py = y + hh + sa*lx + ca*ly;
+      v[0] = m->m[0][0]*px + m->m[1][0]*py + m->m[3][0];
+      v[1] = m->m[0][1]*px + m->m[1][1]*py + m->m[3][1];
+
+      /* Texture coordinates. */
+      t    = ty + corners[i][1]*th;
+      v[2] = tx + corners[i][0]*tw;
+      v[3] = (ta->flags & OPENGL_TEX_VFLIP) ? 1.-t : t;
+
+      /* Colour and interpolation. */
+      v[4] = c->r;
+      v[5] = c->g;
+      v[6] = c->b;
+      v[7] = c->a;
+      v[8] = inter;
+   }
+}
+
+
+/**
+ * @brief Draws everything queued in the sprite batch.
+ */
+void gl_batchFlush (void)
+{
+   int i, j, n, start;
+   GLsizei stride;
+
+   n = array_size(gl_batchQuads);
+   if (n == 0)
+      return;
+
+   /* Upload. */
+   array_resize( &gl_batchVertex, n*OPENGL_BATCH_QUAD );
+   for (i=0; i<n; i++)
+      memcpy( &gl_batchVertex[ i*OPENGL_BATCH_QUAD ], gl_batchQuads[i].v,
+            sizeof(GLfloat)*OPENGL_BATCH_QUAD );
+   gl_vboData( gl_batchVBO, sizeof(GLfloat)*n*OPENGL_BATCH_QUAD, gl_batchVertex );
+
+   glUseProgram(shaders.texture_batch.program);
+   stride = sizeof(GLfloat)*OPENGL_BATCH_VERTEX;
+   glEnableVertexAttribArray( shaders.texture_batch.vertex );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_tex );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_color );
+   glEnableVertexAttribArray( shaders.texture_batch.vertex_inter );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_tex,
+         sizeof(GLfloat)*2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_color,
+         sizeof(GLfloat)*4, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_inter,
+         sizeof(GLfloat)*8, 1, GL_FLOAT, stride );
+   glUniform1i(shaders.texture_batch.sampler1, 0);
+   glUniform1i(shaders.texture_batch.sampler2, 1);
+
+   /* One draw per run of quads sharing textures, in submission order so
+    * overlapping sprites stay in the order they were drawn. */
+   for (start=0; start<n; start=j) {
+      for (j=start+1; j<n; j++)
+         if ((gl_batchQuads[j].ta != gl_batchQuads[start].ta) ||
+               (gl_batchQuads[j].tb != gl_batchQuads[start].tb))
+            break;
+      glActiveTexture( GL_TEXTURE1 );
+      glBindTexture( GL_TEXTURE_2D, gl_batchQuads[start].tb );
+      glActiveTexture( GL_TEXTURE0 );
+      glBindTexture( GL_TEXTURE_2D, gl_batchQuads[start].ta );
+      glDrawArrays( GL_TRIANGLES, start*6, (j-start)*6 );
+      gl_ndraws++;
+   }
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.texture_batch.vertex );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_tex );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_color );
+   glDisableVertexAttribArray( shaders.texture_batch.vertex_inter );
+   glUseProgram(0);
+   array_resize( &gl_batchQuads, 0 );
+
+   /* anything failed? */
+   gl_checkErr();
+}
+
+
+/**
+ * @brief Marks the end of a frame for the render statistics.
+ */
+void gl_renderFrameEnd (void)
+{
+   gl_ndrawsLast = gl_ndraws;
+   gl_ndraws     = 0;
+   gl_nframes++;
+}
+
+
+/**
+ * @brief Gets the number of the frame being rendered.
+ *
+ *    @return Number of frames completed so far.
+ */
+unsigned int gl_renderFrame (void)
+{
+   return gl_nframes;
+}
+
+
+/**
+ * @brief Gets the number of draw calls issued by the rendering routines last frame.
+ *
+ *    @return Number of draw calls of the last complete frame.
+ */
+unsigned int gl_renderDrawCalls (void)
+{
+   return gl_ndrawsLast;
+}
+
+
 /**
  * @brief Converts in-game coordinates to screen coordinates.
  *
@@ -637,6 +882,7 @@ static void gl_drawCircleEmpty( const double cx, const double cy,
 {
    gl_Matrix4 projection;
 
+   gl_batchFlush();
    glUseProgram(shaders.circle.program);
 
    /* Set the vertex. */
@@ -654,6 +900,7 @@ static void gl_drawCircleEmpty( const double cx, const double cy,
 
    /* Draw. */
    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_ndraws++;
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.circle.vertex );
@@ -668,6 +915,7 @@ static void gl_drawCircleFilled( const double cx, const double cy,
 {
    gl_Matrix4 projection;
 
+   gl_batchFlush();
    glUseProgram(shaders.circle_filled.program);
 
    /* Set the vertex. */
@@ -685,6 +933,7 @@ static void gl_drawCircleFilled( const double cx, const double cy,
 
    /* Draw. */
    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_ndraws++;
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.circle_filled.vertex );
@@ -740,6 +989,7 @@ void gl_drawLine( const double x1, const double y1,
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_lineVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
    glDrawArrays( GL_LINES, 0, 2 );
+   gl_ndraws++;
    gl_endSolidProgram();
 }
 
@@ -759,6 +1009,7 @@ void gl_clipRect( int x, int y, int w, int h )
    ry = (y + gl_screen.y) / gl_screen.myscale;
    rw = w / gl_screen.mxscale;
    rh = h / gl_screen.myscale;
+   gl_batchFlush();
    glScissor( rx, ry, rw, rh );
    glEnable( GL_SCISSOR_TEST );
 }
@@ -769,6 +1020,7 @@ void gl_clipRect( int x, int y, int w, int h )
  */
 void gl_unclipRect (void)
 {
+   gl_batchFlush();
    glDisable( GL_SCISSOR_TEST );
    glScissor( 0, 0, gl_screen.rw, gl_screen.rh );
 }
@@ -837,6 +1089,12 @@ int gl_initRender (void)
    vertex[7] = vertex[1];
    gl_triangleVBO = gl_vboCreateStatic( sizeof(GLfloat) * 8, vertex );
 
+   /* Sprite batch. */
+   gl_batchVBO    = gl_vboCreateStream( sizeof(GLfloat) *
+         OPENGL_RENDER_VBO_SIZE*OPENGL_BATCH_QUAD, NULL );
+   gl_batchQuads  = array_create_size( glBatchQuad, OPENGL_RENDER_VBO_SIZE );
+   gl_batchVertex = array_create_size( GLfloat, OPENGL_RENDER_VBO_SIZE*OPENGL_BATCH_QUAD );
+
    gl_checkErr();
 
    return 0;
@@ -855,5 +1113,11 @@ void gl_exitRender (void)
    gl_vboDestroy( gl_crossVBO );
    gl_vboDestroy( gl_lineVBO );
    gl_vboDestroy( gl_triangleVBO );
+   gl_vboDestroy( gl_batchVBO );
    gl_renderVBO = NULL;
+   gl_batchVBO = NULL;
+   array_free( gl_batchQuads );
+   array_free( gl_batchVertex );
+   gl_batchQuads  = NULL;
+   gl_batchVertex = NULL;
 }
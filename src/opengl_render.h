@@ -71,6 +71,16 @@ void gl_blitScale( const glTexture* texture,
 void gl_blitStatic( const glTexture* texture,
       const double bx, const double by, const glColour *c );
 
+/* Sprite batching. */
+void gl_batchBegin (void);
+void gl_batchEnd (void);
+void gl_batchFlush (void);
+
+/* Statistics. */
+void gl_renderFrameEnd (void);
+unsigned int gl_renderDrawCalls (void);
+unsigned int gl_renderFrame (void);
+
 
 extern gl_vbo *gl_squareVBO;
 void gl_beginSolidProgram(gl_Matrix4 projection, const glColour *c);
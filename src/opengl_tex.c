@@ -26,20 +26,24 @@
 #include "nfile.h"
 #include "nstring.h"
 #include "opengl.h"
+#include "prefetch.h"
+#include "strindex.h"
 
 
 /*
- * graphic list
+ * texture registry
  */
 /**
- * @brief Represents a node in the texture list.
+ * @brief Represents a named texture in the registry.
  */
-typedef struct glTexList_ {
-   struct glTexList_ *next; /**< Next in linked list */
+typedef struct glTexEntry_ {
    glTexture *tex; /**< associated texture */
    int used; /**< counts how many times texture is being used */
-} glTexList;
-static glTexList* texture_list = NULL; /**< Texture list. */
+   size_t mem; /**< Estimated memory used by the texture in bytes. */
+   unsigned int lastuse; /**< Frame the texture was last requested. */
+} glTexEntry;
+static glTexEntry *texture_reg = NULL; /**< Registry of named textures (array.h). */
+static StrIndex *texture_index = NULL; /**< Index of the registry by name. */
 
 
 /*
@@ -54,9 +58,14 @@ static GLuint gl_texParameters( unsigned int flags );
 static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int freesur );
 static glTexture* gl_loadNewImage( const char* path, unsigned int flags );
 static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigned int flags );
-/* List. */
+static glTexture* gl_loadNewImageSurface( const char *path, SDL_Surface *surface,
+      SDL_RWops *rw, unsigned int flags );
+/* Registry. */
 static glTexture* gl_texExists( const char* path );
 static int gl_texAdd( glTexture *tex );
+static void gl_texRemove( int idx );
+static size_t gl_texMem( const glTexture *tex );
+static void gl_texCategory( char *buf, size_t len, const char *name );
 
 
 /**
@@ -304,6 +313,7 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
       unsigned int flags, int w, int h, int sx, int sy, int freesur )
 {
    glTexture *texture;
+   int idx;
    size_t i, filesize;
    size_t cachesize, pngsize;
    uint8_t *trans;
@@ -395,6 +405,13 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
 
    texture = gl_loadImagePad( name, surface, flags, w, h, sx, sy, freesur );
    texture->trans = trans;
+
+   /* Account for the transparency map. */
+   if (name != NULL) {
+      idx = strindex_get( texture_index, name );
+      if ((idx >= 0) && (texture_reg[idx].tex == texture))
+         texture_reg[idx].mem = gl_texMem( texture );
+   }
    return texture;
 }
 
@@ -471,54 +488,114 @@ glTexture* gl_loadImage( SDL_Surface* surface, unsigned int flags )
 /**
  * @brief Check to see if a texture matching a path already exists.
  *
+ * Adds a reference to the texture if found.
+ *
  *    @param path Path to the texture.
  *    @return The texture, or NULL if none was found.
  */
 static glTexture* gl_texExists( const char* path )
 {
-   glTexList *cur;
+   int i;
 
    /* Null does never exist. */
    if (path==NULL)
       return NULL;
 
-   /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (strcmp(path,cur->tex->name)==0) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
-   }
+   i = strindex_get( texture_index, path );
+   if (i < 0)
+      return NULL;
 
-   return NULL;
+   texture_reg[i].used   += 1;
+   texture_reg[i].lastuse = gl_renderFrame();
+   return texture_reg[i].tex;
 }
 
 
 /**
- * @brief Adds a texture to the list under the name of path.
+ * @brief Adds a texture to the registry under its name.
  */
 static int gl_texAdd( glTexture *tex )
 {
-   glTexList *new, *last = texture_list;
+   glTexEntry *e;
 
-   /* Create the new node */
-   new = malloc( sizeof(glTexList) );
-   new->next = NULL;
-   new->used = 1;
-   new->tex  = tex;
+   if (texture_reg == NULL) {
+      texture_reg    = array_create( glTexEntry );
+      texture_index  = strindex_create( 256 );
+   }
 
-   if (texture_list == NULL) /* special condition - creating new list */
-      texture_list = new;
-   else {
-      while (last->next != NULL)
-         last = last->next;
+   e = &array_grow( &texture_reg );
+   e->tex      = tex;
+   e->used     = 1;
+   e->mem      = gl_texMem( tex );
+   e->lastuse  = gl_renderFrame();
+   strindex_add( texture_index, tex->name, array_size(texture_reg)-1 );
+
+   return 0;
+}
+
+
+/**
+ * @brief Removes an entry from the registry, the texture itself is not freed.
+ *
+ *    @param idx Position of the entry in the registry.
+ */
+static void gl_texRemove( int idx )
+{
+   int last;
+
+   strindex_remove( texture_index, texture_reg[idx].tex->name );
 
-      last->next = new;
+   /* Move the last entry into the hole. */
+   last = array_size(texture_reg)-1;
+   if (idx != last) {
+      strindex_remove( texture_index, texture_reg[last].tex->name );
+      texture_reg[idx] = texture_reg[last];
+      strindex_add( texture_index, texture_reg[idx].tex->name, idx );
    }
+   array_resize( &texture_reg, last );
+}
 
-   return 0;
+
+/**
+ * @brief Estimates the memory used by a texture.
+ *
+ *    @param tex Texture to estimate.
+ *    @return Estimated size in bytes of the texture and its transparency map.
+ */
+static size_t gl_texMem( const glTexture *tex )
+{
+   size_t mem;
+
+   mem = (size_t)tex->w * (size_t)tex->h * 4;
+   if (tex->flags & OPENGL_TEX_MIPMAPS)
+      mem += mem / 3;
+   if (tex->trans != NULL)
+      mem += gl_transSize( (int)tex->w, (int)tex->h );
+   return mem;
+}
+
+
+/**
+ * @brief Gets the category of a texture from its name.
+ *
+ * The category is the first directory under "gfx/", such as "ship" or
+ * "planet", or the first directory of the path otherwise.
+ *
+ *    @param[out] buf Buffer to write the category to.
+ *    @param len Length of the buffer.
+ *    @param name Name of the texture.
+ */
+static void gl_texCategory( char *buf, size_t len, const char *name )
+{
+   const char *end;
+
+   if (strncmp( name, "gfx/", 4 ) == 0)
+      name += 4;
+   end = strchr( name, '/' );
+   if (end == NULL)
+      nsnprintf( buf, len, "%s", _("misc") );
+   else
+      nsnprintf( buf, len, "%.*s", (int)(end-name), name );
 }
 
 
@@ -582,12 +659,25 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
 {
    glTexture *texture;
    SDL_RWops *rw;
+   SDL_Surface *surface;
+   char *buf;
+   size_t bufsize;
 
    if (path==NULL) {
       WARN(_("Trying to load image from NULL path."));
       return NULL;
    }
 
+   /* May have already been decoded in the background. */
+   surface = prefetch_takeImage( path, &buf, &bufsize );
+   if (surface != NULL) {
+      rw = SDL_RWFromConstMem( buf, bufsize );
+      texture = gl_loadNewImageSurface( path, surface, rw, flags );
+      SDL_RWclose( rw );
+      free( buf );
+      return texture;
+   }
+
    /* Load from packfile */
    rw = PHYSFSRWOPS_openRead( path );
    if (rw == NULL) {
@@ -612,7 +702,6 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
  */
 static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigned int flags )
 {
-   glTexture *texture;
    SDL_Surface *surface;
 
    /* Placeholder for warnings. */
@@ -620,17 +709,30 @@ static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigne
       path = _("unknown");
 
    surface = IMG_Load_RW( rw, 0 );
-   flags  |= OPENGL_TEX_VFLIP;
    if (surface == NULL) {
       WARN(_("Unable to load image '%s'."), path );
       return NULL;
    }
 
-   if (surface == NULL) {
-      WARN(_("'%s' could not be opened"), path );
-      return NULL;
-   }
+   return gl_loadNewImageSurface( path, surface, rw, flags );
+}
+
 
+/**
+ * @brief Uploads a decoded image, does not add to stack unlike gl_newImage.
+ *
+ *    @param path Name of the image.
+ *    @param surface Decoded image, it is freed.
+ *    @param rw SDL_RWops with the file data, used to hash the transparency map.
+ *    @param flags Flags to control image parameters.
+ *    @return Texture loaded from image.
+ */
+static glTexture* gl_loadNewImageSurface( const char *path, SDL_Surface *surface,
+      SDL_RWops *rw, unsigned int flags )
+{
+   glTexture *texture;
+
+   flags  |= OPENGL_TEX_VFLIP;
    if (flags & OPENGL_TEX_MAPTRANS)
       texture = gl_loadImagePadTrans( path, surface, rw, flags, surface->w, surface->h, 1, 1, 1 );
    else
@@ -706,44 +808,25 @@ glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
  */
 void gl_freeTexture( glTexture* texture )
 {
-   glTexList *cur, *last;
+   int i;
 
    if (texture == NULL)
       return;
 
-   /* see if we can find it in stack */
-   last = NULL;
-   for (cur=texture_list; cur!=NULL; cur=cur->next) {
-      if (cur->tex == texture) { /* found it */
-         cur->used--;
-         if (cur->used <= 0) { /* not used anymore */
-            /* free the texture */
-            glDeleteTextures( 1, &texture->texture );
-            free(texture->trans);
-            free(texture->name);
-            free(texture);
-
-            /* free the list node */
-            if (last == NULL) { /* case there's no texture before it */
-               if (cur->next != NULL)
-                  texture_list = cur->next;
-               else /* case it's the last texture */
-                  texture_list = NULL;
-            }
-            else
-               last->next = cur->next;
-            free(cur);
-         }
-         return; /* we already found it so we can exit */
-      }
-      last = cur;
-   }
+   /* see if we can find it in the registry */
+   i = strindex_get( texture_index, texture->name );
+   if ((i >= 0) && (texture_reg[i].tex == texture)) {
+      texture_reg[i].used--;
+      if (texture_reg[i].used > 0)
+         return;
 
-   /* Not found */
-   if (texture->name != NULL) /* Surfaces will have NULL names */
+      /* not used anymore */
+      gl_texRemove( i );
+   }
+   else if (texture->name != NULL) /* Surfaces will have NULL names */
       WARN(_("Attempting to free texture '%s' not found in stack!"), texture->name);
 
-   /* Free anyways */
+   /* free the texture */
    glDeleteTextures( 1, &texture->texture );
    free(texture->trans);
    free(texture->name);
@@ -761,20 +844,18 @@ void gl_freeTexture( glTexture* texture )
  */
 glTexture* gl_dupTexture( glTexture *texture )
 {
-   glTexList *cur;
+   int i;
 
    /* No segfaults kthxbye. */
    if (texture == NULL)
       return NULL;
 
    /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (texture == cur->tex) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
+   i = strindex_get( texture_index, texture->name );
+   if ((i >= 0) && (texture_reg[i].tex == texture)) {
+      texture_reg[i].used   += 1;
+      texture_reg[i].lastuse = gl_renderFrame();
+      return texture;
    }
 
    /* Invalid texture. */
@@ -882,14 +963,61 @@ int gl_initTextures (void)
  */
 void gl_exitTextures (void)
 {
-   glTexList *tex;
+   int i;
+   glTexEntry *e;
 
    /* Make sure there's no texture leak */
-   if (texture_list != NULL) {
+   if (array_size(texture_reg) > 0) {
       DEBUG(_("Texture leak detected!"));
-      for (tex=texture_list; tex!=NULL; tex=tex->next)
-         DEBUG( n_( "   '%s' opened %d time", "   '%s' opened %d times", tex->used ), tex->tex->name, tex->used );
+      for (i=0; i<array_size(texture_reg); i++) {
+         e = &texture_reg[i];
+         DEBUG( n_( "   '%s' opened %d time", "   '%s' opened %d times", e->used ), e->tex->name, e->used );
+      }
+   }
+
+   array_free( texture_reg );
+   texture_reg = NULL;
+   strindex_free( texture_index );
+   texture_index = NULL;
+}
+
+
+/**
+ * @brief Gets the memory statistics of the loaded named textures.
+ *
+ *    @return Array (array.h) of statistics per category, sorted by name. Must
+ *            be freed with array_free.
+ */
+glTexStats* gl_texStats (void)
+{
+   int i, j;
+   glTexStats *stats, *st;
+   char cat[sizeof(st->name)];
+
+   stats = array_create( glTexStats );
+   for (i=0; i<array_size(texture_reg); i++) {
+      gl_texCategory( cat, sizeof(cat), texture_reg[i].tex->name );
+
+      /* Find the category, keeping them sorted by name. */
+      for (j=0; j<array_size(stats); j++)
+         if (strcmp( stats[j].name, cat ) >= 0)
+            break;
+      if ((j >= array_size(stats)) || (strcmp( stats[j].name, cat ) != 0)) {
+         array_resize( &stats, array_size(stats)+1 );
+         memmove( &stats[j+1], &stats[j], (array_size(stats)-j-1) * sizeof(glTexStats) );
+         st = &stats[j];
+         memset( st, 0, sizeof(glTexStats) );
+         strncpy( st->name, cat, sizeof(st->name)-1 );
+      }
+      else
+         st = &stats[j];
+
+      st->n    += 1;
+      st->refs += texture_reg[i].used;
+      st->mem  += texture_reg[i].mem;
+      st->lastuse = MAX( st->lastuse, texture_reg[i].lastuse );
    }
+   return stats;
 }
 
 
@@ -68,6 +68,18 @@ typedef struct glTexture_ {
 } glTexture;
 
 
+/**
+ * @brief Memory statistics of a category of textures.
+ */
+typedef struct glTexStats_ {
+   char name[32]; /**< Name of the category. */
+   int n; /**< Amount of textures. */
+   int refs; /**< Total references to the textures. */
+   size_t mem; /**< Estimated memory used in bytes. */
+   unsigned int lastuse; /**< Last frame any of the textures was requested. */
+} glTexStats;
+
+
 /*
  * Init/exit.
  */
@@ -100,6 +112,7 @@ void gl_freeTexture( glTexture* texture );
  * Info.
  */
 int gl_texHasCompress (void);
+glTexStats* gl_texStats (void);
 
 /*
  * Misc.
@@ -21,6 +21,7 @@
 
 #include "conf.h"
 #include "dialogue.h"
+#include "font.h"
 #include "input.h"
 #include "log.h"
 #include "music.h"
@@ -414,6 +415,7 @@ static int opt_gameplaySave( unsigned int wid, char *str )
       conf.language = s==NULL ? NULL : strdup( s );
       /* Apply setting going forward; advise restart to regen other text. */
       gettext_setLanguage( conf.language );
+      gl_fontPrewarmLanguage();
       opt_needRestart();
    }
 
@@ -37,7 +37,9 @@
 #include "pilot_heat.h"
 #include "ship.h"
 #include "slots.h"
+#include "sound.h"
 #include "spfx.h"
+#include "strindex.h"
 #include "unistd.h"
 
 
@@ -52,6 +54,7 @@
  * the stack
  */
 static Outfit* outfit_stack = NULL; /**< Stack of outfits. */
+static StrIndex* outfit_index = NULL; /**< Name index of the outfit stack. */
 
 
 /*
@@ -88,14 +91,10 @@ static int outfit_loadPLG( Outfit *temp, char *buf, unsigned int bolt );
  */
 Outfit* outfit_get( const char* name )
 {
-   int i;
-
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcmp(name,outfit_stack[i].name)==0)
-         return &outfit_stack[i];
-
-   WARN(_("Outfit '%s' not found in stack."), name);
-   return NULL;
+   Outfit *o = outfit_getW( name );
+   if (o == NULL)
+      WARN(_("Outfit '%s' not found in stack."), name);
+   return o;
 }
 
 
@@ -107,11 +106,8 @@ Outfit* outfit_get( const char* name )
  */
 Outfit* outfit_getW( const char* name )
 {
-   int i;
-   for (i=0; i<array_size(outfit_stack); i++)
-      if (strcmp(name,outfit_stack[i].name)==0)
-         return &outfit_stack[i];
-   return NULL;
+   int i = strindex_get( outfit_index, name );
+   return (i < 0) ? NULL : &outfit_stack[i];
 }
 
 
@@ -551,6 +547,22 @@ glTexture* outfit_gfx( const Outfit* o )
    else if (outfit_isAmmo(o)) return o->u.amm.gfx_space;
    return NULL;
 }
+/**
+ * @brief Gets the outfit's store graphic, loading it on first use.
+ *    @param o Outfit to get information from.
+ */
+glTexture* outfit_gfxStore( const Outfit* o )
+{
+   Outfit *ow;
+
+   if ((o->gfx_store == NULL) && (o->gfx_store_path != NULL)) {
+      /* Outfits are only handed out const, the stack itself is mutable. */
+      assert( (o >= outfit_stack) && (o < array_end(outfit_stack)) );
+      ow = &outfit_stack[ o - outfit_stack ];
+      ow->gfx_store = gl_newImage( ow->gfx_store_path, OPENGL_TEX_MIPMAPS );
+   }
+   return o->gfx_store;
+}
 /**
  * @brief Gets the outfit's collision polygon.
  *    @param o Outfit to get information from.
@@ -749,6 +761,33 @@ int outfit_soundHit( const Outfit* o )
    else if (outfit_isAmmo(o)) return o->u.amm.sound_hit;
    return -1.;
 }
+/**
+ * @brief Decodes ahead all the sounds an outfit can make.
+ *    @param o Outfit to prefetch the sounds of.
+ */
+void outfit_prefetchSounds( const Outfit* o )
+{
+   Outfit *amm;
+   if (outfit_isBolt(o) || outfit_isAmmo(o)) {
+      sound_prefetch( outfit_sound(o) );
+      sound_prefetch( outfit_soundHit(o) );
+   }
+   else if (outfit_isBeam(o)) {
+      sound_prefetch( o->u.bem.sound_warmup );
+      sound_prefetch( o->u.bem.sound );
+      sound_prefetch( o->u.bem.sound_off );
+   }
+   else if (outfit_isAfterburner(o)) {
+      sound_prefetch( o->u.afb.sound_on );
+      sound_prefetch( o->u.afb.sound );
+      sound_prefetch( o->u.afb.sound_off );
+   }
+   else if (outfit_isLauncher(o)) {
+      amm = outfit_ammo(o);
+      if (amm != NULL)
+         outfit_prefetchSounds( amm );
+   }
+}
 /**
  * @brief Gets the outfit's duration.
  *    @param o Outfit to get the duration of.
@@ -2108,7 +2147,7 @@ if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s)
 static int outfit_parse( Outfit* temp, const char* file )
 {
    xmlNodePtr cur, ccur, node, parent;
-   char *prop, *desc_extra;
+   char *prop, *desc_extra, str[PATH_MAX];
    const char *cprop;
    int group, l;
    ShipStatList *ll;
@@ -2157,8 +2196,12 @@ static int outfit_parse( Outfit* temp, const char* file )
                continue;
             }
             else if (xml_isNode(cur,"gfx_store")) {
-               temp->gfx_store = xml_parseTexture( cur,
-                     OUTFIT_GFX_PATH"store/%s", 1, 1, OPENGL_TEX_MIPMAPS );
+               /* Loaded on demand by outfit_gfxStore(). */
+               if (xml_get(cur) != NULL) {
+                  nsnprintf( str, sizeof(str), OUTFIT_GFX_PATH"store/%s", xml_get(cur) );
+                  free( temp->gfx_store_path );
+                  temp->gfx_store_path = strdup( str );
+               }
                continue;
             }
             else if (xml_isNode(cur,"gfx_overlays")) {
@@ -2301,7 +2344,7 @@ if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**<
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->slot.type==OUTFIT_SLOT_NULL,"slot");
    MELEMENT((temp->slot.type!=OUTFIT_SLOT_NA) && (temp->slot.size==OUTFIT_SLOT_SIZE_NA),"size");
-   MELEMENT(temp->gfx_store==NULL,"gfx_store");
+   MELEMENT(temp->gfx_store_path==NULL,"gfx_store");
    /*MELEMENT(temp->mass==0,"mass"); Not really needed */
    MELEMENT(temp->type==0,"type");
    /*MELEMENT(temp->price==0,"price");*/
@@ -2358,6 +2401,11 @@ int outfit_load (void)
    array_shrink(&outfit_stack);
    noutfits = array_size(outfit_stack);
 
+   /* Index by name, needed by the second pass. */
+   outfit_index = strindex_create( noutfits );
+   for (i=0; i<noutfits; i++)
+      strindex_add( outfit_index, outfit_stack[i].name, i );
+
    /* Second pass, sets up ammunition relationships. */
    for (i=0; i<noutfits; i++) {
       o = &outfit_stack[i];
@@ -2601,6 +2649,7 @@ void outfit_free (void)
       free(o->desc_short);
       free(o->license);
       free(o->name);
+      free(o->gfx_store_path);
       gl_freeTexture(o->gfx_store);
       for (j=0; j<array_size(o->gfx_overlays); j++)
          gl_freeTexture(o->gfx_overlays[j]);
@@ -2608,5 +2657,8 @@ void outfit_free (void)
    }
 
    array_free(outfit_stack);
+   outfit_stack = NULL;
+   strindex_free(outfit_index);
+   outfit_index = NULL;
 }
 
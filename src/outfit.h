@@ -348,7 +348,8 @@ typedef struct Outfit_ {
    char *desc_short; /**< Short outfit description. */
    int priority;     /**< Sort priority, highest first. */
 
-   glTexture* gfx_store; /**< Store graphic. */
+   char *gfx_store_path; /**< Path of the store graphic. */
+   glTexture* gfx_store; /**< Store graphic, use outfit_gfxStore() to load it. */
    glTexture** gfx_overlays; /**< Array (array.h): Store overlay graphics. */
 
    unsigned int properties; /**< Properties stored bitwise. */
@@ -428,6 +429,7 @@ const char *slotSize( const OutfitSlotSize o );
 const glColour *outfit_slotSizeColour( const OutfitSlot* os );
 OutfitSlotSize outfit_toSlotSize( const char *s );
 glTexture* outfit_gfx( const Outfit* o );
+glTexture* outfit_gfxStore( const Outfit* o );
 CollPoly* outfit_plg( const Outfit* o );
 int outfit_spfxArmour( const Outfit* o );
 int outfit_spfxShield( const Outfit* o );
@@ -443,6 +445,7 @@ double outfit_speed( const Outfit* o );
 double outfit_spin( const Outfit* o );
 int outfit_sound( const Outfit* o );
 int outfit_soundHit( const Outfit* o );
+void outfit_prefetchSounds( const Outfit* o );
 /* Active outfits. */
 double outfit_duration( const Outfit* o );
 double outfit_cooldown( const Outfit* o );
@@ -284,6 +284,24 @@ static int pilot_validEnemy( const Pilot* p, const Pilot* target )
 }
 
 
+/**
+ * @brief Cost function for nearest enemy searches.
+ *
+ *    @param target Candidate enemy.
+ *    @param d2 Squared distance to the candidate.
+ *    @param data Searching pilot.
+ *    @param[out] cost Squared distance.
+ *    @return 1 if the candidate is a valid enemy.
+ */
+static int pilot_costEnemy( const Pilot *target, double d2, const void *data, double *cost )
+{
+   if (!pilot_validEnemy( data, target ))
+      return 0;
+   *cost = d2;
+   return 1;
+}
+
+
 /**
  * @brief Gets the nearest enemy to the pilot.
  *
@@ -292,27 +310,44 @@ static int pilot_validEnemy( const Pilot* p, const Pilot* target )
  */
 unsigned int pilot_getNearestEnemy( const Pilot* p )
 {
-   unsigned int tp;
    int i;
-   double d, td;
 
-   tp = 0;
-   d  = 0.;
-   for (i=0; i<array_size(pilot_stack); i++) {
+   i = pilot_gridNearest( p->solid->pos.x, p->solid->pos.y, 1.,
+         pilot_costEnemy, p, NULL );
+   if (i < 0)
+      return 0;
+   return pilot_stack[i]->id;
+}
 
-      if (!pilot_validEnemy( p, pilot_stack[i] ))
-         continue;
 
-      /* Check distance. */
-      td = vect_dist2(&pilot_stack[i]->solid->pos, &p->solid->pos);
-      if (!tp || (td < d)) {
-         d  = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
-   return tp;
+/**
+ * @brief Parameters of a nearest enemy search by size.
+ */
+typedef struct PilotSizeSearch_ {
+   const Pilot *p; /**< Searching pilot. */
+   double lb; /**< Lower bound for target mass. */
+   double ub; /**< Upper bound for target mass. */
+} PilotSizeSearch;
+
+
+/**
+ * @brief Cost function for nearest enemy searches by size.
+ */
+static int pilot_costEnemySize( const Pilot *target, double d2, const void *data, double *cost )
+{
+   const PilotSizeSearch *s = data;
+
+   if (!pilot_validEnemy( s->p, target ))
+      return 0;
+
+   if (target->solid->mass < s->lb || target->solid->mass > s->ub)
+      return 0;
+
+   *cost = d2;
+   return 1;
 }
 
+
 /**
  * @brief Gets the nearest enemy to the pilot closest to the pilot whose mass is between LB and UB.
  *
@@ -323,31 +358,50 @@ unsigned int pilot_getNearestEnemy( const Pilot* p )
  */
 unsigned int pilot_getNearestEnemy_size( const Pilot* p, double target_mass_LB, double target_mass_UB)
 {
-   unsigned int tp;
    int i;
-   double d, td;
+   PilotSizeSearch s;
+
+   s.p  = p;
+   s.lb = target_mass_LB;
+   s.ub = target_mass_UB;
+   i = pilot_gridNearest( p->solid->pos.x, p->solid->pos.y, 1.,
+         pilot_costEnemySize, &s, NULL );
+   if (i < 0)
+      return 0;
+   return pilot_stack[i]->id;
+}
 
-   tp = 0;
-   d  = 0.;
-   for (i=0; i<array_size(pilot_stack); i++) {
 
-      if (!pilot_validEnemy( p, pilot_stack[i] ))
-         continue;
+/**
+ * @brief Parameters of a heuristic nearest enemy search.
+ */
+typedef struct PilotHeuristicSearch_ {
+   const Pilot *p; /**< Searching pilot. */
+   double mass_factor; /**< Parameter for target mass. */
+   double health_factor; /**< Parameter for target health. */
+   double damage_factor; /**< Parameter for target dps. */
+   double range_factor; /**< Weighting for range. */
+} PilotHeuristicSearch;
 
-      if (pilot_stack[i]->solid->mass < target_mass_LB || pilot_stack[i]->solid->mass > target_mass_UB)
-         continue;
 
-      /* Check distance. */
-      td = vect_dist2(&pilot_stack[i]->solid->pos, &p->solid->pos);
-      if (!tp || (td < d)) {
-         d = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
+/**
+ * @brief Cost function for heuristic nearest enemy searches.
+ */
+static int pilot_costEnemyHeuristic( const Pilot *target, double d2, const void *data, double *cost )
+{
+   const PilotHeuristicSearch *s = data;
 
-   return tp;
+   if (!pilot_validEnemy( s->p, target ))
+      return 0;
+
+   *cost = s->range_factor * d2
+         + FABS( pilot_relsize( s->p, target ) - s->mass_factor)
+         + FABS( pilot_relhp(   s->p, target ) - s->health_factor)
+         + FABS( pilot_reldps(  s->p, target ) - s->damage_factor);
+   return 1;
 }
 
+
 /**
  * @brief Gets the nearest enemy to the pilot closest to the pilot whose mass is between LB and UB.
  *
@@ -362,34 +416,20 @@ unsigned int pilot_getNearestEnemy_heuristic( const Pilot* p,
       double mass_factor, double health_factor,
       double damage_factor, double range_factor )
 {
-   unsigned int tp;
    int i;
-   double temp, current_heuristic_value;
-   Pilot *target;
-
-   current_heuristic_value = 10000.;
-
-   tp = 0;
-   for (i=0; i<array_size(pilot_stack); i++) {
-      target = pilot_stack[i];
-
-      if (!pilot_validEnemy( p, target ))
-         continue;
-
-      /* Check distance. */
-      temp = range_factor *
-               vect_dist2( &target->solid->pos, &p->solid->pos )
-            + FABS( pilot_relsize( p, target ) - mass_factor)
-            + FABS( pilot_relhp(   p, target ) - health_factor)
-            + FABS( pilot_reldps(  p, target ) - damage_factor);
-
-      if ((tp == 0) || (temp < current_heuristic_value)) {
-         current_heuristic_value = temp;
-         tp = target->id;
-      }
-   }
-
-   return tp;
+   PilotHeuristicSearch s;
+
+   s.p               = p;
+   s.mass_factor     = mass_factor;
+   s.health_factor   = health_factor;
+   s.damage_factor   = damage_factor;
+   s.range_factor    = range_factor;
+   /* The other terms are never negative, so range_factor bounds the cost. */
+   i = pilot_gridNearest( p->solid->pos.x, p->solid->pos.y, range_factor,
+         pilot_costEnemyHeuristic, &s, NULL );
+   if (i < 0)
+      return 0;
+   return pilot_stack[i]->id;
 }
 
 /**
@@ -474,9 +514,54 @@ unsigned int pilot_getBoss( const Pilot* p )
    return t;
 }
 
+/**
+ * @brief Parameters of a nearest pilot search.
+ */
+typedef struct PilotPosSearch_ {
+   const Pilot *p; /**< Searching pilot. */
+   int disabled; /**< Whether to return disabled pilots. */
+   int player; /**< Whether to consider the player. */
+} PilotPosSearch;
+
+
+/**
+ * @brief Cost function for nearest pilot searches.
+ */
+static int pilot_costPos( const Pilot *target, double d2, const void *data, double *cost )
+{
+   const PilotPosSearch *s = data;
+
+   /* Must not be self. */
+   if (target == s->p)
+      return 0;
+
+   /* Player is only a fallback. */
+   if (!s->player && (target->id == PLAYER_ID))
+      return 0;
+
+   /* Player doesn't select escorts (unless disabled is active). */
+   if (!s->disabled && (s->p->faction == FACTION_PLAYER) &&
+         (target->faction == FACTION_PLAYER))
+      return 0;
+
+   /* Shouldn't be disabled. */
+   if (!s->disabled && pilot_isDisabled(target))
+      return 0;
+
+   /* Must be a valid target. */
+   if (!pilot_validTarget( s->p, target ))
+      return 0;
+
+   *cost = d2;
+   return 1;
+}
+
+
 /**
  * @brief Get the nearest pilot to a pilot from a certain position.
  *
+ * The player is only ever returned when no other pilot is valid.
+ *
  *    @param p Pilot to get the nearest pilot of.
  *    @param[out] tp The nearest pilot.
  *    @param x X position to calculate from.
@@ -487,36 +572,24 @@ unsigned int pilot_getBoss( const Pilot* p )
 double pilot_getNearestPos( const Pilot *p, unsigned int *tp, double x, double y, int disabled )
 {
    int i;
-   double d, td;
+   double d;
+   PilotPosSearch s;
 
+   s.p         = p;
+   s.disabled  = disabled;
+   s.player    = 0;
    *tp = PLAYER_ID;
-   d  = 0;
-   for (i=0; i<array_size(pilot_stack); i++) {
+   d   = 0.;
 
-      /* Must not be self. */
-      if (pilot_stack[i] == p)
-         continue;
-
-      /* Player doesn't select escorts (unless disabled is active). */
-      if (!disabled && (p->faction == FACTION_PLAYER) &&
-            (pilot_stack[i]->faction == FACTION_PLAYER))
-         continue;
-
-      /* Shouldn't be disabled. */
-      if (!disabled && pilot_isDisabled(pilot_stack[i]))
-         continue;
-
-      /* Must be a valid target. */
-      if (!pilot_validTarget( p, pilot_stack[i] ))
-         continue;
-
-      /* Minimum distance. */
-      td = pow2(x-pilot_stack[i]->solid->pos.x) + pow2(y-pilot_stack[i]->solid->pos.y);
-      if (((*tp==PLAYER_ID) || (td < d))) {
-         d = td;
-         *tp = pilot_stack[i]->id;
-      }
+   /* The player always comes first in the stack, so any other valid pilot
+    * takes precedence over it. */
+   i = pilot_gridNearest( x, y, 1., pilot_costPos, &s, &d );
+   if (i < 0) {
+      s.player = 1;
+      i = pilot_gridNearest( x, y, 1., pilot_costPos, &s, &d );
    }
+   if (i >= 0)
+      *tp = pilot_stack[i]->id;
    return d;
 }
 
@@ -2193,7 +2266,9 @@ void pilot_update( Pilot* pilot, const double dt )
    /* See if there is commodities to gather. */
    gatherable_gather( pilot->id );
 
-   /* Update the trail. */
+   /* Update the trail, not visible when simulating the system. */
+   if (space_isSimulation())
+      return;
    n = array_size(pilot->ship->trail_emitters);
    for (i=0; i<n; i++)
       pilot_sample_trail( pilot, i );
@@ -2620,6 +2695,7 @@ void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction, const
    /* Basic information. */
    pilot->ship = ship;
    pilot->name = strdup( (name==NULL) ? ship->name : name );
+   ship_gfxRef( ship );
 
    /* faction */
    pilot->faction = faction;
@@ -2815,6 +2891,9 @@ Pilot* pilot_copy( Pilot* src )
    if (src->name)
       dest->name = strdup(src->name);
 
+   /* Shares the ship graphics, released again in pilot_free(). */
+   ship_gfxRef( dest->ship );
+
    /* Copy solid. */
    dest->solid = malloc(sizeof(Solid));
    *dest->solid = *src->solid;
@@ -2990,6 +3069,9 @@ void pilot_free( Pilot* p )
       spfx_trail_remove( p->trail[i] );
    array_free(p->trail);
 
+   /* Graphics may now be evicted. */
+   ship_gfxUnref( p->ship );
+
 #ifdef DEBUGGING
    memset( p, 0, sizeof(Pilot) );
 #endif /* DEBUGGING */
@@ -3028,6 +3110,7 @@ void pilot_destroy(Pilot* p)
    /* pilot is eliminated */
    pilot_free(p);
    array_erase( &pilot_stack, &pilot_stack[i], &pilot_stack[i+1] );
+   pilots_gridInvalidate();
 }
 
 
@@ -3055,6 +3138,7 @@ void pilots_free (void)
    array_free(pilot_stack);
    pilot_stack = NULL;
    player.p = NULL;
+   pilots_gridFree();
 }
 
 
@@ -3085,6 +3169,7 @@ void pilots_clean (int persist)
          pilot_free(pilot_stack[i]);
    }
    array_erase( &pilot_stack, &pilot_stack[persist_count], array_end(pilot_stack) );
+   pilots_gridInvalidate();
 
    /* Clear global hooks. */
    pilots_clearGlobalHooks();
@@ -3127,16 +3212,25 @@ void pilots_update( double dt )
    int i;
    Pilot *p;
 
-   /* Now update all the pilots. */
+   /* Destroy pilots that are gone. */
    for (i=0; i<array_size(pilot_stack); i++) {
       p = pilot_stack[i];
-
-      /* Destroy pilot and go on. */
       if (pilot_isFlag(p, PILOT_DELETE)) {
          pilot_destroy(p);
          i--; /* Must decrement iterator. */
-         continue;
       }
+   }
+
+   /* Index the pilots so the AI can look for nearby ones. */
+   pilots_gridBuild();
+
+   /* Let the pilots think. */
+   for (i=0; i<array_size(pilot_stack); i++) {
+      p = pilot_stack[i];
+
+      /* Ignore. */
+      if (pilot_isFlag(p, PILOT_DELETE))
+         continue;
 
       /* Invisible, not doing anything. */
       if (pilot_isFlag(p, PILOT_INVISIBLE))
@@ -3167,6 +3261,9 @@ void pilots_update( double dt )
          p->think(p, dt);
    }
 
+   /* Pilots are about to move. */
+   pilots_gridInvalidate();
+
    /* Now update all the pilots. */
    for (i=0; i<array_size(pilot_stack); i++) {
       p = pilot_stack[i];
@@ -3194,6 +3291,7 @@ void pilots_update( double dt )
 void pilots_render( double dt )
 {
    int i;
+   gl_batchBegin();
    for (i=0; i<array_size(pilot_stack); i++) {
 
       /* Invisible, not doing anything. */
@@ -3203,6 +3301,7 @@ void pilots_render( double dt )
       if (pilot_stack[i]->render != NULL) /* render */
          pilot_stack[i]->render(pilot_stack[i], dt);
    }
+   gl_batchEnd();
 }
 
 
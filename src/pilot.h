@@ -296,6 +296,8 @@ typedef struct Pilot_ {
    PilotOutfitSlot * outfit_structure; /**< Array (array.h): The structure slots. */
    PilotOutfitSlot * outfit_utility;   /**< Array (array.h): The utility slots. */
    PilotOutfitSlot * outfit_weapon; /**< Array (array.h): The weapon slots. */
+   int outfit_batch; /**< Nesting depth of outfit batches, see pilot_outfitsBegin(). */
+   int outfit_dirty; /**< Outfits were added during the current batch. */
 
    /* Primarily for AI usage. */
    int ncannons;      /**< Number of cannons equipped. */
@@ -373,6 +375,7 @@ typedef struct Pilot_ {
 #include "pilot_outfit.h"
 #include "pilot_weapon.h"
 #include "pilot_ew.h"
+#include "pilot_grid.h"
 
 
 /*
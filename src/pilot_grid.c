@@ -0,0 +1,365 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+/**
+ * @file pilot_grid.c
+ *
+ * @brief Spatial index of the pilot stack.
+ *
+ * Pilots are binned by position into a uniform grid at the start of every
+ * pilots_update(), so that the AI can look for nearby pilots without
+ * scanning the entire stack.  The index is only valid while the pilots are
+ * thinking, as positions change afterwards.  Whenever it is not valid, or for
+ * pilots added after it was built, the queries fall back to scanning the
+ * stack, so they always give the same results as a plain scan.
+ *
+ * Like the AI, the queries are only meant to be run from the main thread.
+ */
+
+
+/** @cond */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "pilot_grid.h"
+
+#include "array.h"
+
+
+#define PGRID_CELL_MIN     1000. /**< Minimum size of a grid cell. */
+#define PGRID_CELLS_MAX    32 /**< Maximum amount of cells along each axis. */
+
+
+extern Pilot** pilot_stack; /**< Pilot stack, defined in pilot.c. */
+
+
+static int pgrid_valid     = 0; /**< Whether or not the index can be used. */
+static int pgrid_n         = 0; /**< Amount of pilots in the index. */
+static int pgrid_nx        = 0; /**< Amount of cells along X. */
+static int pgrid_ny        = 0; /**< Amount of cells along Y. */
+static double pgrid_x0     = 0.; /**< Left edge of the grid. */
+static double pgrid_y0     = 0.; /**< Bottom edge of the grid. */
+static double pgrid_cell   = PGRID_CELL_MIN; /**< Size of a cell. */
+static int *pgrid_start    = NULL; /**< Start offset of each cell into pgrid_entries. */
+static int *pgrid_entries  = NULL; /**< Stack positions ordered by cell. */
+static int *pgrid_res      = NULL; /**< Results of the last radius query. */
+
+
+/*
+ * Prototypes.
+ */
+static int pilot_gridCell( double x, double y, int *cx, int *cy );
+static int pilot_gridConsider( int i, double x, double y, int k,
+      PilotGridCost func, const void *data, int *out, double *costs, int n );
+static int pilot_gridSearch( double x, double y, double scale, int k,
+      PilotGridCost func, const void *data, int *out, double *costs );
+static int pilot_gridCmp( const void *a, const void *b );
+
+
+/**
+ * @brief Gets the cell a position belongs to, clamped to the grid.
+ *
+ *    @return 1 if the position is inside the grid, 0 otherwise.
+ */
+static int pilot_gridCell( double x, double y, int *cx, int *cy )
+{
+   int ix, iy;
+
+   ix  = (int)floor( (x - pgrid_x0) / pgrid_cell );
+   iy  = (int)floor( (y - pgrid_y0) / pgrid_cell );
+   *cx = CLAMP( 0, pgrid_nx-1, ix );
+   *cy = CLAMP( 0, pgrid_ny-1, iy );
+   return ((ix == *cx) && (iy == *cy));
+}
+
+
+/**
+ * @brief Rebuilds the index from the current pilot stack.
+ */
+void pilots_gridBuild (void)
+{
+   int i, c, cx, cy;
+   double x1, y1, x2, y2;
+   Pilot *p;
+
+   if (pgrid_start == NULL) {
+      pgrid_start    = array_create( int );
+      pgrid_entries  = array_create( int );
+      pgrid_res      = array_create( int );
+   }
+
+   pgrid_n     = array_size(pilot_stack);
+   pgrid_valid = 1;
+   if (pgrid_n == 0) {
+      pgrid_nx = 0;
+      pgrid_ny = 0;
+      return;
+   }
+
+   /* Fit the grid to the pilots. */
+   x1 = x2 = pilot_stack[0]->solid->pos.x;
+   y1 = y2 = pilot_stack[0]->solid->pos.y;
+   for (i=1; i<pgrid_n; i++) {
+      p  = pilot_stack[i];
+      x1 = MIN( x1, p->solid->pos.x );
+      y1 = MIN( y1, p->solid->pos.y );
+      x2 = MAX( x2, p->solid->pos.x );
+      y2 = MAX( y2, p->solid->pos.y );
+   }
+   pgrid_x0   = x1;
+   pgrid_y0   = y1;
+   pgrid_cell = MAX( PGRID_CELL_MIN, MAX( x2-x1, y2-y1 ) / PGRID_CELLS_MAX );
+   pgrid_nx   = MIN( PGRID_CELLS_MAX, (int)((x2-x1) / pgrid_cell) + 1 );
+   pgrid_ny   = MIN( PGRID_CELLS_MAX, (int)((y2-y1) / pgrid_cell) + 1 );
+
+   /* Counting sort of the pilots into the cells. */
+   c = pgrid_nx * pgrid_ny;
+   array_resize( &pgrid_start, c+1 );
+   memset( pgrid_start, 0, (c+1) * sizeof(int) );
+   for (i=0; i<pgrid_n; i++) {
+      p = pilot_stack[i];
+      pilot_gridCell( p->solid->pos.x, p->solid->pos.y, &cx, &cy );
+      pgrid_start[ cy*pgrid_nx + cx + 1 ]++;
+   }
+   for (i=0; i<c; i++)
+      pgrid_start[i+1] += pgrid_start[i];
+   array_resize( &pgrid_entries, pgrid_n );
+   /* Filling advances each start to the next cell's, shift them back after. */
+   for (i=0; i<pgrid_n; i++) {
+      p = pilot_stack[i];
+      pilot_gridCell( p->solid->pos.x, p->solid->pos.y, &cx, &cy );
+      pgrid_entries[ pgrid_start[ cy*pgrid_nx + cx ]++ ] = i;
+   }
+   for (i=c; i>0; i--)
+      pgrid_start[i] = pgrid_start[i-1];
+   pgrid_start[0] = 0;
+}
+
+
+/**
+ * @brief Marks the index as unusable until it is rebuilt.
+ *
+ * Must be called whenever pilots move or are removed from the stack.
+ */
+void pilots_gridInvalidate (void)
+{
+   pgrid_valid = 0;
+}
+
+
+/**
+ * @brief Frees the index.
+ */
+void pilots_gridFree (void)
+{
+   array_free( pgrid_start );
+   pgrid_start = NULL;
+   array_free( pgrid_entries );
+   pgrid_entries = NULL;
+   array_free( pgrid_res );
+   pgrid_res = NULL;
+   pgrid_valid = 0;
+}
+
+
+/**
+ * @brief Inserts a pilot into the sorted results of a nearest search.
+ *
+ * Ties are broken by stack position so that results match a stack scan.
+ *
+ *    @return New amount of results.
+ */
+static int pilot_gridConsider( int i, double x, double y, int k,
+      PilotGridCost func, const void *data, int *out, double *costs, int n )
+{
+   int j;
+   double d2, cost;
+   Pilot *p;
+
+   p  = pilot_stack[i];
+   d2 = pow2( x - p->solid->pos.x ) + pow2( y - p->solid->pos.y );
+   if (!func( p, d2, data, &cost ))
+      return n;
+
+   for (j=n; j>0; j--)
+      if ((costs[j-1] < cost) ||
+            ((costs[j-1] == cost) && (out[j-1] < i)))
+         break;
+   if (j >= k)
+      return n;
+
+   if (n < k)
+      n++;
+   memmove( &out[j+1], &out[j], (n-j-1) * sizeof(int) );
+   memmove( &costs[j+1], &costs[j], (n-j-1) * sizeof(double) );
+   out[j]   = i;
+   costs[j] = cost;
+   return n;
+}
+
+
+/**
+ * @brief Finds the k pilots with the lowest cost around a position.
+ *
+ * Cells are visited in rings of increasing distance, and the search stops as
+ * soon as no unvisited pilot can beat the results found so far.
+ *
+ *    @param[out] out Stack positions found by increasing cost, holds k elements.
+ *    @param[out] costs Costs of the pilots in out, holds k elements.
+ *    @return Amount of pilots found.
+ */
+static int pilot_gridSearch( double x, double y, double scale, int k,
+      PilotGridCost func, const void *data, int *out, double *costs )
+{
+   int i, j, n, r, c, cx, cy, kx, ky, step, tail, more;
+   double bound;
+
+   if (k <= 0)
+      return 0;
+
+   n    = 0;
+   tail = 0;
+   if (pgrid_valid && (pgrid_nx > 0)) {
+      tail = pgrid_n;
+      pilot_gridCell( x, y, &cx, &cy );
+      for (r=0; ; r++) {
+         /* Visit the ring of cells at distance r. */
+         for (ky=cy-r; ky<=cy+r; ky++) {
+            if ((ky < 0) || (ky >= pgrid_ny))
+               continue;
+            step = ((ky == cy-r) || (ky == cy+r)) ? 1 : 2*r;
+            for (kx=cx-r; kx<=cx+r; kx+=step) {
+               if ((kx < 0) || (kx >= pgrid_nx))
+                  continue;
+               c = ky*pgrid_nx + kx;
+               for (j=pgrid_start[c]; j<pgrid_start[c+1]; j++)
+                  n = pilot_gridConsider( pgrid_entries[j], x, y, k,
+                        func, data, out, costs, n );
+            }
+         }
+
+         /* Distance to the closest cell not visited yet. */
+         more  = 0;
+         bound = HUGE_VAL;
+         if (cx-r > 0) {
+            more  = 1;
+            bound = MIN( bound, x - (pgrid_x0 + (cx-r)*pgrid_cell) );
+         }
+         if (cx+r < pgrid_nx-1) {
+            more  = 1;
+            bound = MIN( bound, pgrid_x0 + (cx+r+1)*pgrid_cell - x );
+         }
+         if (cy-r > 0) {
+            more  = 1;
+            bound = MIN( bound, y - (pgrid_y0 + (cy-r)*pgrid_cell) );
+         }
+         if (cy+r < pgrid_ny-1) {
+            more  = 1;
+            bound = MIN( bound, pgrid_y0 + (cy+r+1)*pgrid_cell - y );
+         }
+         if (!more)
+            break;
+         /* Costs only bound the distance when the scale is positive. */
+         if ((scale > 0.) && (n >= k) &&
+               (costs[n-1] < scale * pow2( MAX( bound, 0. ) )))
+            break;
+      }
+   }
+
+   /* Pilots that aren't in the index. */
+   for (i=tail; i<array_size(pilot_stack); i++)
+      n = pilot_gridConsider( i, x, y, k, func, data, out, costs, n );
+
+   return n;
+}
+
+
+/**
+ * @brief Finds the pilot with the lowest cost around a position.
+ *
+ *    @param x X position to search around.
+ *    @param y Y position to search around.
+ *    @param scale Factor such that the cost is at least scale times the
+ *           squared distance (1 for plain distance).
+ *    @param func Cost function of the candidates.
+ *    @param data User data to pass to func.
+ *    @param[out] cost Cost of the pilot found (can be NULL).
+ *    @return Stack position of the pilot or -1 if none is valid.
+ */
+int pilot_gridNearest( double x, double y, double scale,
+      PilotGridCost func, const void *data, double *cost )
+{
+   int i;
+   double c;
+
+   if (pilot_gridSearch( x, y, scale, 1, func, data, &i, &c ) == 0)
+      return -1;
+   if (cost != NULL)
+      *cost = c;
+   return i;
+}
+
+
+/**
+ * @brief Compares two stack positions for qsort.
+ */
+static int pilot_gridCmp( const void *a, const void *b )
+{
+   return *(const int*)a - *(const int*)b;
+}
+
+
+/**
+ * @brief Gets all the pilots within a radius of a position.
+ *
+ *    @param x X position to search around.
+ *    @param y Y position to search around.
+ *    @param r Radius to search in.
+ *    @return Array (array.h) of stack positions in stack order, valid until
+ *            the next query.
+ */
+const int* pilot_gridRadius( double x, double y, double r )
+{
+   int i, j, c, tail, cx, cy, cx1, cy1, cx2, cy2;
+   double r2;
+   Pilot *p;
+
+   if (pgrid_res == NULL)
+      pgrid_res = array_create( int );
+   array_resize( &pgrid_res, 0 );
+   r2   = pow2(r);
+   tail = 0;
+
+   if (pgrid_valid && (pgrid_nx > 0)) {
+      tail = pgrid_n;
+      pilot_gridCell( x-r, y-r, &cx1, &cy1 );
+      pilot_gridCell( x+r, y+r, &cx2, &cy2 );
+      for (cy=cy1; cy<=cy2; cy++) {
+         for (cx=cx1; cx<=cx2; cx++) {
+            c = cy*pgrid_nx + cx;
+            for (j=pgrid_start[c]; j<pgrid_start[c+1]; j++) {
+               i = pgrid_entries[j];
+               p = pilot_stack[i];
+               if (pow2( x - p->solid->pos.x ) + pow2( y - p->solid->pos.y ) <= r2)
+                  array_push_back( &pgrid_res, i );
+            }
+         }
+      }
+      qsort( pgrid_res, array_size(pgrid_res), sizeof(int), pilot_gridCmp );
+   }
+
+   /* Pilots that aren't in the index. */
+   for (i=tail; i<array_size(pilot_stack); i++) {
+      p = pilot_stack[i];
+      if (pow2( x - p->solid->pos.x ) + pow2( y - p->solid->pos.y ) <= r2)
+         array_push_back( &pgrid_res, i );
+   }
+
+   return pgrid_res;
+}
@@ -0,0 +1,40 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef PILOT_GRID_H
+#  define PILOT_GRID_H
+
+
+#include "pilot.h"
+
+
+/**
+ * @brief Cost function used by the nearest pilot searches.
+ *
+ *    @param p Candidate pilot.
+ *    @param d2 Squared distance from the search position to the candidate.
+ *    @param data User data passed to the search.
+ *    @param[out] cost Cost of the candidate, must be at least scale*d2.
+ *    @return 1 if the candidate is valid, 0 if it should be ignored.
+ */
+typedef int (*PilotGridCost)( const Pilot *p, double d2, const void *data, double *cost );
+
+
+/*
+ * Index management.
+ */
+void pilots_gridBuild (void);
+void pilots_gridInvalidate (void);
+void pilots_gridFree (void);
+
+/*
+ * Queries.
+ */
+int pilot_gridNearest( double x, double y, double scale,
+      PilotGridCost func, const void *data, double *cost );
+const int* pilot_gridRadius( double x, double y, double r );
+
+
+#endif /* PILOT_GRID_H */
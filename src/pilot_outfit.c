@@ -395,6 +395,79 @@ int pilot_addOutfit( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s )
 }
 
 
+/**
+ * @brief Starts a batch of outfit changes.
+ *
+ * While batching, outfits added with pilot_addOutfitRaw() followed by
+ * pilot_outfitsAdded() only update what pilot_addOutfitTest() needs, and the
+ * full stats and weapon sets are recalculated once by pilot_outfitsEnd().
+ * Batches may be nested, only the outermost pilot_outfitsEnd() updates.
+ *
+ *    @param pilot Pilot to start batching outfit changes of.
+ */
+void pilot_outfitsBegin( Pilot *pilot )
+{
+   pilot->outfit_batch++;
+}
+
+
+/**
+ * @brief Updates the pilot after an outfit was added with pilot_addOutfitRaw().
+ *
+ * Outside of a batch this just recalculates the stats.
+ *
+ *    @param pilot Pilot the outfit was added to.
+ *    @param outfit Outfit that was added.
+ */
+void pilot_outfitsAdded( Pilot *pilot, const Outfit *outfit )
+{
+   const ShipStatList *ll;
+
+   if (pilot->outfit_batch <= 0) {
+      pilot_calcStats( pilot );
+      return;
+   }
+   pilot->outfit_dirty = 1;
+
+   /* Outfits that change the CPU or ammo capacity affect what can be added
+    * next, so those still need the stats to be recalculated right away. */
+   for (ll=outfit->stats; ll!=NULL; ll=ll->next) {
+      if ((ll->type == SS_TYPE_A_CPU_MAX) ||
+            (ll->type == SS_TYPE_D_CPU_MOD) ||
+            (ll->type == SS_TYPE_D_AMMO_CAPACITY)) {
+         pilot_calcStats( pilot );
+         return;
+      }
+   }
+
+   /* Otherwise only the CPU usage changes, same as in pilot_calcStats(). */
+   pilot->cpu += outfit_cpu( outfit );
+}
+
+
+/**
+ * @brief Ends a batch of outfit changes.
+ *
+ *    @param pilot Pilot to stop batching outfit changes of.
+ */
+void pilot_outfitsEnd( Pilot *pilot )
+{
+   if (pilot->outfit_batch <= 0) {
+      WARN(_("Pilot '%s': Ending outfit batch that was never started!"), pilot->name );
+      return;
+   }
+   if (--pilot->outfit_batch > 0)
+      return;
+   if (!pilot->outfit_dirty)
+      return;
+
+   pilot->outfit_dirty = 0;
+   pilot_calcStats( pilot );
+   if (pilot->autoweap)
+      pilot_weaponAuto( pilot );
+}
+
+
 /**
  * @brief Removes an outfit from the pilot without doing any checks.
  *
@@ -19,6 +19,11 @@ int pilot_rmOutfitRaw( Pilot* pilot, PilotOutfitSlot *s );
 int pilot_addOutfit( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s );
 int pilot_rmOutfit( Pilot* pilot, PilotOutfitSlot *s );
 
+/* Batched changes. */
+void pilot_outfitsBegin( Pilot *pilot );
+void pilot_outfitsAdded( Pilot *pilot, const Outfit *outfit );
+void pilot_outfitsEnd( Pilot *pilot );
+
 /* Ammo. */
 int pilot_addAmmo( Pilot* pilot, PilotOutfitSlot *s, Outfit* ammo, int quantity );
 int pilot_rmAmmo( Pilot* pilot, PilotOutfitSlot *s, int quantity );
@@ -0,0 +1,366 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file prefetch.c
+ *
+ * @brief Reads and decodes data files on the threadpool ahead of their use.
+ *
+ * The loaders still run in order on the main thread, but the files they will
+ * need are read, parsed (XML) or decoded (images) by the worker threads in the
+ * meantime.  When a loader asks for a file that was queued it waits for the
+ * job to finish and takes ownership of the result instead of doing the work
+ * itself.  Nothing here touches OpenGL, textures are still uploaded by the
+ * main thread.
+ *
+ * Failures are not reported by the workers, the result is just discarded so
+ * that the main thread loads the file normally and emits the usual warnings.
+ */
+
+
+/** @cond */
+#include "SDL_image.h"
+#include "SDL_mutex.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "prefetch.h"
+
+#include "array.h"
+#include "log.h"
+#include "ndata.h"
+#include "nstring.h"
+#include "strindex.h"
+#include "threadpool.h"
+
+
+/**
+ * @brief Types of prefetch jobs.
+ */
+typedef enum PrefetchType_ {
+   PREFETCH_XML, /**< Parses an XML document. */
+   PREFETCH_IMAGE /**< Decodes an image to a surface. */
+} PrefetchType;
+
+
+/**
+ * @brief A file being prefetched.
+ */
+typedef struct PrefetchJob_ {
+   char *path; /**< Path of the file. */
+   PrefetchType type; /**< Type of the job. */
+   int done; /**< Whether or not the worker is done with it. */
+   xmlDocPtr doc; /**< Parsed document for XML jobs. */
+   SDL_Surface *surface; /**< Decoded surface for image jobs. */
+   char *buf; /**< Raw file data for image jobs, used for hashing. */
+   size_t bufsize; /**< Size of the raw file data. */
+} PrefetchJob;
+
+
+static PrefetchJob **prefetch_jobs = NULL; /**< Queued jobs, NULL once claimed (array.h). */
+static StrIndex *prefetch_index = NULL; /**< Index of the unclaimed jobs by path. */
+static SDL_mutex *prefetch_lock = NULL; /**< Protects the job results. */
+static SDL_cond *prefetch_cond = NULL; /**< Signalled when a job is done. */
+
+
+/*
+ * Prototypes.
+ */
+static void prefetch_queue( const char *path, PrefetchType type );
+static void prefetch_queueDir( const char *dir, PrefetchType type,
+      const char *const *ext );
+static int prefetch_worker( void *data );
+static PrefetchJob* prefetch_take( const char *path, PrefetchType type );
+static int prefetch_hasExt( const char *path, const char *const *ext );
+
+
+static const char *const prefetch_xmlExt[]   = { ".xml", NULL }; /**< Extensions of XML files. */
+static const char *const prefetch_imageExt[] = { ".png", ".webp", NULL }; /**< Extensions of images. */
+
+
+/**
+ * @brief Does the actual work of a job, runs on a worker thread.
+ *
+ *    @param data Job to do.
+ *    @return 0 always.
+ */
+static int prefetch_worker( void *data )
+{
+   PrefetchJob *job;
+   char *buf;
+   size_t bufsize;
+   xmlDocPtr doc;
+   SDL_Surface *surface;
+   SDL_RWops *rw;
+
+   job      = (PrefetchJob*) data;
+   bufsize  = 0;
+   doc      = NULL;
+   surface  = NULL;
+   buf      = ndata_read( job->path, &bufsize );
+   if (buf != NULL) {
+      if (job->type == PREFETCH_XML) {
+         doc = xmlParseMemory( buf, bufsize );
+         free( buf );
+         buf = NULL;
+      }
+      else {
+         rw = SDL_RWFromConstMem( buf, bufsize );
+         if (rw != NULL)
+            surface = IMG_Load_RW( rw, 1 );
+         if (surface == NULL) {
+            free( buf );
+            buf = NULL;
+         }
+      }
+   }
+
+   SDL_LockMutex( prefetch_lock );
+   job->doc       = doc;
+   job->surface   = surface;
+   job->buf       = buf;
+   job->bufsize   = bufsize;
+   job->done      = 1;
+   SDL_CondBroadcast( prefetch_cond );
+   SDL_UnlockMutex( prefetch_lock );
+
+   return 0;
+}
+
+
+/**
+ * @brief Queues a file to be prefetched.
+ *
+ *    @param path Path of the file.
+ *    @param type Type of the job.
+ */
+static void prefetch_queue( const char *path, PrefetchType type )
+{
+   PrefetchJob *job;
+
+   if (prefetch_jobs == NULL) {
+      prefetch_jobs  = array_create( PrefetchJob* );
+      prefetch_index = strindex_create( 256 );
+      prefetch_lock  = SDL_CreateMutex();
+      prefetch_cond  = SDL_CreateCond();
+   }
+
+   /* Already queued. */
+   if (strindex_get( prefetch_index, path ) >= 0)
+      return;
+
+   job         = calloc( 1, sizeof(PrefetchJob) );
+   job->path   = strdup( path );
+   job->type   = type;
+   array_push_back( &prefetch_jobs, job );
+   strindex_add( prefetch_index, job->path, array_size(prefetch_jobs)-1 );
+
+   /* Without threadpool it's just marked as done and loaded normally. */
+   if (threadpool_newJob( prefetch_worker, job ))
+      job->done = 1;
+}
+
+
+/**
+ * @brief Checks to see if a path has one of the extensions.
+ *
+ *    @param path Path to check.
+ *    @param ext NULL terminated list of extensions.
+ *    @return 1 if the path has one of the extensions.
+ */
+static int prefetch_hasExt( const char *path, const char *const *ext )
+{
+   int i;
+   size_t l, le;
+
+   l = strlen( path );
+   for (i=0; ext[i]!=NULL; i++) {
+      le = strlen( ext[i] );
+      if ((l >= le) && (strcmp( &path[l-le], ext[i] ) == 0))
+         return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Queues all the matching files of a directory, at any depth.
+ *
+ *    @param dir Directory to queue.
+ *    @param type Type of the jobs.
+ *    @param ext NULL terminated list of extensions of the files to queue.
+ */
+static void prefetch_queueDir( const char *dir, PrefetchType type,
+      const char *const *ext )
+{
+   int i;
+   char **files;
+
+   files = ndata_listRecursive( dir );
+   for (i=0; i<array_size(files); i++) {
+      if (prefetch_hasExt( files[i], ext ))
+         prefetch_queue( files[i], type );
+      free( files[i] );
+   }
+   array_free( files );
+}
+
+
+/**
+ * @brief Queues an XML file to be parsed in the background.
+ *
+ *    @param path Path of the file.
+ */
+void prefetch_xml( const char *path )
+{
+   prefetch_queue( path, PREFETCH_XML );
+}
+
+
+/**
+ * @brief Queues all the XML files of a directory to be parsed in the background.
+ *
+ *    @param dir Directory to queue.
+ */
+void prefetch_xmlDir( const char *dir )
+{
+   prefetch_queueDir( dir, PREFETCH_XML, prefetch_xmlExt );
+}
+
+
+/**
+ * @brief Queues all the images of a directory to be decoded in the background.
+ *
+ *    @param dir Directory to queue.
+ */
+void prefetch_imageDir( const char *dir )
+{
+   prefetch_queueDir( dir, PREFETCH_IMAGE, prefetch_imageExt );
+}
+
+
+/**
+ * @brief Claims a job, waiting for it to be done.
+ *
+ *    @param path Path of the file.
+ *    @param type Type of job expected.
+ *    @return The job, which must be freed by the caller, or NULL if not queued.
+ */
+static PrefetchJob* prefetch_take( const char *path, PrefetchType type )
+{
+   int i;
+   PrefetchJob *job;
+
+   i = strindex_get( prefetch_index, path );
+   if (i < 0)
+      return NULL;
+   job = prefetch_jobs[i];
+   if (job->type != type)
+      return NULL;
+
+   strindex_remove( prefetch_index, job->path );
+   prefetch_jobs[i] = NULL;
+
+   SDL_LockMutex( prefetch_lock );
+   while (!job->done)
+      SDL_CondWait( prefetch_cond, prefetch_lock );
+   SDL_UnlockMutex( prefetch_lock );
+
+   return job;
+}
+
+
+/**
+ * @brief Takes a prefetched XML document.
+ *
+ *    @param path Path of the file.
+ *    @return The parsed document or NULL if it was not prefetched or failed
+ *            to parse, in which case it should be loaded normally.
+ */
+xmlDocPtr prefetch_takeXML( const char *path )
+{
+   PrefetchJob *job;
+   xmlDocPtr doc;
+
+   job = prefetch_take( path, PREFETCH_XML );
+   if (job == NULL)
+      return NULL;
+
+   doc = job->doc;
+   free( job->path );
+   free( job );
+   return doc;
+}
+
+
+/**
+ * @brief Takes a prefetched image.
+ *
+ *    @param path Path of the file.
+ *    @param[out] buf Raw data of the file, must be freed by the caller.
+ *    @param[out] bufsize Size of the raw data.
+ *    @return The decoded surface or NULL if it was not prefetched or failed to
+ *            decode, in which case it should be loaded normally.
+ */
+SDL_Surface* prefetch_takeImage( const char *path, char **buf, size_t *bufsize )
+{
+   PrefetchJob *job;
+   SDL_Surface *surface;
+
+   job = prefetch_take( path, PREFETCH_IMAGE );
+   if (job == NULL)
+      return NULL;
+
+   surface  = job->surface;
+   *buf     = job->buf;
+   *bufsize = job->bufsize;
+   free( job->path );
+   free( job );
+   return surface;
+}
+
+
+/**
+ * @brief Waits for all the pending jobs and frees the unclaimed results.
+ */
+void prefetch_free (void)
+{
+   int i, n;
+   PrefetchJob *job;
+
+   if (prefetch_jobs == NULL)
+      return;
+
+   n = 0;
+   for (i=0; i<array_size(prefetch_jobs); i++) {
+      job = prefetch_jobs[i];
+      if (job == NULL)
+         continue;
+
+      SDL_LockMutex( prefetch_lock );
+      while (!job->done)
+         SDL_CondWait( prefetch_cond, prefetch_lock );
+      SDL_UnlockMutex( prefetch_lock );
+
+      xmlFreeDoc( job->doc );
+      if (job->surface != NULL)
+         SDL_FreeSurface( job->surface );
+      free( job->buf );
+      free( job->path );
+      free( job );
+      n++;
+   }
+   if (n > 0)
+      DEBUG( n_( "%d prefetched file was not used", "%d prefetched files were not used", n ), n );
+
+   array_free( prefetch_jobs );
+   prefetch_jobs = NULL;
+   strindex_free( prefetch_index );
+   prefetch_index = NULL;
+   SDL_DestroyCond( prefetch_cond );
+   prefetch_cond = NULL;
+   SDL_DestroyMutex( prefetch_lock );
+   prefetch_lock = NULL;
+}
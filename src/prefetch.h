@@ -0,0 +1,36 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef PREFETCH_H
+#  define PREFETCH_H
+
+
+/** @cond */
+#include "SDL.h"
+/** @endcond */
+
+#include "nxml.h"
+
+
+/*
+ * Queueing, done from the main thread.
+ */
+void prefetch_xml( const char *path );
+void prefetch_xmlDir( const char *dir );
+void prefetch_imageDir( const char *dir );
+
+/*
+ * Claiming the results, they are owned by the caller afterwards.
+ */
+xmlDocPtr prefetch_takeXML( const char *path );
+SDL_Surface* prefetch_takeImage( const char *path, char **buf, size_t *bufsize );
+
+/*
+ * Clean up.
+ */
+void prefetch_free (void);
+
+
+#endif /* PREFETCH_H */
@@ -33,8 +33,8 @@ SHADERS = [
       name = "trail",
       vs_path = "trail.vert",
       fs_path = "trail.frag",
-      attributes = ["vertex"],
-      uniforms = ["projection", "c1", "c2", "t1", "t2", "dt", "pos1", "pos2", "r" ],
+      attributes = ["vertex", "vertex_color", "vertex_data"],
+      uniforms = ["projection", "dt", "ttl", "r" ],
       subroutines = {
         "trail_func" : [
             "trail_default",
@@ -71,6 +71,14 @@ SHADERS = [
       uniforms = ["projection", "color", "tex_mat", "sampler1", "sampler2", "inter"],
       subroutines = {},
    ),
+   Shader(
+      name = "texture_batch",
+      vs_path = "texture_batch.vert",
+      fs_path = "texture_batch.frag",
+      attributes = ["vertex", "vertex_tex", "vertex_color", "vertex_inter"],
+      uniforms = ["sampler1", "sampler2"],
+      subroutines = {},
+   ),
    Shader(
       name = "nebula",
       vs_path = "nebula.vert",
@@ -29,6 +29,7 @@
 #include "nxml.h"
 #include "shipstats.h"
 #include "slots.h"
+#include "strindex.h"
 #include "toolkit.h"
 #include "unistd.h"
 
@@ -50,13 +51,21 @@
 
 
 static Ship* ship_stack = NULL; /**< Stack of ships available in the game. */
+static StrIndex* ship_index = NULL; /**< Name index of the ship stack. */
+static unsigned int ship_gfxTick = 0; /**< Use counter for the graphics LRU. */
+static size_t ship_gfxMem = 0; /**< Estimated memory used by loaded ship graphics. */
 
 
 /*
  * Prototypes
  */
-static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine );
+static int ship_parseGFX( Ship *temp, char *buf, int sx, int sy, int engine );
+static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy );
+static int ship_loadEngineImage( Ship *temp, char *str, int sx, int sy );
 static int ship_loadPLG( Ship *temp, char *buf, int size_hint );
+static size_t ship_texMem( const glTexture *tex );
+static void ship_gfxLoad( Ship *s );
+static void ship_gfxFree( Ship *s );
 static int ship_parse( Ship *temp, xmlNodePtr parent );
 
 
@@ -68,16 +77,10 @@ static int ship_parse( Ship *temp, xmlNodePtr parent );
  */
 Ship* ship_get( const char* name )
 {
-   Ship *temp;
-   int i;
-
-   temp = ship_stack;
-   for (i=0; i < array_size(ship_stack); i++)
-      if (strcmp(temp[i].name, name)==0)
-         return &temp[i];
-
-   WARN(_("Ship %s does not exist"), name);
-   return NULL;
+   Ship *s = ship_getW( name );
+   if (s == NULL)
+      WARN(_("Ship %s does not exist"), name);
+   return s;
 }
 
 
@@ -89,15 +92,8 @@ Ship* ship_get( const char* name )
  */
 Ship* ship_getW( const char* name )
 {
-   Ship *temp;
-   int i;
-
-   temp = ship_stack;
-   for (i=0; i < array_size(ship_stack); i++)
-      if (strcmp(temp[i].name, name)==0)
-         return &temp[i];
-
-   return NULL;
+   int i = strindex_get( ship_index, name );
+   return (i < 0) ? NULL : &ship_stack[i];
 }
 
 
@@ -500,9 +496,6 @@ static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
    SDL_RWclose( rw );
    SDL_FreeSurface( surface );
 
-   /* Calculate mount angle. */
-   temp->mangle  = 2.*M_PI;
-   temp->mangle /= temp->gfx_space->sx * temp->gfx_space->sy;
    return 0;
 }
 
@@ -523,15 +516,17 @@ static int ship_loadEngineImage( Ship *temp, char *str, int sx, int sy )
 
 
 /**
- * @brief Loads the graphics for a ship.
+ * @brief Sets up the graphics paths for a ship.
  *
- *    @param temp Ship to load into.
+ * The graphics themselves are only loaded when first used.
+ *
+ *    @param temp Ship to set up.
  *    @param buf Name of the texture to work with.
  *    @param sx Number of X sprites in image.
  *    @param sy Number of Y sprites in image.
  *    @param engine Whether there is also an engine image to load.
  */
-static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
+static int ship_parseGFX( Ship *temp, char *buf, int sx, int sy, int engine )
 {
    char base[NDATA_PATH_MAX], str[PATH_MAX];
    size_t i;
@@ -550,16 +545,19 @@ static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
    }
 
    nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_EXT, base, buf );
-   ship_loadSpaceImage( temp, str, sx, sy );
+   temp->gfx_path = strdup(str);
+   temp->gfx_sx   = sx;
+   temp->gfx_sy   = sy;
 
-   /* Load the engine sprite .*/
+   /* Get the engine sprite .*/
    if (engine && conf.engineglow) {
       nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_ENGINE SHIP_EXT, base, buf );
-      ship_loadEngineImage( temp, str, sx, sy );
-      if (temp->gfx_engine == NULL)
-         WARN(_("Ship '%s' does not have an engine sprite (%s)."), temp->name, str );
+      temp->gfx_path_engine = strdup(str);
    }
 
+   /* Collision polygon shares the base name. */
+   temp->gfx_path_polygon = strdup(buf);
+
    /* Get the comm graphic for future loading. */
    nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_COMM SHIP_EXT, base, buf );
    temp->gfx_comm = strdup(str);
@@ -792,18 +790,8 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
 
          xmlr_attr_int(node, "noengine", noengine );
 
-         /* Load the graphics. */
-         ship_loadGFX( temp, buf, sx, sy, !noengine );
-
-         /* Load the polygon. */
-         ship_loadPLG( temp, buf, sx*sy );
-
-         /* Validity check: there must be 1 polygon per sprite. */
-         if (array_size(temp->polygon) != sx*sy) {
-            WARN(_("Ship '%s': the number of collision polygons is wrong.\n \
-                    npolygon = %i and sx*sy = %i"),
-                    temp->name, array_size(temp->polygon), sx*sy);
-         }
+         /* Set up the graphics. */
+         ship_parseGFX( temp, buf, sx, sy, !noengine );
 
          continue;
       }
@@ -822,8 +810,11 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          xmlr_attr_int_def( node, "sx", sx, 8 );
          xmlr_attr_int_def( node, "sy", sy, 8 );
 
-         /* Load the graphics. */
-         ship_loadSpaceImage( temp, str, sx, sy );
+         /* Graphics get loaded when first used. */
+         free( temp->gfx_path );
+         temp->gfx_path = strdup(str);
+         temp->gfx_sx   = sx;
+         temp->gfx_sy   = sy;
 
          continue;
       }
@@ -838,12 +829,10 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          }
          nsnprintf( str, PATH_MAX, GFX_PATH"%s", buf );
 
-         /* Get sprite size. */
-         xmlr_attr_int_def( node, "sx", sx, 8 );
-         xmlr_attr_int_def( node, "sy", sy, 8 );
-
-         /* Load the graphics. */
-         ship_loadEngineImage( temp, str, sx, sy );
+         /* Graphics get loaded when first used, with the space sprite
+          * sheet dimensions. */
+         free( temp->gfx_path_engine );
+         temp->gfx_path_engine = strdup(str);
 
          continue;
       }
@@ -1014,11 +1003,15 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
    temp->dmg_absorb   /= 100.;
    temp->turn         *= M_PI / 180.; /* Convert to rad. */
 
+   /* Calculate mount angle. */
+   if ((temp->gfx_sx > 0) && (temp->gfx_sy > 0))
+      temp->mangle = 2.*M_PI / (temp->gfx_sx * temp->gfx_sy);
+
    /* ship validator */
 #define MELEMENT(o,s)      if (o) WARN( _("Ship '%s' missing '%s' element"), temp->name, s)
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->base_type==NULL,"base_type");
-   MELEMENT((temp->gfx_space==NULL) || (temp->gfx_comm==NULL),"GFX");
+   MELEMENT((temp->gfx_path==NULL) || (temp->gfx_comm==NULL),"GFX");
    MELEMENT(temp->gui==NULL,"GUI");
    MELEMENT(temp->class==SHIP_CLASS_NULL,"class");
    MELEMENT(temp->price==0,"price");
@@ -1103,6 +1096,12 @@ int ships_load (void)
 
    /* Shrink stack. */
    array_shrink(&ship_stack);
+
+   /* Index by name. */
+   strindex_free( ship_index );
+   ship_index = strindex_create( array_size(ship_stack) );
+   for (i=0; i<array_size(ship_stack); i++)
+      strindex_add( ship_index, ship_stack[i].name, i );
    DEBUG( n_( "Loaded %d Ship", "Loaded %d Ships", array_size(ship_stack) ), array_size(ship_stack) );
 
    /* Clean up. */
@@ -1145,25 +1144,173 @@ void ships_free (void)
       ss_free( s->stats );
 
       /* Free graphics. */
-      gl_freeTexture(s->gfx_space);
-      gl_freeTexture(s->gfx_engine);
-      gl_freeTexture(s->gfx_target);
-      gl_freeTexture(s->gfx_store);
+      ship_gfxFree( s );
+      free(s->gfx_path);
+      free(s->gfx_path_engine);
+      free(s->gfx_path_polygon);
       free(s->gfx_comm);
       for (j=0; j<array_size(s->gfx_overlays); j++)
          gl_freeTexture(s->gfx_overlays[j]);
       array_free(s->gfx_overlays);
 
-      /* Free collision polygons. */
-      for (j=0; j<array_size(s->polygon); j++) {
-         free(s->polygon[j].x);
-         free(s->polygon[j].y);
-      }
-
       array_free(s->trail_emitters);
-      array_free(s->polygon);
    }
 
    array_free(ship_stack);
    ship_stack = NULL;
+   strindex_free(ship_index);
+   ship_index = NULL;
+   ship_gfxMem = 0;
+}
+
+
+/**
+ * @brief Estimates the memory used by a texture.
+ */
+static size_t ship_texMem( const glTexture *tex )
+{
+   if (tex == NULL)
+      return 0;
+   return (size_t)tex->w * (size_t)tex->h * 4;
+}
+
+
+/**
+ * @brief Loads the graphics and collision polygons of a ship.
+ *
+ *    @param s Ship to load graphics of.
+ */
+static void ship_gfxLoad( Ship *s )
+{
+   if ((s->gfx_space != NULL) || (s->gfx_path == NULL))
+      return;
+
+   ship_loadSpaceImage( s, s->gfx_path, s->gfx_sx, s->gfx_sy );
+   if (s->gfx_path_engine != NULL) {
+      ship_loadEngineImage( s, s->gfx_path_engine, s->gfx_sx, s->gfx_sy );
+      if (s->gfx_engine == NULL)
+         WARN(_("Ship '%s' does not have an engine sprite (%s)."), s->name, s->gfx_path_engine );
+   }
+
+   /* Load the polygon. */
+   if (s->gfx_path_polygon != NULL) {
+      ship_loadPLG( s, s->gfx_path_polygon, s->gfx_sx*s->gfx_sy );
+
+      /* Validity check: there must be 1 polygon per sprite. */
+      if (array_size(s->polygon) != s->gfx_sx*s->gfx_sy) {
+         WARN(_("Ship '%s': the number of collision polygons is wrong.\n \
+                 npolygon = %i and sx*sy = %i"),
+                 s->name, array_size(s->polygon), s->gfx_sx*s->gfx_sy);
+      }
+   }
+
+   s->gfx_mem   = ship_texMem( s->gfx_space ) + ship_texMem( s->gfx_engine ) +
+         ship_texMem( s->gfx_target ) + ship_texMem( s->gfx_store );
+   ship_gfxMem += s->gfx_mem;
+}
+
+
+/**
+ * @brief Frees the graphics and collision polygons of a ship.
+ *
+ *    @param s Ship to free graphics of.
+ */
+static void ship_gfxFree( Ship *s )
+{
+   int j;
+
+   gl_freeTexture(s->gfx_space);
+   gl_freeTexture(s->gfx_engine);
+   gl_freeTexture(s->gfx_target);
+   gl_freeTexture(s->gfx_store);
+   s->gfx_space  = NULL;
+   s->gfx_engine = NULL;
+   s->gfx_target = NULL;
+   s->gfx_store  = NULL;
+
+   /* Free collision polygons. */
+   for (j=0; j<array_size(s->polygon); j++) {
+      free(s->polygon[j].x);
+      free(s->polygon[j].y);
+   }
+   array_free(s->polygon);
+   s->polygon = NULL;
+
+   ship_gfxMem -= MIN( ship_gfxMem, s->gfx_mem );
+   s->gfx_mem   = 0;
+}
+
+
+/**
+ * @brief Makes sure the graphics of a ship are loaded.
+ *
+ * Graphics loaded this way without a reference may be evicted by
+ * ships_gfxEvict(), so the caller must not hold on to them across a system
+ * change without duplicating the textures.
+ *
+ *    @param s Ship to use the graphics of.
+ */
+void ship_gfxUse( Ship *s )
+{
+   ship_gfxLoad( s );
+   s->gfx_used = ++ship_gfxTick;
+}
+
+
+/**
+ * @brief Adds a reference to the graphics of a ship, loading them if needed.
+ *
+ *    @param s Ship to reference.
+ */
+void ship_gfxRef( Ship *s )
+{
+   ship_gfxUse( s );
+   s->gfx_refs++;
+}
+
+
+/**
+ * @brief Removes a reference to the graphics of a ship.
+ *
+ * Unreferenced graphics stay loaded until evicted by ships_gfxEvict().
+ *
+ *    @param s Ship to unreference.
+ */
+void ship_gfxUnref( Ship *s )
+{
+   if (s->gfx_refs <= 0) {
+      WARN(_("Ship '%s' graphics unreferenced more times than referenced."), s->name);
+      return;
+   }
+   s->gfx_refs--;
+   s->gfx_used = ++ship_gfxTick;
+}
+
+
+/**
+ * @brief Evicts the least recently used unreferenced ship graphics until
+ *        under the configured memory budget.
+ *
+ * Only call this when no window holds on to non-duplicated ship textures.
+ */
+void ships_gfxEvict (void)
+{
+   int i, lru;
+   size_t budget;
+   Ship *s;
+
+   budget = (size_t)MAX( 0, conf.gfx_budget ) * 1024 * 1024;
+   while (ship_gfxMem > budget) {
+      lru = -1;
+      for (i=0; i<array_size(ship_stack); i++) {
+         s = &ship_stack[i];
+         if ((s->gfx_space == NULL) || (s->gfx_refs > 0))
+            continue;
+         if ((lru < 0) || (s->gfx_used < ship_stack[lru].gfx_used))
+            lru = i;
+      }
+      if (lru < 0)
+         break;
+      ship_gfxFree( &ship_stack[lru] );
+   }
 }
@@ -130,16 +130,24 @@ typedef struct Ship_ {
    double dmg_absorb; /**< Damage absorption in per one [0:1] with 1 being 100% absorption. */
 
    /* graphics */
-   glTexture *gfx_space; /**< Space sprite sheet. */
-   glTexture *gfx_engine; /**< Space engine glow sprite sheet. */
-   glTexture *gfx_target; /**< Targeting window graphic. */
-   glTexture *gfx_store; /**< Store graphic. */
+   char *gfx_path; /**< Path of the space sprite sheet. */
+   char *gfx_path_engine; /**< Path of the engine glow sprite sheet, NULL if none. */
+   char *gfx_path_polygon; /**< Base name of the collision polygon file, NULL if none. */
+   int gfx_sx; /**< Number of sprites in the X direction. */
+   int gfx_sy; /**< Number of sprites in the Y direction. */
+   int gfx_refs; /**< Number of references to the loaded graphics. */
+   unsigned int gfx_used; /**< When the graphics were last used, for eviction. */
+   size_t gfx_mem; /**< Estimated memory used by the loaded graphics. */
+   glTexture *gfx_space; /**< Space sprite sheet, only valid after ship_gfxUse(). */
+   glTexture *gfx_engine; /**< Space engine glow sprite sheet, only valid after ship_gfxUse(). */
+   glTexture *gfx_target; /**< Targeting window graphic, only valid after ship_gfxUse(). */
+   glTexture *gfx_store; /**< Store graphic, only valid after ship_gfxUse(). */
    char* gfx_comm;   /**< Name of graphic for communication. */
    glTexture** gfx_overlays; /**< Array (array.h): Store overlay graphics. */
    ShipTrailEmitter* trail_emitters; /**< Trail emitters. */
 
    /* collision polygon */
-   CollPoly *polygon; /**< Array (array.h): Collision polygons. */
+   CollPoly *polygon; /**< Array (array.h): Collision polygons, loaded with the graphics. */
 
    /* GUI interface */
    char* gui;        /**< Name of the GUI the ship uses by default. */
@@ -180,6 +188,10 @@ ShipClass ship_classFromString( char* str );
 credits_t ship_basePrice( const Ship* s );
 credits_t ship_buyPrice( const Ship* s );
 glTexture* ship_loadCommGFX( Ship* s );
+void ship_gfxUse( Ship *s );
+void ship_gfxRef( Ship *s );
+void ship_gfxUnref( Ship *s );
+void ships_gfxEvict (void);
 int ship_size( const Ship *s );
 
 
@@ -33,6 +33,7 @@
 #include "physics.h"
 #include "player.h"
 #include "sound_openal.h"
+#include "threadpool.h"
 
 
 #define SOUND_SUFFIX_WAV   ".wav" /**< Suffix of sounds. */
@@ -43,6 +44,15 @@
 #define voiceUnlock()      SDL_UnlockMutex(voice_mutex)
 
 
+/*
+ * Voice identifiers are the slot in the lower bits and the generation of the
+ * slot in the upper bits, so that stale identifiers don't match reused slots.
+ */
+#define VOICE_SLOT_BITS    16 /**< Bits of the identifier used for the slot. */
+#define VOICE_SLOT_MASK    ((1<<VOICE_SLOT_BITS)-1) /**< Mask of the slot bits. */
+#define VOICE_GEN_MAX      ((1<<(31-VOICE_SLOT_BITS))-1) /**< Maximum generation. */
+
+
 /*
  * Global sound properties.
  */
@@ -52,17 +62,35 @@ static int sound_initialized  = 0; /**< Whether or not sound is initialized. */
 
 /*
  * Sound list.
+ *
+ * Sounds are only registered at startup and decoded on first use, or ahead of
+ * it by the threadpool.  Decoded buffers are kept while under the memory
+ * budget, past it the least recently used ones are freed again.
  */
 static alSound *sound_list    = NULL; /**< List of available sounds. */
+static SDL_mutex *sound_listLock = NULL; /**< Protects the loading state of the sounds. */
+static SDL_cond *sound_loadCond = NULL; /**< Signalled when a sound finishes decoding. */
+static size_t sound_mem       = 0; /**< Memory used by the decoded buffers. */
+static unsigned int sound_uses = 0; /**< Use counter, for least recently used eviction. */
+static int *sound_lru         = NULL; /**< Eviction candidates (array.h). */
 
 
 /*
  * Voices.
  */
-static int voice_genid        = 0; /**< Voice identifier generator. */
-alVoice *voice_active         = NULL; /**< Active voices. */
-static alVoice *voice_pool    = NULL; /**< Pool of free voices. */
-static SDL_mutex *voice_mutex = NULL; /**< Lock for voices. */
+static alVoice **voice_slots  = NULL; /**< All the voices by slot (array.h). */
+static alVoice **voice_active = NULL; /**< Active voices (array.h). */
+static int *voice_pool        = NULL; /**< Slots of the free voices (array.h). */
+static SDL_mutex *voice_mutex = NULL; /**< Lock for adding and removing voices. */
+
+
+/*
+ * Listener, sent to OpenAL once per frame by sound_update().
+ */
+static int listener_dirty     = 0; /**< Listener changed since last update. */
+static double listener_dir    = 0.; /**< Direction of the listener. */
+static double listener_pos[2] = { 0., 0. }; /**< Position of the listener. */
+static double listener_vel[2] = { 0., 0. }; /**< Velocity of the listener. */
 
 
 /*
@@ -79,7 +107,13 @@ static double snd_compression_gain = 0.; /**< Current compression gain. */
 /* General. */
 static int sound_makeList (void);
 static void sound_free( alSound *snd );
+static void sound_decode( int sound );
+static int sound_decodeJob( void *data );
+static alSound* sound_use( int sound );
+static void sound_evict( int keep );
+static int sound_lruCmp( const void *p1, const void *p2 );
 /* Voices. */
+static void voice_rm( alVoice *v );
 
 
 /**
@@ -115,6 +149,10 @@ int sound_init (void)
    if (voice_mutex == NULL)
       WARN(_("Unable to create voice mutex."));
 
+   /* Create sound loading lock. */
+   sound_listLock = SDL_CreateMutex();
+   sound_loadCond = SDL_CreateCond();
+
    /* Load available sounds. */
    ret = sound_makeList();
    if (ret != 0)
@@ -155,7 +193,6 @@ int sound_init (void)
 void sound_exit (void)
 {
    int i;
-   alVoice *v;
 
    /* Nothing to disable. */
    if (sound_disabled || !sound_initialized)
@@ -167,16 +204,14 @@ void sound_exit (void)
    if (voice_mutex != NULL) {
       voiceLock();
       /* free the voices. */
-      while (voice_active != NULL) {
-         v = voice_active;
-         voice_active = v->next;
-         free(v);
-      }
-      while (voice_pool != NULL) {
-         v = voice_pool;
-         voice_pool = v->next;
-         free(v);
-      }
+      for (i=0; i<array_size(voice_slots); i++)
+         free(voice_slots[i]);
+      array_free(voice_slots);
+      voice_slots = NULL;
+      array_free(voice_active);
+      voice_active = NULL;
+      array_free(voice_pool);
+      voice_pool = NULL;
       voiceUnlock();
 
       /* Destroy voice lock. */
@@ -184,10 +219,25 @@ void sound_exit (void)
       voice_mutex = NULL;
    }
 
+   /* Wait for the sounds being decoded. */
+   SDL_LockMutex( sound_listLock );
+   for (i=0; i<array_size(sound_list); i++)
+      while (sound_list[i].state == SOUND_LOADING)
+         SDL_CondWait( sound_loadCond, sound_listLock );
+   SDL_UnlockMutex( sound_listLock );
+
    /* free the sounds */
    for (i=0; i<array_size(sound_list); i++)
       sound_free( &sound_list[i] );
    array_free( sound_list );
+   sound_list = NULL;
+   array_free( sound_lru );
+   sound_lru = NULL;
+   sound_mem = 0;
+   SDL_DestroyCond( sound_loadCond );
+   sound_loadCond = NULL;
+   SDL_DestroyMutex( sound_listLock );
+   sound_listLock = NULL;
 
    /* Exit sound subsystem. */
    sound_al_exit();
@@ -227,10 +277,202 @@ int sound_get( const char* name )
  */
 double sound_getLength( int sound )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0.;
 
-   return sound_list[sound].length;
+   s = sound_use( sound );
+   if (s == NULL)
+      return 0.;
+   return s->length;
+}
+
+
+/**
+ * @brief Decodes a sound on a worker thread ahead of its use.
+ *
+ *    @param sound Sound to decode.
+ */
+void sound_prefetch( int sound )
+{
+   int queue;
+
+   if (sound_disabled)
+      return;
+
+   if ((sound < 0) || (sound >= array_size(sound_list)))
+      return;
+
+   SDL_LockMutex( sound_listLock );
+   queue = (sound_list[sound].state == SOUND_UNLOADED);
+   if (queue) {
+      sound_list[sound].state    = SOUND_LOADING;
+      sound_list[sound].lastuse  = ++sound_uses;
+   }
+   SDL_UnlockMutex( sound_listLock );
+
+   /* Without threadpool it'll just get decoded when used. */
+   if (queue && threadpool_newJob( sound_decodeJob, (void*)(intptr_t)sound )) {
+      SDL_LockMutex( sound_listLock );
+      sound_list[sound].state = SOUND_UNLOADED;
+      SDL_UnlockMutex( sound_listLock );
+   }
+}
+
+
+/**
+ * @brief Decodes a sound, which must have been marked as loading.
+ *
+ * Can run on any thread.
+ *
+ *    @param sound Sound to decode.
+ */
+static void sound_decode( int sound )
+{
+   alSound snd, *s;
+   const char *filename, *name;
+   SDL_RWops *rw;
+   int ret;
+
+   /* Strings are never freed while sounds are loading. */
+   SDL_LockMutex( sound_listLock );
+   filename = sound_list[sound].filename;
+   name     = sound_list[sound].name;
+   SDL_UnlockMutex( sound_listLock );
+
+   memset( &snd, 0, sizeof(alSound) );
+   ret = -1;
+   rw  = PHYSFSRWOPS_openRead( filename );
+   if (rw != NULL) {
+      ret = sound_al_load( &snd, rw, name );
+      SDL_RWclose( rw );
+   }
+   else
+      WARN(_("Unable to open sound file '%s'."), filename);
+
+   SDL_LockMutex( sound_listLock );
+   s = &sound_list[sound];
+   if (ret == 0) {
+      s->buf      = snd.buf;
+      s->length   = snd.length;
+      s->size     = snd.size;
+      s->state    = SOUND_LOADED;
+      sound_mem  += snd.size;
+   }
+   else
+      s->state    = SOUND_FAILED;
+   SDL_CondBroadcast( sound_loadCond );
+   SDL_UnlockMutex( sound_listLock );
+}
+
+
+/**
+ * @brief Threadpool wrapper of sound_decode().
+ */
+static int sound_decodeJob( void *data )
+{
+   sound_decode( (int)(intptr_t)data );
+   return 0;
+}
+
+
+/**
+ * @brief Gets a sound ready to play, decoding it if necessary.
+ *
+ *    @param sound Sound to get.
+ *    @return The decoded sound or NULL if invalid or failed to decode.
+ */
+static alSound* sound_use( int sound )
+{
+   alSound *s;
+   int decode;
+
+   if ((sound < 0) || (sound >= array_size(sound_list)))
+      return NULL;
+
+   SDL_LockMutex( sound_listLock );
+   decode = (sound_list[sound].state == SOUND_UNLOADED);
+   if (decode)
+      sound_list[sound].state = SOUND_LOADING;
+   SDL_UnlockMutex( sound_listLock );
+
+   if (decode)
+      sound_decode( sound );
+
+   /* Might be getting decoded by a worker. */
+   SDL_LockMutex( sound_listLock );
+   while (sound_list[sound].state == SOUND_LOADING)
+      SDL_CondWait( sound_loadCond, sound_listLock );
+   s = &sound_list[sound];
+   s->lastuse = ++sound_uses;
+   if (s->state != SOUND_LOADED)
+      s = NULL;
+   SDL_UnlockMutex( sound_listLock );
+
+   if (decode)
+      sound_evict( sound );
+
+   return s;
+}
+
+
+/**
+ * @brief Compares sounds by last use for qsort.
+ */
+static int sound_lruCmp( const void *p1, const void *p2 )
+{
+   unsigned int u1, u2;
+   u1 = sound_list[ *(const int*)p1 ].lastuse;
+   u2 = sound_list[ *(const int*)p2 ].lastuse;
+   return (u1 > u2) - (u1 < u2);
+}
+
+
+/**
+ * @brief Frees the least recently used buffers until under the memory budget.
+ *
+ * Buffers that are still attached to a source are skipped.
+ *
+ *    @param keep Sound not to free, or -1.
+ */
+static void sound_evict( int keep )
+{
+   int i, n;
+   size_t budget;
+   alSound *s;
+
+   budget = (size_t)MAX( 0, conf.snd_budget ) * 1024 * 1024;
+   if (sound_mem <= budget)
+      return;
+
+   SDL_LockMutex( sound_listLock );
+
+   /* Sounds without file were created directly and can't be decoded again. */
+   if (sound_lru == NULL)
+      sound_lru = array_create( int );
+   array_resize( &sound_lru, 0 );
+   for (i=0; i<array_size(sound_list); i++)
+      if ((i != keep) && (sound_list[i].state == SOUND_LOADED) &&
+            (sound_list[i].filename != NULL))
+         array_push_back( &sound_lru, i );
+   qsort( sound_lru, array_size(sound_lru), sizeof(int), sound_lruCmp );
+
+   n = 0;
+   for (i=0; (i<array_size(sound_lru)) && (sound_mem > budget); i++) {
+      s = &sound_list[ sound_lru[i] ];
+      if (sound_al_unload( s ))
+         continue;
+      sound_mem  -= s->size;
+      s->size     = 0;
+      s->state    = SOUND_UNLOADED;
+      n++;
+   }
+
+   SDL_UnlockMutex( sound_listLock );
+
+   if (n > 0)
+      DEBUG( n_( "Freed %d unused sound buffer", "Freed %d unused sound buffers", n ), n );
 }
 
 
@@ -248,14 +490,15 @@ int sound_play( int sound )
    if (sound_disabled)
       return 0;
 
-   if ((sound < 0) || (sound >= array_size(sound_list)))
+   /* Get the sound. */
+   s = sound_use( sound );
+   if (s == NULL)
       return -1;
 
    /* Gets a new voice. */
    v = voice_new();
-
-   /* Get the sound. */
-   s = &sound_list[sound];
+   if (v == NULL)
+      return -1;
 
    /* Try to play the sound. */
    if (sound_al_play( v, s ))
@@ -263,7 +506,6 @@ int sound_play( int sound )
 
    /* Set state and add to list. */
    v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
    voice_add(v);
 
    return v->id;
@@ -310,11 +552,15 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
          return 0;
    }
 
+   /* Get the sound. */
+   s = sound_use( sound );
+   if (s == NULL)
+      return -1;
+
    /* Gets a new voice. */
    v = voice_new();
-
-   /* Get the sound. */
-   s = &sound_list[sound];
+   if (v == NULL)
+      return -1;
 
    /* Try to play the sound. */
    if (sound_al_playPos( v, s, px, py, vx, vy ))
@@ -322,7 +568,6 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
 
    /* Actually add the voice to the list. */
    v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
    voice_add(v);
 
    return v->id;
@@ -364,7 +609,8 @@ int sound_updatePos( int voice, double px, double py, double vx, double vy )
  */
 int sound_update( double dt )
 {
-   alVoice *v, *tv;
+   int i;
+   alVoice *v;
 
    /* Update music if needed. */
    music_update(dt);
@@ -375,49 +621,28 @@ int sound_update( double dt )
    /* System update. */
    sound_al_update();
 
-   if (voice_active == NULL)
-      return 0;
+   /* Buffers decoded ahead might have gone over budget. */
+   sound_evict( -1 );
 
-   voiceLock();
+   /* Listener moved during the last frame. */
+   if (listener_dirty) {
+      sound_al_updateListener( listener_dir, listener_pos[0], listener_pos[1],
+            listener_vel[0], listener_vel[1] );
+      listener_dirty = 0;
+   }
 
-   /* The actual control loop. */
-   for (v=voice_active; v!=NULL; v=v->next) {
+   /* The actual control loop, backwards as stopped voices are swapped out. */
+   for (i=array_size(voice_active)-1; i>=0; i--) {
+      v = voice_active[i];
 
       /* Run first to clear in same iteration. */
       sound_al_updateVoice( v );
 
       /* Destroy and toss into pool. */
-      if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY)) {
-
-         /* Remove from active list. */
-         tv = v->prev;
-         if (tv == NULL) {
-            voice_active = v->next;
-            if (voice_active != NULL)
-               voice_active->prev = NULL;
-         }
-         else {
-            tv->next = v->next;
-            if (tv->next != NULL)
-               tv->next->prev = tv;
-         }
-
-         /* Add to free pool. */
-         v->next = voice_pool;
-         v->prev = NULL;
-         voice_pool = v;
-         if (v->next != NULL)
-            v->next->prev = v;
-
-         /* Avoid loop blockage. */
-         v = (tv != NULL) ? tv->next : voice_active;
-         if (v == NULL)
-            break;
-      }
+      if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY))
+         voice_rm( v );
    }
 
-   voiceUnlock();
-
    return 0;
 }
 
@@ -457,21 +682,17 @@ void sound_resume (void)
  */
 void sound_stopAll (void)
 {
+   int i;
    alVoice *v;
 
    if (sound_disabled)
       return;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
-      return;
-
-   voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next) {
+   for (i=0; i<array_size(voice_active); i++) {
+      v = voice_active[i];
       sound_al_stop( v );
       v->state = VOICE_STOPPED;
    }
-   voiceUnlock();
 }
 
 
@@ -506,6 +727,9 @@ void sound_stop( int voice )
  *    @param vy Y velocity of the listener.
  *    @return 0 on success.
  *
+ * The listener is only sent to OpenAL once per frame by sound_update(), so
+ * it can be called several times a frame at no cost.
+ *
  * @sa sound_playPos
  */
 int sound_updateListener( double dir, double px, double py,
@@ -514,7 +738,13 @@ int sound_updateListener( double dir, double px, double py,
    if (sound_disabled)
       return 0;
 
-   return sound_al_updateListener( dir, px, py, vx, vy );
+   listener_dir      = dir;
+   listener_pos[0]   = px;
+   listener_pos[1]   = py;
+   listener_vel[0]   = vx;
+   listener_vel[1]   = vy;
+   listener_dirty    = 1;
+   return 0;
 }
 
 
@@ -559,6 +789,8 @@ void sound_setSpeed( double s )
 
 /**
  * @brief Makes the list of available sounds.
+ *
+ * Sounds are only registered here, they get decoded when first used.
  */
 static int sound_makeList (void)
 {
@@ -566,7 +798,7 @@ static int sound_makeList (void)
    size_t i;
    char path[PATH_MAX];
    int len, suflen, flen;
-   SDL_RWops *rw;
+   alSound *snd;
 
    if (sound_disabled)
       return 0;
@@ -591,19 +823,21 @@ static int sound_makeList (void)
             (strncmp( &files[i][flen - suflen], SOUND_SUFFIX_OGG, suflen)!=0))
          continue;
 
-      /* Load the sound. */
+      /* Register the sound. */
       nsnprintf( path, PATH_MAX, SOUND_PATH"%s", files[i] );
-      rw = PHYSFSRWOPS_openRead( path );
 
       /* remove the suffix */
       len = flen - suflen;
       files[i][len] = '\0';
 
-      source_newRW( rw, files[i], 0 );
-      SDL_RWclose( rw );
+      snd = &array_grow( &sound_list );
+      memset( snd, 0, sizeof(alSound) );
+      snd->filename  = strdup( path );
+      snd->name      = strdup( files[i] );
+      snd->state     = SOUND_UNLOADED;
    }
 
-   DEBUG( n_("Loaded %d Sound", "Loaded %d Sounds", array_size(sound_list)), array_size(sound_list) );
+   DEBUG( n_("Registered %d Sound", "Registered %d Sounds", array_size(sound_list)), array_size(sound_list) );
 
    /* Clean up. */
    PHYSFS_freeList( files );
@@ -667,7 +901,8 @@ static void sound_free( alSound *snd )
    free(snd->filename);
 
    /* Free internals. */
-   sound_al_free(snd);
+   if (snd->state == SOUND_LOADED)
+      sound_al_free(snd);
 }
 
 
@@ -696,13 +931,16 @@ int sound_createGroup( int size )
  */
 int sound_playGroup( int group, int sound, int once )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0;
 
-   if ((sound < 0) || (sound >= array_size(sound_list)))
+   s = sound_use( sound );
+   if (s == NULL)
       return -1;
 
-   return sound_al_playGroup( group, &sound_list[sound], once );
+   return sound_al_playGroup( group, s, once );
 }
 
 
@@ -815,81 +1053,115 @@ void voice_unlock (void)
 /**
  * @brief Gets a new voice ready to be used.
  *
+ * The voice stays in the pool until it is added with voice_add().
+ *
  *    @return New voice ready to use.
  */
 alVoice* voice_new (void)
 {
    alVoice *v;
 
+   if (voice_slots == NULL) {
+      voice_slots    = array_create( alVoice* );
+      voice_active   = array_create( alVoice* );
+      voice_pool     = array_create( int );
+   }
+
    /* No free voices, allocate a new one. */
-   if (voice_pool == NULL) {
-      v = calloc( 1, sizeof(alVoice) );
-      voice_pool = v;
+   if (array_size(voice_pool) == 0) {
+      if (array_size(voice_slots) > VOICE_SLOT_MASK) {
+         WARN(_("Out of voice slots!"));
+         return NULL;
+      }
+      v           = calloc( 1, sizeof(alVoice) );
+      v->slot     = array_size(voice_slots);
+      v->active   = -1;
+      voiceLock();
+      array_push_back( &voice_slots, v );
+      array_push_back( &voice_pool, v->slot );
+      voiceUnlock();
       return v;
    }
 
    /* First free voice. */
-   v = voice_pool; /* We do not touch the next nor prev, it's still in the pool. */
-   return v;
+   return voice_slots[ voice_pool[ array_size(voice_pool)-1 ] ];
 }
 
 
 /**
  * @brief Adds a voice to the active voice stack.
  *
- *    @param v Voice to add to the active voice stack.
+ * Also gives the voice a new identifier.
+ *
+ *    @param v Voice to add to the active voice stack, from voice_new().
  *    @return 0 on success.
  */
 int voice_add( alVoice* v )
 {
-   alVoice *tv;
+   int n;
 
-   /* Remove from pool. */
-   if (v->prev != NULL) {
-      tv = v->prev;
-      tv->next = v->next;
-      if (tv->next != NULL)
-         tv->next->prev = tv;
-   }
-   else { /* Set pool to be the next. */
-      voice_pool = v->next;
-      if (voice_pool != NULL)
-         voice_pool->prev = NULL;
+   /* Remove from pool, it's always the last one. */
+   n = array_size(voice_pool);
+   if ((n == 0) || (voice_pool[n-1] != v->slot)) {
+      WARN(_("Adding voice that was not obtained from voice_new()!"));
+      return -1;
    }
 
-   /* Insert to the front of active voices. */
    voiceLock();
-   tv = voice_active;
-   v->next = tv;
-   v->prev = NULL;
-   voice_active = v;
-   if (tv != NULL)
-      tv->prev = v;
+   array_resize( &voice_pool, n-1 );
+   v->gen      = (v->gen % VOICE_GEN_MAX) + 1;
+   v->id       = (v->gen << VOICE_SLOT_BITS) | v->slot;
+   v->active   = array_size(voice_active);
+   array_push_back( &voice_active, v );
    voiceUnlock();
    return 0;
 }
 
 
+/**
+ * @brief Removes a voice from the active voice stack, putting it in the pool.
+ *
+ *    @param v Voice to remove.
+ */
+static void voice_rm( alVoice *v )
+{
+   alVoice *last;
+
+   voiceLock();
+   last = voice_active[ array_size(voice_active)-1 ];
+   voice_active[ v->active ] = last;
+   last->active = v->active;
+   array_resize( &voice_active, array_size(voice_active)-1 );
+   v->active   = -1;
+   v->id       = 0;
+   array_push_back( &voice_pool, v->slot );
+   voiceUnlock();
+}
+
+
 /**
  * @brief Gets a voice by identifier.
  *
+ * Doesn't need the lock as voices are never freed while the sound is running.
+ *
  *    @param id Identifier to look for.
  *    @return Voice matching identifier or NULL if not found.
  */
 alVoice* voice_get( int id )
 {
    alVoice *v;
+   int slot;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
+   if (id <= 0)
       return NULL;
 
-   voiceLock();
-   for (v=voice_active; v!=NULL; v=v->next)
-      if (v->id == id)
-         break;
-   voiceUnlock();
+   slot = id & VOICE_SLOT_MASK;
+   if (slot >= array_size(voice_slots))
+      return NULL;
 
+   v = voice_slots[slot];
+   if (v->id != id)
+      return NULL;
    return v;
 }
 
@@ -910,10 +1182,16 @@ int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
    ret = sound_al_load( &snd, rw, name );
    if (ret)
       return -1;
+   snd.state = SOUND_LOADED;
 
+   /* Workers only touch the list with the lock held. */
+   SDL_LockMutex( sound_listLock );
    sndl = &array_grow( &sound_list );
    memcpy( sndl, &snd, sizeof(alSound) );
    sndl->name = strdup( name );
+   sndl->lastuse = ++sound_uses;
+   sound_mem += snd.size;
+   SDL_UnlockMutex( sound_listLock );
 
    return sndl-sound_list;
 }
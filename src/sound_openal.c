@@ -742,6 +742,7 @@ int sound_al_load( alSound *snd, SDL_RWops *rw, const char *name )
    }
    else
       snd->length = (double)size / (double)(freq * (bits/8) * channels);
+   snd->size = MAX( 0, size );
 
    /* Check for errors. */
    al_checkErr();
@@ -766,6 +767,32 @@ void sound_al_free( alSound *snd )
 }
 
 
+/**
+ * @brief Frees the buffer of a sound if no source is using it.
+ *
+ *    @param snd Sound to unload.
+ *    @return 0 if it was freed, -1 if it's still attached to a source.
+ */
+int sound_al_unload( alSound *snd )
+{
+   ALenum err;
+
+   soundLock();
+
+   /* OpenAL refuses to delete buffers attached to sources. */
+   alGetError();
+   alDeleteBuffers( 1, &snd->buf );
+   err = alGetError();
+
+   soundUnlock();
+
+   if (err != AL_NO_ERROR)
+      return -1;
+   snd->buf = 0;
+   return 0;
+}
+
+
 /**
  * @brief Internal volume update function.
  */
@@ -875,6 +902,7 @@ static int al_playVoice( alVoice *v, alSound *s,
    v->vel[0] = vx;
    v->vel[1] = vy;
    v->vel[2] = 0.;
+   v->flags &= ~VOICE_MOVED;
 
    /* Set up properties. */
    alSourcef(  v->source, AL_GAIN, svolume*svolume_speed );
@@ -937,6 +965,7 @@ int sound_al_updatePos( alVoice *v,
    v->pos[1] = py;
    v->vel[0] = vx;
    v->vel[1] = vy;
+   v->flags |= VOICE_MOVED; /* Sent to OpenAL by sound_al_updateVoice(). */
 
    return 0;
 }
@@ -981,10 +1010,13 @@ void sound_al_updateVoice( alVoice *v )
       return;
    }
 
-   /* Set up properties. */
+   /* Set up properties, the position only if it moved since last frame. */
    alSourcef(  v->source, AL_GAIN, svolume*svolume_speed );
-   alSourcefv( v->source, AL_POSITION, v->pos );
-   alSourcefv( v->source, AL_VELOCITY, v->vel );
+   if (v->flags & VOICE_MOVED) {
+      alSourcefv( v->source, AL_POSITION, v->pos );
+      alSourcefv( v->source, AL_VELOCITY, v->vel );
+      v->flags &= ~VOICE_MOVED;
+   }
 
    /* Check for errors. */
    al_checkErr();
@@ -17,6 +17,17 @@
 #include "sound.h"
 
 
+/**
+ * @brief Loading state of a sound.
+ */
+typedef enum sound_state_ {
+   SOUND_UNLOADED, /**< Registered but not decoded. */
+   SOUND_LOADING, /**< Being decoded by a worker thread. */
+   SOUND_LOADED, /**< Buffer is ready. */
+   SOUND_FAILED /**< Failed to decode, won't be tried again. */
+} sound_state_t;
+
+
 /**
  * @struct alSound
  *
@@ -27,6 +38,9 @@ typedef struct alSound_ {
    char *name; /**< Buffer's name. */
    double length; /**< Length of the buffer. */
    ALuint buf; /**< Buffer data. */
+   size_t size; /**< Size of the buffer data in bytes. */
+   sound_state_t state; /**< Loading state. */
+   unsigned int lastuse; /**< Use counter value when it was last used. */
 } alSound;
 
 
@@ -43,6 +57,12 @@ typedef enum voice_state_ {
 } voice_state_t;
 
 
+/*
+ * Voice flags.
+ */
+#define VOICE_MOVED     (1<<0) /**< Position changed since it was last sent to OpenAL. */
+
+
 /**
  * @struct alVoice
  *
@@ -51,10 +71,10 @@ typedef enum voice_state_ {
  * A voice would be any object that is creating sound.
  */
 typedef struct alVoice_ {
-   struct alVoice_ *prev; /**< Linked list previous member. */
-   struct alVoice_ *next; /**< Linked list next member. */
-
-   int id; /**< Identifier of the voice. */
+   int slot; /**< Slot of the voice in the voice table. */
+   int gen; /**< Times the slot was used, tags the identifier. */
+   int active; /**< Position in the active voices, -1 if free. */
+   int id; /**< Identifier of the voice, 0 if free. */
 
    voice_state_t state; /**< Current state of the sound. */
    unsigned int flags; /**< Voice flags. */
@@ -66,12 +86,6 @@ typedef struct alVoice_ {
 } alVoice;
 
 
-/*
- * Sound list.
- */
-extern alVoice *voice_active; /**< Active voices. */
-
-
 /*
  * Voice management.
  */
@@ -117,6 +131,7 @@ void sound_al_exit (void);
 int sound_al_buffer( ALuint *buf, SDL_RWops *rw, const char *name );
 int sound_al_load( alSound *snd, SDL_RWops *rw, const char *name );
 void sound_al_free( alSound *snd );
+int sound_al_unload( alSound *snd );
 
 
 /*
@@ -13,6 +13,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include "physfs.h"
+#include "SDL.h"
 
 #include "naev.h"
 /** @endcond */
@@ -50,7 +51,9 @@
 #include "queue.h"
 #include "rng.h"
 #include "sound.h"
+#include "space_cache.h"
 #include "spfx.h"
+#include "strindex.h"
 #include "toolkit.h"
 #include "weapon.h"
 
@@ -98,6 +101,10 @@ static AsteroidType *asteroid_types = NULL; /**< Asteroid types stack. */
  * Misc.
  */
 static int systems_loading = 1; /**< Systems are loading. */
+static StrIndex *systems_index = NULL; /**< Name index of systems_stack. */
+static int systems_indexDirty = 1; /**< systems_index needs to be rebuilt. */
+static StrIndex *planets_index = NULL; /**< Name index of planet_stack. */
+static int planets_indexDirty = 1; /**< planets_index needs to be rebuilt. */
 StarSystem *cur_system = NULL; /**< Current star system. */
 glTexture *jumppoint_gfx = NULL; /**< Jump point graphics. */
 static glTexture *jumpbuoy_gfx = NULL; /**< Jump buoy graphics. */
@@ -126,6 +133,7 @@ static double interference_timer  = 0.; /**< Interference timer. */
  * Internal Prototypes.
  */
 /* planet load */
+static void planets_loadLanding (void);
 static int planet_parse( Planet *planet, const xmlNodePtr parent, Commodity **stdList );
 static int space_parseAssets( xmlNodePtr parent, StarSystem* sys );
 /* system load */
@@ -142,8 +150,11 @@ static int system_parseJumpPointDiff( const xmlNodePtr node, StarSystem *sys );
 static void system_parseJumps( const xmlNodePtr parent );
 static void system_parseAsteroids( const xmlNodePtr parent, StarSystem *sys );
 /* misc */
+static const StrIndex* systems_getIndex (void);
+static const StrIndex* planets_getIndex (void);
 static int getPresenceIndex( StarSystem *sys, int faction );
 static void system_scheduler( double dt, int init );
+static void space_prefetchSounds (void);
 static void asteroid_explode ( Asteroid *a, AsteroidAnchor *field, int give_reward );
 /* Render. */
 static void space_renderJumpPoint( JumpPoint *jp, int i );
@@ -697,17 +708,9 @@ int space_sysReachable( StarSystem *sys )
  */
 int space_sysReallyReachable( char* sysname )
 {
-   int njumps;
-   StarSystem** path;
-
    if (strcmp(sysname,cur_system->name)==0)
       return 1;
-   path = map_getJumpPath( &njumps, cur_system->name, sysname, 1, 1, NULL );
-   if (path != NULL) {
-      free(path);
-      return 1;
-   }
-   return 0;
+   return (map_jumpDistance( system_get(sysname), 1, 1 ) > 0);
 }
 
 /**
@@ -786,6 +789,66 @@ char **system_searchFuzzyCase( const char* sysname, int *n )
 
 
 
+/**
+ * @brief Gets the name index of the systems, rebuilding it if needed.
+ *
+ *    @return The system name index.
+ */
+static const StrIndex* systems_getIndex (void)
+{
+   int i;
+
+   if (!systems_indexDirty)
+      return systems_index;
+
+   if (systems_index == NULL)
+      systems_index = strindex_create( array_size(systems_stack) );
+   else
+      strindex_clear( systems_index );
+   for (i=0; i<array_size(systems_stack); i++)
+      if (systems_stack[i].name != NULL)
+         strindex_add( systems_index, systems_stack[i].name, i );
+   systems_indexDirty = 0;
+   return systems_index;
+}
+
+
+/**
+ * @brief Gets the name index of the planets, rebuilding it if needed.
+ *
+ *    @return The planet name index.
+ */
+static const StrIndex* planets_getIndex (void)
+{
+   int i;
+
+   if (!planets_indexDirty)
+      return planets_index;
+
+   if (planets_index == NULL)
+      planets_index = strindex_create( array_size(planet_stack) );
+   else
+      strindex_clear( planets_index );
+   for (i=0; i<array_size(planet_stack); i++)
+      if (planet_stack[i].name != NULL)
+         strindex_add( planets_index, planet_stack[i].name, i );
+   planets_indexDirty = 0;
+   return planets_index;
+}
+
+
+/**
+ * @brief Marks the system and planet name indices as stale.
+ *
+ * Must be called whenever a system or planet gets renamed.
+ */
+void space_invalidateIndex (void)
+{
+   systems_indexDirty = 1;
+   planets_indexDirty  = 1;
+}
+
+
 /**
  * @brief Get the system from its name.
  *
@@ -799,9 +862,9 @@ StarSystem* system_get( const char* sysname )
    if ( sysname == NULL )
       return NULL;
 
-   for (i=0; i<array_size(systems_stack); i++)
-      if (strcmp(sysname, systems_stack[i].name)==0)
-         return &systems_stack[i];
+   i = strindex_get( systems_getIndex(), sysname );
+   if (i >= 0)
+      return &systems_stack[i];
 
    WARN(_("System '%s' not found in stack"), sysname);
    return NULL;
@@ -884,9 +947,9 @@ Planet* planet_get( const char* planetname )
       return NULL;
    }
 
-   for (i=0; i<array_size(planet_stack); i++)
-      if (strcmp(planet_stack[i].name,planetname)==0)
-         return &planet_stack[i];
+   i = strindex_get( planets_getIndex(), planetname );
+   if (i >= 0)
+      return &planet_stack[i];
 
    WARN(_("Planet '%s' not found in the universe"), planetname);
    return NULL;
@@ -950,11 +1013,7 @@ void planet_setKnown( Planet *p )
  */
 int planet_exists( const char* planetname )
 {
-   int i;
-   for (i=0; i<array_size(planet_stack); i++)
-      if (strcmp(planet_stack[i].name,planetname)==0)
-         return 1;
-   return 0;
+   return (strindex_get( planets_getIndex(), planetname ) >= 0);
 }
 
 
@@ -1317,6 +1376,7 @@ void space_update( const double dt )
       for (i=0; i<array_size(cur_system->jumps); i++) {
          if (( !jp_isKnown( &cur_system->jumps[i] )) && ( pilot_inRangeJump( player.p, i ))) {
             jp_setFlag( &cur_system->jumps[i], JP_KNOWN );
+            map_invalidateDistances();
             player_message( _("You discovered a Jump Point.") );
             hparam[0].type  = HOOK_PARAM_STRING;
             hparam[0].u.str = "jump";
@@ -1437,6 +1497,7 @@ void space_init( const char* sysname )
 {
    char* nt;
    int i, j, n, s;
+   unsigned int ticks;
    Planet *pnt;
    AsteroidAnchor *ast;
    Asteroid *a;
@@ -1461,11 +1522,8 @@ void space_init( const char* sysname )
    if ((sysname==NULL) && (cur_system==NULL))
       ERR(_("Cannot reinit system if there is no system previously loaded"));
    else if (sysname!=NULL) {
-      for (i=0; i < array_size(systems_stack); i++)
-         if (strcmp(sysname, systems_stack[i].name)==0)
-            break;
-
-      if (i>=array_size(systems_stack))
+      i = strindex_get( systems_getIndex(), sysname );
+      if (i < 0)
          ERR(_("System %s not found in stack"), sysname);
       cur_system = &systems_stack[i];
 
@@ -1552,8 +1610,12 @@ void space_init( const char* sysname )
 
    /* we now know this system */
    sys_setFlag(cur_system,SYSTEM_KNOWN);
+   map_invalidateDistances();
 
-   /* Simulate system. */
+   /* Simulate system. Only the game state matters, so visual only stuff is
+    * skipped (see space_isSimulation). The timestep can't be coarser than
+    * fps_min or bolts start tunneling through ships. */
+   ticks = SDL_GetTicks();
    space_simulating = 1;
    if (player.p != NULL)
       pilot_setFlag( player.p, PILOT_INVISIBLE );
@@ -1570,6 +1632,14 @@ void space_init( const char* sysname )
    if (player.p != NULL)
       pilot_rmFlag( player.p, PILOT_INVISIBLE );
    space_simulating = 0;
+   DEBUG( _("Simulated system '%s' in %u ms (%d pilots)"), cur_system->name,
+         SDL_GetTicks() - ticks, array_size( pilot_getAll() ) );
+
+   /* Drop ship graphics nobody in the new system uses. */
+   ships_gfxEvict();
+
+   /* Decode ahead the sounds the pilots in the new system will make. */
+   space_prefetchSounds();
 
    /* Refresh overlay if necessary (player kept it open). */
    ovr_refresh();
@@ -1582,6 +1652,27 @@ void space_init( const char* sysname )
 }
 
 
+/**
+ * @brief Queues the sounds of the pilots in the system to be decoded ahead.
+ */
+static void space_prefetchSounds (void)
+{
+   int i, j;
+   Pilot **pilots;
+   PilotOutfitSlot *slot;
+
+   pilots = pilot_getAll();
+   for (i=0; i<array_size(pilots); i++) {
+      sound_prefetch( pilots[i]->ship->sound );
+      for (j=0; j<array_size(pilots[i]->outfits); j++) {
+         slot = pilots[i]->outfits[j];
+         if (slot->outfit != NULL)
+            outfit_prefetchSounds( slot->outfit );
+      }
+   }
+}
+
+
 /**
  * @brief Initializes an asteroid.
  *    @param ast Asteroid to initialize.
@@ -1684,21 +1775,13 @@ Planet *planet_new (void)
 
 
 /**
- * @brief Loads all the planets in the game.
- *
- *    @return 0 on success.
+ * @brief Loads the landing script used by the planets.
  */
-static int planets_load ( void )
+static void planets_loadLanding (void)
 {
    size_t bufsize;
-   char *buf, **planet_files, *file;
-   xmlNodePtr node;
-   xmlDocPtr doc;
-   Planet *p;
-   size_t i, len;
-   Commodity **stdList;
+   char *buf;
 
-   /* Load landing stuff. */
    landing_env = nlua_newEnv(0);
    nlua_loadStandard(landing_env);
    buf         = ndata_read( LANDING_DATA_PATH, &bufsize );
@@ -1709,6 +1792,22 @@ static int planets_load ( void )
             LANDING_DATA_PATH, lua_tostring(naevL,-1));
    }
    free(buf);
+}
+
+
+/**
+ * @brief Loads all the planets in the game.
+ *
+ *    @return 0 on success.
+ */
+static int planets_load ( void )
+{
+   char **planet_files, *file;
+   xmlNodePtr node;
+   xmlDocPtr doc;
+   Planet *p;
+   size_t i, len;
+   Commodity **stdList;
 
    /* Initialize stack if needed. */
    if (planet_stack == NULL)
@@ -1740,6 +1839,8 @@ static int planets_load ( void )
       if (xml_isNode(node,XML_PLANET_TAG)) {
          p = planet_new();
          planet_parse( p, node, stdList );
+         /* Only index it once it has its name. */
+         planets_indexDirty = 1;
       }
 
       /* Clean up. */
@@ -2269,7 +2370,8 @@ int system_rmPlanet( StarSystem *sys, const char *planetname )
 /**
  * @brief Adds a jump point to a star system from a diff.
  *
- * Note that economy_execQueued should always be run after this.
+ * Note that systems_reconstructJumps and economy_execQueued should always be
+ * run after this.
  *
  *    @param sys Star System to add jump point to.
  *    @param node Parent node containing jump point information.
@@ -2279,7 +2381,6 @@ int system_addJumpDiff( StarSystem *sys, xmlNodePtr node )
 {
    if (system_parseJumpPointDiff(node, sys) <= -1)
       return 0;
-   systems_reconstructJumps();
    economy_addQueuedUpdate();
 
    return 1;
@@ -2309,7 +2410,8 @@ int system_addJump( StarSystem *sys, xmlNodePtr node )
 /**
  * @brief Removes a jump point from a star system.
  *
- * Note that economy_execQueued should always be run after this.
+ * Note that systems_reconstructJumps and economy_execQueued should always be
+ * run after this.
  *
  *    @param sys Star System to remove jump point from.
  *    @param jumpname Name of the jump point to remove.
@@ -2387,6 +2489,7 @@ StarSystem *system_new (void)
    /* Initialize system and id. */
    system_init( sys );
    sys->id = array_size(systems_stack)-1;
+   systems_indexDirty = 1;
 
    /* Reconstruct the jumps, only truely necessary if the systems realloced. */
    if (!systems_loading)
@@ -2445,6 +2548,8 @@ void systems_reconstructJumps (void)
       sys = &systems_stack[i];
       system_reconstructJumps(sys);
    }
+
+   map_invalidateDistances();
 }
 
 
@@ -2802,13 +2907,8 @@ static void system_parseJumps( const xmlNodePtr parent )
    xmlNodePtr cur, node;
 
    xmlr_attr_strd( parent, "name", name );
-   sys = NULL;
-   for (i=0; i<array_size(systems_stack); i++) {
-      if (strcmp( systems_stack[i].name, name)==0) {
-         sys = &systems_stack[i];
-         break;
-      }
-   }
+   i   = strindex_get( systems_getIndex(), name );
+   sys = (i >= 0) ? &systems_stack[i] : NULL;
    if (sys == NULL) {
       WARN(_("System '%s' was not found in the stack for some reason"),name);
       return;
@@ -3022,20 +3122,30 @@ int space_load (void)
    jumppoint_gfx = gl_newSprite(  PLANET_GFX_SPACE_PATH"jumppoint.webp", 4, 4, OPENGL_TEX_MIPMAPS );
    jumpbuoy_gfx = gl_newImage(  PLANET_GFX_SPACE_PATH"jumpbuoy.webp", 0 );
 
-   /* Load planets. */
-   ret = planets_load();
-   if (ret < 0)
-      return ret;
+   /* Load landing script, needed by the planets. */
+   planets_loadLanding();
 
-   /* Load asteroid types. */
+   /* Load asteroid types, needed by the systems. */
    ret = asteroidTypes_load();
    if (ret < 0)
       return ret;
 
-   /* Load systems. */
-   ret = systems_load();
-   if (ret < 0)
-      return ret;
+   /* Load planets and systems, from the binary cache if it is up to date. */
+   if (planet_stack == NULL)
+      planet_stack = array_create_size(Planet, 256);
+   if (systems_stack == NULL)
+      systems_stack = array_create( StarSystem );
+   if (space_cacheLoad() != 0) {
+      ret = planets_load();
+      if (ret < 0)
+         return ret;
+
+      ret = systems_load();
+      if (ret < 0)
+         return ret;
+
+      space_cacheSave();
+   }
 
    /* Load asteroid graphics. */
    asteroid_files = PHYSFS_enumerateFiles( PLANET_GFX_SPACE_PATH"asteroid/" );
@@ -3190,7 +3300,7 @@ static int systems_load (void)
 {
    char **system_files, *file;
    xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlDocPtr doc, *docs;
    StarSystem *sys;
    size_t i, len;
 
@@ -3199,6 +3309,7 @@ static int systems_load (void)
       systems_stack = array_create( StarSystem );
 
    system_files = PHYSFS_enumerateFiles( SYSTEM_DATA_PATH );
+   docs = array_create( xmlDocPtr );
 
    /*
     * First pass - loads all the star systems_stack.
@@ -3209,13 +3320,16 @@ static int systems_load (void)
       nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
       /* Load the file. */
       doc = xml_parsePhysFS( file );
-      if (doc == NULL)
+      if (doc == NULL) {
+         free( file );
          continue;
+      }
 
       node = doc->xmlChildrenNode; /* first planet node */
       if (node == NULL) {
          WARN(_("Malformed %s file: does not contain elements"),file);
          xmlFreeDoc(doc);
+         free( file );
          continue;
       }
 
@@ -3223,36 +3337,19 @@ static int systems_load (void)
       system_parse( sys, node );
       system_parseAsteroids(node, sys); /* load the asteroids anchors */
 
-      /* Clean up. */
-      xmlFreeDoc(doc);
+      /* Keep the document for the second pass. */
+      array_push_back( &docs, doc );
       free( file );
    }
 
    /*
     * Second pass - loads all the jump routes.
     */
-   for (i=0; system_files[i]!=NULL; i++) {
-      len  = strlen(SYSTEM_DATA_PATH)+strlen(system_files[i])+2;
-      file = malloc( len );
-      nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      doc = xml_parsePhysFS( file );
-      free( file );
-      file = NULL;
-      if (doc == NULL)
-         continue;
-
-      node = doc->xmlChildrenNode; /* first planet node */
-      if (node == NULL) {
-         xmlFreeDoc(doc);
-         continue;
-      }
-
-      system_parseJumps(node); /* will automatically load the jumps into the system */
-
-      /* Clean up. */
-      xmlFreeDoc(doc);
+   for (i=0; i<(size_t)array_size(docs); i++) {
+      system_parseJumps( docs[i]->xmlChildrenNode ); /* will automatically load the jumps into the system */
+      xmlFreeDoc( docs[i] );
    }
+   array_free( docs );
 
    DEBUG( n_( "Loaded %d Star System", "Loaded %d Star Systems", array_size(systems_stack) ), array_size(systems_stack) );
    DEBUG( n_( "       with %d Planet", "       with %d Planets", array_size(planet_stack) ), array_size(planet_stack) );
@@ -3301,6 +3398,7 @@ void space_renderOverlay( const double dt )
    pplayer = pilot_get( PLAYER_ID );
    if (pplayer != NULL) {
       psolid  = pplayer->solid;
+      gl_batchBegin();
       for (i=0; i < array_size(cur_system->asteroids); i++) {
          ast = &cur_system->asteroids[i];
          x = psolid->pos.x - SCREEN_W/2;
@@ -3310,6 +3408,7 @@ void space_renderOverlay( const double dt )
               space_renderDebris( &ast->debris[j], x, y );
          }
       }
+      gl_batchEnd();
    }
 
    if ((cur_system->nebu_density > 0.) &&
@@ -3333,6 +3432,8 @@ void planets_render (void)
    if (cur_system==NULL)
       return;
 
+   gl_batchBegin();
+
    /* Render the jumps. */
    for (i=0; i < array_size(cur_system->jumps); i++)
       space_renderJumpPoint( &cur_system->jumps[i], i );
@@ -3366,6 +3467,7 @@ void planets_render (void)
    /* Render gatherable stuff. */
    gatherable_render();
 
+   gl_batchEnd();
 }
 
 
@@ -3436,10 +3538,13 @@ static void space_renderAsteroid( Asteroid *a )
 
    /* Add the commodities if scanned. */
    if (!a->scanned) return;
-   gl_gameToScreenCoords( &nx, &ny, a->pos.x, a->pos.y );
    for (i=0; i<array_size(at->material); i++) {
       com = at->material[i];
       gl_blitSprite( com->gfx_space, a->pos.x, a->pos.y-10.*i, 0, 0, NULL );
+   }
+   gl_batchFlush(); /* Text isn't batched, so it has to go over the icons. */
+   gl_gameToScreenCoords( &nx, &ny, a->pos.x, a->pos.y );
+   for (i=0; i<array_size(at->material); i++) {
       nsnprintf(c, sizeof(c), "x%i", at->quantity[i]);
       gl_printRaw( &gl_smallFont, nx+10, ny-5-10.*i, &cFontWhite, -1., c );
    }
@@ -3468,30 +3573,20 @@ static void space_renderDebris( Debris *d, double x, double y )
 
 
 /**
- * @brief Cleans up the system.
+ * @brief Frees all the planets and star systems, leaving the stacks empty.
  */
-void space_exit (void)
+void space_freeUniverse (void)
 {
    int i, j;
    Planet *pnt;
    AsteroidAnchor *ast;
    StarSystem *sys;
-   AsteroidType *at;
 
-   /* Free standalone graphic textures */
-   gl_freeTexture(jumppoint_gfx);
-   jumppoint_gfx = NULL;
-   gl_freeTexture(jumpbuoy_gfx);
-   jumpbuoy_gfx = NULL;
-
-   /* Free asteroid graphics. */
-   for (i=0; i<(int)nasterogfx; i++)
-      gl_freeTexture(asteroid_gfx[i]);
-   free(asteroid_gfx);
-
-   /* Free the names. */
-   array_free(planetname_stack);
-   array_free(systemname_stack);
+   /* The name stacks point into the planets and systems. */
+   if (planetname_stack != NULL)
+      array_resize( &planetname_stack, 0 );
+   if (systemname_stack != NULL)
+      array_resize( &systemname_stack, 0 );
 
    /* Free the planets. */
    for (i=0; i < array_size(planet_stack); i++) {
@@ -3528,6 +3623,10 @@ void space_exit (void)
       array_free(pnt->commodityPrice);
    }
    array_free(planet_stack);
+   planet_stack = NULL;
+   strindex_free(planets_index);
+   planets_index = NULL;
+   planets_indexDirty = 1;
 
    /* Free the systems. */
    for (i=0; i < array_size(systems_stack); i++) {
@@ -3553,6 +3652,37 @@ void space_exit (void)
    }
    array_free(systems_stack);
    systems_stack = NULL;
+   strindex_free(systems_index);
+   systems_index = NULL;
+   systems_indexDirty = 1;
+}
+
+
+/**
+ * @brief Cleans up the system.
+ */
+void space_exit (void)
+{
+   int i, j;
+   AsteroidType *at;
+
+   /* Free standalone graphic textures */
+   gl_freeTexture(jumppoint_gfx);
+   jumppoint_gfx = NULL;
+   gl_freeTexture(jumpbuoy_gfx);
+   jumpbuoy_gfx = NULL;
+
+   /* Free asteroid graphics. */
+   for (i=0; i<(int)nasterogfx; i++)
+      gl_freeTexture(asteroid_gfx[i]);
+   free(asteroid_gfx);
+
+   /* Free the names. */
+   array_free(planetname_stack);
+   array_free(systemname_stack);
+
+   /* Free the planets and systems. */
+   space_freeUniverse();
 
    /* Free the asteroid types. */
    for (i=0; i < array_size(asteroid_types); i++) {
@@ -3592,6 +3722,7 @@ void space_clearKnown (void)
    }
    for (j=0; j<array_size(planet_stack); j++)
       planet_rmFlag(&planet_stack[j],PLANET_KNOWN);
+   map_invalidateDistances();
 }
 
 
@@ -3792,6 +3923,7 @@ int space_sysLoad( xmlNodePtr parent )
       }
    } while (xml_nextNode(node));
 
+   map_invalidateDistances();
    return 0;
 }
 
@@ -334,6 +334,7 @@ extern int space_spawn; /**< 1 if spawning is enabled. */
 void space_init( const char* sysname );
 int space_load (void);
 void space_exit (void);
+void space_freeUniverse (void);
 
 /*
  * planet stuff
@@ -378,6 +379,7 @@ const char *jump_getSymbol( JumpPoint *jp );
 void system_reconstructJumps (StarSystem *sys);
 void systems_reconstructJumps (void);
 void systems_reconstructPlanets (void);
+void space_invalidateIndex (void);
 StarSystem *system_new (void);
 int system_addPlanet( StarSystem *sys, const char *planetname );
 int system_rmPlanet( StarSystem *sys, const char *planetname );
@@ -0,0 +1,699 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file space_cache.c
+ *
+ * @brief Binary snapshot of the parsed universe.
+ *
+ * Parsing the asset and system XML files is the bulk of space_load(), so once
+ * they have been parsed the resulting planets and star systems are written to
+ * the cache directory.  On the next launch they are bulk read from it instead,
+ * as long as the key matches.  The key hashes the version and the path, size
+ * and modification time of every file the universe depends on, so editing or
+ * overriding any of them falls back to parsing the XML (and rewriting the
+ * snapshot).
+ *
+ * The snapshot holds the state right after parsing, before presences are
+ * applied and jumps reconstructed, so space_load() does the rest as usual.
+ * It is native endian and not meant to be portable between machines.
+ */
+
+
+/** @cond */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "physfs.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "space_cache.h"
+
+#include "array.h"
+#include "log.h"
+#include "ndata.h"
+#include "nfile.h"
+#include "nstring.h"
+#include "space.h"
+#include "tech.h"
+
+
+#define UCACHE_FILE        "universe.bin" /**< Name of the snapshot in the cache directory. */
+#define UCACHE_MAGIC       "NAEVUNI" /**< Identifies the snapshot, with the NUL makes 8 bytes. */
+#define UCACHE_VERSION     1 /**< Format version, bump when changing what is stored. */
+#define UCACHE_ENDIAN      0x01020304 /**< Detects snapshots written with another endianness. */
+
+
+/**
+ * @brief Header of the snapshot.
+ */
+typedef struct UniCacheHeader_ {
+   char magic[8]; /**< UCACHE_MAGIC. */
+   uint32_t version; /**< UCACHE_VERSION. */
+   uint32_t endian; /**< UCACHE_ENDIAN. */
+   uint64_t key; /**< Hash of the files the universe was parsed from. */
+   uint64_t checksum; /**< Hash of the payload. */
+   uint64_t size; /**< Size of the payload. */
+} UniCacheHeader;
+
+
+/**
+ * @brief Snapshot being written or read.
+ */
+typedef struct UniCache_ {
+   char *data; /**< Payload, array.h when writing. */
+   size_t size; /**< Size of the payload when reading. */
+   size_t pos; /**< Read position. */
+   int err; /**< Set when reading past the end. */
+} UniCache;
+
+
+static char *ucache_buf = NULL; /**< Validated snapshot waiting for space_cacheLoad(). */
+static size_t ucache_bufsize = 0; /**< Size of ucache_buf. */
+static int ucache_checked = 0; /**< Whether or not the snapshot was already looked at. */
+
+
+/*
+ * Prototypes.
+ */
+static uint64_t ucache_hash( uint64_t h, const void *data, size_t len );
+static uint64_t ucache_key (void);
+static uint64_t ucache_keyFile( uint64_t h, const char *path );
+static void ucache_path( char *path, size_t len );
+/* Writing. */
+static void ucache_write( UniCache *uc, const void *data, size_t len );
+static void ucache_writeInt( UniCache *uc, int i );
+static void ucache_writeDouble( UniCache *uc, double d );
+static void ucache_writeStr( UniCache *uc, const char *str );
+static void ucache_writePlanet( UniCache *uc, const Planet *p );
+static void ucache_writeSystem( UniCache *uc, const StarSystem *sys );
+/* Reading. */
+static void ucache_read( UniCache *uc, void *data, size_t len );
+static int ucache_readInt( UniCache *uc );
+static double ucache_readDouble( UniCache *uc );
+static char* ucache_readStr( UniCache *uc );
+static void ucache_readPlanet( UniCache *uc, Planet *p );
+static void ucache_readSystem( UniCache *uc, StarSystem *sys );
+
+
+/**
+ * @brief Hashes data (64-bit FNV-1a).
+ *
+ *    @param h Hash so far.
+ *    @param data Data to hash.
+ *    @param len Length of the data.
+ *    @return The updated hash.
+ */
+static uint64_t ucache_hash( uint64_t h, const void *data, size_t len )
+{
+   size_t i;
+   const unsigned char *s;
+
+   s = (const unsigned char*) data;
+   for (i=0; i<len; i++) {
+      h ^= s[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Adds the identity of a data file to the key.
+ *
+ *    @param h Key so far.
+ *    @param path Path of the file.
+ *    @return The updated key.
+ */
+static uint64_t ucache_keyFile( uint64_t h, const char *path )
+{
+   PHYSFS_Stat stat;
+   const char *dir;
+
+   h = ucache_hash( h, path, strlen(path)+1 );
+   dir = PHYSFS_getRealDir( path );
+   if (dir != NULL)
+      h = ucache_hash( h, dir, strlen(dir)+1 );
+   if (PHYSFS_stat( path, &stat )) {
+      h = ucache_hash( h, &stat.filesize, sizeof(stat.filesize) );
+      h = ucache_hash( h, &stat.modtime, sizeof(stat.modtime) );
+   }
+   return h;
+}
+
+
+/**
+ * @brief Computes the key of the current data files.
+ *
+ * Files are taken in the order space_load() parses them in, so that the
+ * planet and system IDs stored in the snapshot match.
+ *
+ *    @return Key identifying the universe data.
+ */
+static uint64_t ucache_key (void)
+{
+   int i, j;
+   uint64_t h;
+   char **files, path[PATH_MAX];
+   const char *dirs[] = { PLANET_DATA_PATH, SYSTEM_DATA_PATH };
+   const char *deps[] = { COMMODITY_DATA_PATH, FACTION_DATA_PATH,
+      TECH_DATA_PATH, ASTERO_DATA_PATH };
+   uint32_t v;
+
+   h = 14695981039346656037ULL;
+   v = UCACHE_VERSION;
+   h = ucache_hash( h, &v, sizeof(v) );
+   h = ucache_hash( h, naev_version(1), strlen(naev_version(1)) );
+   for (i=0; i<(int)(sizeof(deps)/sizeof(deps[0])); i++)
+      h = ucache_keyFile( h, deps[i] );
+   for (i=0; i<(int)(sizeof(dirs)/sizeof(dirs[0])); i++) {
+      files = PHYSFS_enumerateFiles( dirs[i] );
+      for (j=0; files[j]!=NULL; j++) {
+         nsnprintf( path, sizeof(path), "%s%s", dirs[i], files[j] );
+         h = ucache_keyFile( h, path );
+      }
+      PHYSFS_freeList( files );
+   }
+   return h;
+}
+
+
+/**
+ * @brief Gets the path of the snapshot.
+ */
+static void ucache_path( char *path, size_t len )
+{
+   nsnprintf( path, len, "%s%s", nfile_cachePath(), UCACHE_FILE );
+}
+
+
+/**
+ * @brief Appends data to the snapshot.
+ */
+static void ucache_write( UniCache *uc, const void *data, size_t len )
+{
+   size_t n;
+
+   n = array_size( uc->data );
+   array_resize( &uc->data, n+len );
+   memcpy( &uc->data[n], data, len );
+}
+
+
+/**
+ * @brief Appends an integer to the snapshot.
+ */
+static void ucache_writeInt( UniCache *uc, int i )
+{
+   int32_t v = i;
+   ucache_write( uc, &v, sizeof(v) );
+}
+
+
+/**
+ * @brief Appends a double to the snapshot.
+ */
+static void ucache_writeDouble( UniCache *uc, double d )
+{
+   ucache_write( uc, &d, sizeof(d) );
+}
+
+
+/**
+ * @brief Appends a string, which may be NULL, to the snapshot.
+ */
+static void ucache_writeStr( UniCache *uc, const char *str )
+{
+   int len;
+
+   len = (str == NULL) ? -1 : (int)strlen(str);
+   ucache_writeInt( uc, len );
+   if (len > 0)
+      ucache_write( uc, str, len );
+}
+
+
+/**
+ * @brief Reads data from the snapshot.
+ */
+static void ucache_read( UniCache *uc, void *data, size_t len )
+{
+   if (uc->err || (uc->pos+len > uc->size)) {
+      uc->err = 1;
+      memset( data, 0, len );
+      return;
+   }
+   memcpy( data, &uc->data[uc->pos], len );
+   uc->pos += len;
+}
+
+
+/**
+ * @brief Reads an integer from the snapshot.
+ */
+static int ucache_readInt( UniCache *uc )
+{
+   int32_t v;
+   ucache_read( uc, &v, sizeof(v) );
+   return v;
+}
+
+
+/**
+ * @brief Reads a double from the snapshot.
+ */
+static double ucache_readDouble( UniCache *uc )
+{
+   double d;
+   ucache_read( uc, &d, sizeof(d) );
+   return d;
+}
+
+
+/**
+ * @brief Reads a string from the snapshot.
+ *
+ *    @return Newly allocated string, or NULL.
+ */
+static char* ucache_readStr( UniCache *uc )
+{
+   int len;
+   char *str;
+
+   len = ucache_readInt( uc );
+   if ((len < 0) || uc->err)
+      return NULL;
+   if (uc->pos+len > uc->size) {
+      uc->err = 1;
+      return NULL;
+   }
+   str = malloc( len+1 );
+   memcpy( str, &uc->data[uc->pos], len );
+   str[len] = '\0';
+   uc->pos += len;
+   return str;
+}
+
+
+/**
+ * @brief Writes a parsed planet.
+ */
+static void ucache_writePlanet( UniCache *uc, const Planet *p )
+{
+   int i, n;
+   char **names;
+
+   ucache_writeStr( uc, p->name );
+   ucache_writeDouble( uc, p->pos.x );
+   ucache_writeDouble( uc, p->pos.y );
+   ucache_writeDouble( uc, p->radius );
+   ucache_writeStr( uc, p->class );
+   ucache_writeStr( uc, (p->faction >= 0) ? faction_name(p->faction) : NULL );
+   ucache_write( uc, &p->population, sizeof(p->population) );
+   ucache_writeDouble( uc, p->presenceAmount );
+   ucache_writeDouble( uc, p->hide );
+   ucache_writeInt( uc, p->presenceRange );
+   ucache_writeInt( uc, p->real );
+   ucache_writeStr( uc, p->land_func );
+   ucache_writeStr( uc, p->description );
+   ucache_writeStr( uc, p->bar_description );
+   ucache_writeInt( uc, p->services );
+   ucache_writeInt( uc, p->flags );
+   ucache_writeStr( uc, p->gfx_spaceName );
+   ucache_writeStr( uc, p->gfx_spacePath );
+   ucache_writeStr( uc, p->gfx_exterior );
+   ucache_writeStr( uc, p->gfx_exteriorPath );
+
+   /* Commodities, -1 if there is no list. */
+   ucache_writeInt( uc, (p->commodities == NULL) ? -1 : array_size(p->commodities) );
+   for (i=0; i<array_size(p->commodities); i++) {
+      ucache_writeStr( uc, p->commodities[i]->name );
+      ucache_writeDouble( uc, p->commodityPrice[i].price );
+   }
+
+   /* Tech, -1 if there is no group. */
+   if (p->tech == NULL)
+      ucache_writeInt( uc, -1 );
+   else {
+      names = tech_getItemNames( p->tech, &n );
+      ucache_writeInt( uc, n );
+      for (i=0; i<n; i++) {
+         ucache_writeStr( uc, names[i] );
+         free( names[i] );
+      }
+      free( names );
+   }
+}
+
+
+/**
+ * @brief Reads a planet written by ucache_writePlanet.
+ */
+static void ucache_readPlanet( UniCache *uc, Planet *p )
+{
+   int i, n;
+   char *str;
+   Commodity *com;
+
+   p->name           = ucache_readStr( uc );
+   p->pos.x          = ucache_readDouble( uc );
+   p->pos.y          = ucache_readDouble( uc );
+   p->radius         = ucache_readDouble( uc );
+   p->class          = ucache_readStr( uc );
+   str               = ucache_readStr( uc );
+   if (str != NULL) {
+      p->faction     = faction_get( str );
+      free( str );
+   }
+   ucache_read( uc, &p->population, sizeof(p->population) );
+   p->presenceAmount = ucache_readDouble( uc );
+   p->hide           = ucache_readDouble( uc );
+   p->presenceRange  = ucache_readInt( uc );
+   p->real           = ucache_readInt( uc );
+   p->land_func      = ucache_readStr( uc );
+   p->description    = ucache_readStr( uc );
+   p->bar_description= ucache_readStr( uc );
+   p->services       = ucache_readInt( uc );
+   p->flags          = ucache_readInt( uc );
+   p->gfx_spaceName  = ucache_readStr( uc );
+   p->gfx_spacePath  = ucache_readStr( uc );
+   p->gfx_exterior   = ucache_readStr( uc );
+   p->gfx_exteriorPath = ucache_readStr( uc );
+
+   /* Commodities. */
+   n = ucache_readInt( uc );
+   if (n >= 0) {
+      p->commodities    = array_create_size( Commodity*, MAX(n,1) );
+      p->commodityPrice = array_create_size( CommodityPrice, MAX(n,1) );
+   }
+   for (i=0; i<n; i++) {
+      str = ucache_readStr( uc );
+      com = (str != NULL) ? commodity_get( str ) : NULL;
+      free( str );
+      if (com == NULL) {
+         uc->err = 1;
+         return;
+      }
+      array_push_back( &p->commodities, com );
+      memset( &array_grow( &p->commodityPrice ), 0, sizeof(CommodityPrice) );
+      p->commodityPrice[i].price = ucache_readDouble( uc );
+   }
+
+   /* Tech. */
+   n = ucache_readInt( uc );
+   if (n >= 0)
+      p->tech = tech_groupCreate();
+   for (i=0; i<n; i++) {
+      str = ucache_readStr( uc );
+      if (str != NULL)
+         tech_addItemTech( p->tech, str );
+      free( str );
+   }
+}
+
+
+/**
+ * @brief Writes a parsed star system.
+ */
+static void ucache_writeSystem( UniCache *uc, const StarSystem *sys )
+{
+   int i, j;
+   const JumpPoint *jp;
+   const AsteroidAnchor *a;
+
+   ucache_writeStr( uc, sys->name );
+   ucache_writeDouble( uc, sys->pos.x );
+   ucache_writeDouble( uc, sys->pos.y );
+   ucache_writeInt( uc, sys->stars );
+   ucache_writeDouble( uc, sys->interference );
+   ucache_writeDouble( uc, sys->nebu_density );
+   ucache_writeDouble( uc, sys->nebu_volatility );
+   ucache_writeDouble( uc, sys->radius );
+   ucache_writeStr( uc, sys->background );
+
+   /* Assets. */
+   ucache_writeInt( uc, array_size(sys->planetsid) );
+   for (i=0; i<array_size(sys->planetsid); i++)
+      ucache_writeInt( uc, sys->planetsid[i] );
+
+   /* Jumps, the target is the ID of the system. */
+   ucache_writeInt( uc, array_size(sys->jumps) );
+   for (i=0; i<array_size(sys->jumps); i++) {
+      jp = &sys->jumps[i];
+      ucache_writeInt( uc, jp->targetid );
+      ucache_writeDouble( uc, jp->pos.x );
+      ucache_writeDouble( uc, jp->pos.y );
+      ucache_writeDouble( uc, jp->radius );
+      ucache_writeInt( uc, jp->flags );
+      ucache_writeDouble( uc, jp->hide );
+   }
+
+   /* Asteroid fields, types are indices of the asteroid types. */
+   ucache_writeInt( uc, array_size(sys->asteroids) );
+   for (i=0; i<array_size(sys->asteroids); i++) {
+      a = &sys->asteroids[i];
+      ucache_writeDouble( uc, a->pos.x );
+      ucache_writeDouble( uc, a->pos.y );
+      ucache_writeDouble( uc, a->density );
+      ucache_writeDouble( uc, a->radius );
+      ucache_writeInt( uc, a->ntype );
+      for (j=0; j<a->ntype; j++)
+         ucache_writeInt( uc, a->type[j] );
+   }
+   ucache_writeInt( uc, array_size(sys->astexclude) );
+   for (i=0; i<array_size(sys->astexclude); i++) {
+      ucache_writeDouble( uc, sys->astexclude[i].pos.x );
+      ucache_writeDouble( uc, sys->astexclude[i].pos.y );
+      ucache_writeDouble( uc, sys->astexclude[i].radius );
+   }
+}
+
+
+/**
+ * @brief Reads a star system written by ucache_writeSystem.
+ *
+ * The system is set up like system_parse, system_parseAsteroids and
+ * system_parseJumps would.
+ */
+static void ucache_readSystem( UniCache *uc, StarSystem *sys )
+{
+   int i, j, n, id, nplanets;
+   JumpPoint *jp;
+   AsteroidAnchor *a;
+   AsteroidExclusion *e;
+
+   sys->presence        = array_create( SystemPresence );
+   sys->name            = ucache_readStr( uc );
+   sys->pos.x           = ucache_readDouble( uc );
+   sys->pos.y           = ucache_readDouble( uc );
+   sys->stars           = ucache_readInt( uc );
+   sys->interference    = ucache_readDouble( uc );
+   sys->nebu_density    = ucache_readDouble( uc );
+   sys->nebu_volatility = ucache_readDouble( uc );
+   sys->radius          = ucache_readDouble( uc );
+   sys->background      = ucache_readStr( uc );
+
+   /* Assets. */
+   nplanets = array_size( planet_getAll() );
+   n = ucache_readInt( uc );
+   for (i=0; i<n; i++) {
+      id = ucache_readInt( uc );
+      if ((id < 0) || (id >= nplanets)) {
+         uc->err = 1;
+         return;
+      }
+      system_addPlanet( sys, planet_getIndex(id)->name );
+   }
+   array_shrink( &sys->planets );
+   array_shrink( &sys->planetsid );
+
+   /* Jumps, pointers get set by systems_reconstructJumps. */
+   n = ucache_readInt( uc );
+   for (i=0; i<n; i++) {
+      jp = &array_grow( &sys->jumps );
+      memset( jp, 0, sizeof(JumpPoint) );
+      jp->targetid   = ucache_readInt( uc );
+      jp->pos.x      = ucache_readDouble( uc );
+      jp->pos.y      = ucache_readDouble( uc );
+      jp->radius     = ucache_readDouble( uc );
+      jp->flags      = ucache_readInt( uc );
+      jp->hide       = ucache_readDouble( uc );
+   }
+   array_shrink( &sys->jumps );
+
+   /* Asteroid fields. */
+   n = ucache_readInt( uc );
+   for (i=0; i<n; i++) {
+      a = &array_grow( &sys->asteroids );
+      memset( a, 0, sizeof(AsteroidAnchor) );
+      a->pos.x    = ucache_readDouble( uc );
+      a->pos.y    = ucache_readDouble( uc );
+      a->density  = ucache_readDouble( uc );
+      a->radius   = ucache_readDouble( uc );
+      a->ntype    = ucache_readInt( uc );
+      if ((a->ntype <= 0) || uc->err) {
+         a->ntype = 0;
+         uc->err  = 1;
+         return;
+      }
+      a->type     = malloc( a->ntype * sizeof(int) );
+      for (j=0; j<a->ntype; j++)
+         a->type[j] = ucache_readInt( uc );
+
+      /* Same as system_parseAsteroidField. */
+      a->area     = M_PI * a->radius * a->radius;
+      a->nb       = floor( ABS(a->area) / 500000 * a->density );
+      a->ndebris  = floor(100*a->density);
+   }
+   array_shrink( &sys->asteroids );
+   n = ucache_readInt( uc );
+   for (i=0; i<n; i++) {
+      e = &array_grow( &sys->astexclude );
+      e->pos.x    = ucache_readDouble( uc );
+      e->pos.y    = ucache_readDouble( uc );
+      e->radius   = ucache_readDouble( uc );
+   }
+   array_shrink( &sys->astexclude );
+}
+
+
+/**
+ * @brief Checks to see if the snapshot matches the current data files.
+ *
+ * Keeps the snapshot around for space_cacheLoad() so it's only read once.
+ *
+ *    @return 1 if the universe can be loaded from the snapshot.
+ */
+int space_cacheFresh (void)
+{
+   char path[PATH_MAX];
+   char *buf;
+   size_t bufsize;
+   UniCacheHeader hdr;
+
+   if (ucache_checked)
+      return (ucache_buf != NULL);
+   ucache_checked = 1;
+
+   ucache_path( path, sizeof(path) );
+   if (!nfile_fileExists( path ))
+      return 0;
+   buf = nfile_readFile( &bufsize, path );
+   if (buf == NULL)
+      return 0;
+
+   /* Validate. */
+   if (bufsize < sizeof(UniCacheHeader)) {
+      free( buf );
+      return 0;
+   }
+   memcpy( &hdr, buf, sizeof(UniCacheHeader) );
+   if ((memcmp( hdr.magic, UCACHE_MAGIC, sizeof(hdr.magic) ) != 0) ||
+         (hdr.version != UCACHE_VERSION) || (hdr.endian != UCACHE_ENDIAN) ||
+         (hdr.size != bufsize - sizeof(UniCacheHeader)) ||
+         (hdr.key != ucache_key()) ||
+         (hdr.checksum != ucache_hash( 14695981039346656037ULL,
+               &buf[sizeof(UniCacheHeader)], hdr.size ))) {
+      DEBUG(_("Universe cache is stale"));
+      free( buf );
+      return 0;
+   }
+
+   ucache_buf     = buf;
+   ucache_bufsize = bufsize;
+   return 1;
+}
+
+
+/**
+ * @brief Loads the planets and star systems from the snapshot.
+ *
+ * Must be called at the same point space_load() would parse the XML files.
+ * If the snapshot turns out to be corrupt, everything read from it is freed
+ * again.
+ *
+ *    @return 0 if the universe was loaded, nonzero if it has to be parsed.
+ */
+int space_cacheLoad (void)
+{
+   int i, n;
+   UniCache uc;
+
+   if (!space_cacheFresh())
+      return -1;
+
+   memset( &uc, 0, sizeof(UniCache) );
+   uc.data  = &ucache_buf[ sizeof(UniCacheHeader) ];
+   uc.size  = ucache_bufsize - sizeof(UniCacheHeader);
+
+   n = ucache_readInt( &uc );
+   for (i=0; (i<n) && !uc.err; i++)
+      ucache_readPlanet( &uc, planet_new() );
+   n = ucache_readInt( &uc );
+   for (i=0; (i<n) && !uc.err; i++)
+      ucache_readSystem( &uc, system_new() );
+   space_invalidateIndex();
+
+   free( ucache_buf );
+   ucache_buf     = NULL;
+   ucache_bufsize = 0;
+
+   /* Should not happen as the checksum matched, throw away what was read so
+    * the XML gets parsed (and the snapshot rewritten) instead. */
+   if (uc.err || (uc.pos != uc.size)) {
+      WARN(_("Universe cache '%s' is corrupt, parsing the universe instead."), UCACHE_FILE);
+      space_freeUniverse();
+      return -1;
+   }
+
+   DEBUG( n_( "Loaded %d Star System from cache", "Loaded %d Star Systems from cache", array_size(system_getAll()) ), array_size(system_getAll()) );
+   DEBUG( n_( "       with %d Planet", "       with %d Planets", array_size(planet_getAll()) ), array_size(planet_getAll()) );
+   return 0;
+}
+
+
+/**
+ * @brief Writes the snapshot of the freshly parsed planets and star systems.
+ */
+void space_cacheSave (void)
+{
+   int i;
+   char path[PATH_MAX];
+   UniCache uc;
+   UniCacheHeader hdr;
+   Planet *planets;
+   StarSystem *systems;
+
+   memset( &uc, 0, sizeof(UniCache) );
+   uc.data = array_create( char );
+   array_resize( &uc.data, sizeof(UniCacheHeader) );
+
+   planets = planet_getAll();
+   ucache_writeInt( &uc, array_size(planets) );
+   for (i=0; i<array_size(planets); i++)
+      ucache_writePlanet( &uc, &planets[i] );
+   systems = system_getAll();
+   ucache_writeInt( &uc, array_size(systems) );
+   for (i=0; i<array_size(systems); i++)
+      ucache_writeSystem( &uc, &systems[i] );
+
+   /* Fill in the header now that the payload is known. */
+   memset( &hdr, 0, sizeof(UniCacheHeader) );
+   memcpy( hdr.magic, UCACHE_MAGIC, sizeof(hdr.magic) );
+   hdr.version    = UCACHE_VERSION;
+   hdr.endian     = UCACHE_ENDIAN;
+   hdr.key        = ucache_key();
+   hdr.size       = array_size(uc.data) - sizeof(UniCacheHeader);
+   hdr.checksum   = ucache_hash( 14695981039346656037ULL,
+         &uc.data[sizeof(UniCacheHeader)], hdr.size );
+   memcpy( uc.data, &hdr, sizeof(UniCacheHeader) );
+
+   nfile_dirMakeExist( nfile_cachePath() );
+   ucache_path( path, sizeof(path) );
+   if (nfile_writeFile( uc.data, array_size(uc.data), path ) != 0)
+      WARN(_("Failed to write universe cache '%s'."), path);
+   array_free( uc.data );
+}
@@ -0,0 +1,15 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef SPACE_CACHE_H
+#  define SPACE_CACHE_H
+
+
+int space_cacheFresh (void);
+int space_cacheLoad (void);
+void space_cacheSave (void);
+
+
+#endif /* SPACE_CACHE_H */
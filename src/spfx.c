@@ -31,6 +31,7 @@
 #include "physics.h"
 #include "rng.h"
 #include "space.h"
+#include "strindex.h"
 
 
 #define SPFX_XML_ID     "spfxs" /**< XML Document tag. */
@@ -45,8 +46,11 @@
 
 /* Trail stuff. */
 #define TRAIL_UPDATE_DT       0.05
+#define TRAIL_VERTEX          10 /**< Floats per trail vertex: x, y, r, g, b, a, birth, side, length, thickness. */
 static TrailSpec* trail_spec_stack;
 static Trail_spfx** trail_spfx_stack;
+static GLfloat *trail_vertex = NULL; /**< Vertex data of the trails being drawn (array.h). */
+static gl_vbo *trail_vbo = NULL; /**< Streaming VBO for the trails. */
 
 
 /*
@@ -93,6 +97,7 @@ typedef struct SPFX_Base_ {
 } SPFX_Base;
 
 static SPFX_Base *spfx_effects = NULL; /**< Total special effects. */
+static StrIndex *spfx_index = NULL; /**< Name index of the special effects. */
 
 
 /**
@@ -130,7 +135,8 @@ static void spfx_hapticRumble( double mod );
 /* Trail. */
 static void spfx_update_trails( double dt );
 static void spfx_trail_update( Trail_spfx* trail, double dt );
-static void spfx_trail_draw( const Trail_spfx* trail );
+static void spfx_trail_mesh( const Trail_spfx* trail );
+static void spfx_render_trails (void);
 static void spfx_trail_clear( Trail_spfx* trail );
 static void spfx_trail_free( Trail_spfx* trail );
 
@@ -204,11 +210,7 @@ static void spfx_base_free( SPFX_Base *effect )
  */
 int spfx_get( char* name )
 {
-   int i;
-   for (i=0; i<array_size(spfx_effects); i++)
-      if (strcmp(spfx_effects[i].name, name)==0)
-         return i;
-   return -1;
+   return strindex_get( spfx_index, name );
 }
 
 
@@ -221,6 +223,7 @@ int spfx_get( char* name )
  */
 int spfx_load (void)
 {
+   int i;
    xmlNodePtr node;
    xmlDocPtr doc;
 
@@ -255,6 +258,9 @@ int spfx_load (void)
    } while (xml_nextNode(node));
    /* Shrink back to minimum - shouldn't change ever. */
    array_shrink(&spfx_effects);
+   spfx_index = strindex_create( array_size(spfx_effects) );
+   for (i=0; i<array_size(spfx_effects); i++)
+      strindex_add( spfx_index, spfx_effects[i].name, i );
 
    /* Clean up. */
    xmlFreeDoc(doc);
@@ -273,6 +279,10 @@ int spfx_load (void)
    spfx_stack_middle = array_create( SPFX );
    spfx_stack_back = array_create( SPFX );
 
+   /* Trail meshes. */
+   trail_vertex = array_create( GLfloat );
+   trail_vbo = gl_vboCreateStream( 0, NULL );
+
    return 0;
 }
 
@@ -301,6 +311,8 @@ void spfx_free (void)
       spfx_base_free( &spfx_effects[i] );
    array_free(spfx_effects);
    spfx_effects = NULL;
+   strindex_free(spfx_index);
+   spfx_index = NULL;
 
    /* Free the noise. */
    noise_delete( shake_noise );
@@ -309,6 +321,10 @@ void spfx_free (void)
    for (i=0; i<array_size(trail_spfx_stack); i++)
       spfx_trail_free( trail_spfx_stack[i] );
    array_free( trail_spfx_stack );
+   array_free( trail_vertex );
+   trail_vertex = NULL;
+   gl_vboDestroy( trail_vbo );
+   trail_vbo = NULL;
 
    /* Free the trail styles. */
    for (i=0; i<array_size(trail_spec_stack); i++)
@@ -340,6 +356,10 @@ void spfx_add( int effect,
       return;
    }
 
+   /* Nobody is watching while the system is being simulated. */
+   if (space_isSimulation())
+      return;
+
    /*
     * Select the Layer
     */
@@ -538,19 +558,14 @@ void spfx_update_trails( double dt ) {
  */
 static void spfx_trail_update( Trail_spfx* trail, double dt )
 {
-   size_t i;
-
-   /* Update all elements. */
-   for (i = trail->iread; i < trail->iwrite; i++)
-      trail_at( trail, i ).t -= dt/ trail->ttl;
+   /* Update timer, the control points are aged by the shader. */
+   trail->dt += dt;
 
    /* Remove first elements if they're outdated. */
-   while (trail->iread < trail->iwrite && trail_front(trail).t < 0.) {
+   while (trail->iread < trail->iwrite &&
+         trail->dt - trail_front(trail).birth > trail->ttl) {
       trail->iread++;
    }
-
-   /* Update timer. */
-   trail->dt += dt;
 }
 
 
@@ -571,14 +586,14 @@ void spfx_trail_sample( Trail_spfx* trail, Vector2d pos, TrailStyle style )
    p.x = pos.x;
    p.y = pos.y;
    p.c = style.col;
-   p.t = 1.;
+   p.birth = trail->dt;
    p.thickness = style.thick;
 
    /* The "back" of the trail should always reflect our most recent state.  */
    trail_back( trail ) = p;
 
    /* We may need to insert a control point, but not if our last sample was recent enough. */
-   if (trail_size(trail) > 1 && trail_at( trail, trail->iwrite-2 ).t >= 1.-TRAIL_UPDATE_DT)
+   if (trail_size(trail) > 1 && trail->dt - trail_at( trail, trail->iwrite-2 ).birth <= TRAIL_UPDATE_DT*trail->ttl)
       return;
 
    /* If the last time we inserted a control point was recent enough, we don't need a new one. */
@@ -630,65 +645,146 @@ static void spfx_trail_free( Trail_spfx* trail )
 
 
 /**
- * @brief Draws a trail on screen.
+ * @brief Appends the triangle strip of a trail to the trail vertex data.
+ *
+ * Every control point becomes a pair of vertices across the trail, offset
+ * along the normal of the direction of the trail at that point.
+ *
+ *    @param trail Trail to mesh.
  */
-static void spfx_trail_draw( const Trail_spfx* trail )
+static void spfx_trail_mesh( const Trail_spfx* trail )
 {
-   double x1, y1, x2, y2, z;
-   TrailPoint *tp, *tpp;
+   double x, y, px, py, nx, ny, dx, dy, l, hw, len, z;
+   const TrailPoint *tp;
    size_t i, n;
-   GLfloat len;
-   gl_Matrix4 projection;
-   double a, s;
+   GLfloat *v;
+   int j;
 
    n = trail_size(trail);
-   if (n==0)
+   if (n < 2)
       return;
 
-   /* Stuff that doesn't change for the entire trail. */
-   glUseProgram( shaders.trail.program );
-   glEnableVertexAttribArray( shaders.trail.vertex );
-   gl_vboActivateAttribOffset( gl_squareVBO, shaders.trail.vertex, 0, 2, GL_FLOAT, 0 );
-   glUniform1f( shaders.trail.dt, trail->dt );
-   glUniform1f( shaders.trail.r, trail->r );
+   j = array_size( trail_vertex );
+   array_resize( &trail_vertex, j + 2*n*TRAIL_VERTEX );
+   v = &trail_vertex[j];
 
    z   = cam_getZoom();
    len = 0.;
-   for (i = trail->iread + 1; i < trail->iwrite; i++) {
-      tp  = &trail_at( trail, i );
-      tpp = &trail_at( trail, i-1 );
-      gl_gameToScreenCoords( &x1, &y1,  tp->x,  tp->y );
-      gl_gameToScreenCoords( &x2, &y2, tpp->x, tpp->y );
-
-      a = atan2( y2-y1, x2-x1 );
-      s = hypotf( x2-x1, y2-y1 );
-
-      /* Set vertex. */
-      projection = gl_Matrix4_Translate(gl_view_matrix, x1, y1, 0);
-      projection = gl_Matrix4_Rotate2d(projection, a);
-      projection = gl_Matrix4_Scale(projection, s, z*(tp->thickness+tpp->thickness), 1);
-      projection = gl_Matrix4_Translate(projection, 0., -.5, 0);
-
-      /* Set uniforms. */
-      gl_Matrix4_Uniform(shaders.trail.projection, projection);
-      gl_uniformColor(shaders.trail.c1, &tp->c);
-      gl_uniformColor(shaders.trail.c2, &tpp->c);
-      glUniform1f(shaders.trail.t1, tp->t);
-      glUniform1f(shaders.trail.t2, tpp->t);
-      glUniform2f(shaders.trail.pos2, len, tp->thickness );
-      len += s;
-      glUniform2f(shaders.trail.pos1, len, tpp->thickness );
+   gl_gameToScreenCoords( &x, &y, trail_front(trail).x, trail_front(trail).y );
+   px  = x;
+   py  = y;
+   for (i = trail->iread; i < trail->iwrite; i++) {
+      tp = &trail_at( trail, i );
+
+      /* Look ahead for the direction, the ends just use their segment. */
+      if (i+1 < trail->iwrite)
+         gl_gameToScreenCoords( &dx, &dy, trail_at( trail, i+1 ).x, trail_at( trail, i+1 ).y );
+      else {
+         dx = x;
+         dy = y;
+      }
+      l  = hypot( dx-px, dy-py );
+      if (l > 0.) {
+         nx = (dy-py) / l;
+         ny = (px-dx) / l;
+      }
+      else {
+         nx = 0.;
+         ny = 1.;
+      }
+      hw = z*tp->thickness;
+
+      for (j=0; j<2; j++) {
+         v[0] = x + (2*j-1)*hw*nx;
+         v[1] = y + (2*j-1)*hw*ny;
+         v[2] = tp->c.r;
+         v[3] = tp->c.g;
+         v[4] = tp->c.b;
+         v[5] = tp->c.a;
+         v[6] = tp->birth;
+         v[7] = j;
+         v[8] = len;
+         v[9] = tp->thickness;
+         v += TRAIL_VERTEX;
+      }
+
+      /* Move on to the next control point. */
+      len += hypot( dx-x, dy-y );
+      px = x;
+      py = y;
+      x  = dx;
+      y  = dy;
+   }
+}
+
+
+/**
+ * @brief Draws all the trails on screen.
+ *
+ * The meshes of all the trails are uploaded together, and each trail is drawn
+ * as a single triangle strip. The control points are aged by the shader.
+ */
+static void spfx_render_trails (void)
+{
+   int i;
+   size_t n;
+   GLint first;
+   GLsizei stride;
+   const Trail_spfx *trail;
+
+   /* Build the meshes. */
+   array_resize( &trail_vertex, 0 );
+   for (i=0; i<array_size(trail_spfx_stack); i++) {
+      trail = trail_spfx_stack[i];
+      if (trail->nebula && (cur_system->nebu_density<=0.))
+         continue;
+      spfx_trail_mesh( trail );
+   }
+   if (array_size(trail_vertex) == 0)
+      return;
+   gl_vboData( trail_vbo, sizeof(GLfloat)*array_size(trail_vertex), trail_vertex );
+
+   /* Stuff that doesn't change for any trail. */
+   glUseProgram( shaders.trail.program );
+   stride = sizeof(GLfloat)*TRAIL_VERTEX;
+   glEnableVertexAttribArray( shaders.trail.vertex );
+   glEnableVertexAttribArray( shaders.trail.vertex_color );
+   glEnableVertexAttribArray( shaders.trail.vertex_data );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_color,
+         sizeof(GLfloat)*2, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_data,
+         sizeof(GLfloat)*6, 4, GL_FLOAT, stride );
+   gl_Matrix4_Uniform( shaders.trail.projection, gl_view_matrix );
+
+   /* One draw per trail, in the same order they were meshed. */
+   first = 0;
+   for (i=0; i<array_size(trail_spfx_stack); i++) {
+      trail = trail_spfx_stack[i];
+      if (trail->nebula && (cur_system->nebu_density<=0.))
+         continue;
+      n = trail_size(trail);
+      if (n < 2)
+         continue;
+
+      glUniform1f( shaders.trail.dt, trail->dt );
+      glUniform1f( shaders.trail.ttl, trail->ttl );
+      glUniform1f( shaders.trail.r, trail->r );
 
       /* Set the subroutine. */
       if (GLAD_GL_ARB_shader_subroutine)
          glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &trail->type );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      glDrawArrays( GL_TRIANGLE_STRIP, first, 2*n );
+      first += 2*n;
    }
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.trail.vertex );
+   glDisableVertexAttribArray( shaders.trail.vertex_color );
+   glDisableVertexAttribArray( shaders.trail.vertex_data );
    glUseProgram(0);
 
    /* Check errors. */
@@ -891,7 +987,6 @@ void spfx_render( const int layer )
    SPFX_Base *effect;
    int sx, sy;
    double time;
-   Trail_spfx *trail;
 
    /* get the appropriate layer */
    switch (layer) {
@@ -914,14 +1009,10 @@ void spfx_render( const int layer )
 
    /* Trails are special (for now?). */
    if (layer == SPFX_LAYER_BACK)
-      for (i=0; i<array_size(trail_spfx_stack); i++) {
-         trail = trail_spfx_stack[i];
-         if (trail->nebula && (cur_system->nebu_density<=0.))
-            continue;
-         spfx_trail_draw( trail );
-      }
+      spfx_render_trails();
 
    /* Now render the layer */
+   gl_batchBegin();
    for (i=array_size(spfx_stack)-1; i>=0; i--) {
       effect = &spfx_effects[ spfx_stack[i].effect ];
 
@@ -941,6 +1032,7 @@ void spfx_render( const int layer )
             spfx_stack[i].lastframe / sx,
             NULL );
    }
+   gl_batchEnd();
 }
 
 
@@ -49,7 +49,7 @@ typedef struct TrailSpec_ {
 typedef struct TrailPoint {
    GLfloat x, y;     /**< Control points for the trail. */
    glColour c;       /**< Colour associated with the trail's control points. */
-   GLfloat t;        /**< Timer, normalized to the time to live of the trail (starts at 1, ends at 0). */
+   GLfloat birth;    /**< Time the control point was created at, in terms of the trail's dt. */
    GLfloat thickness;/**< Thickness of the trail. */
 } TrailPoint;
 
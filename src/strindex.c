@@ -0,0 +1,271 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+/**
+ * @file strindex.c
+ *
+ * @brief Open addressing hash index from names to stack positions.
+ *
+ * Used to speed up the by-name lookups of the data stacks (outfits, ships,
+ * systems, etc.).  Keys are not copied, they must be the names stored in the
+ * stack itself, so they have to be removed (or the index cleared and rebuilt)
+ * whenever those are freed or changed.  When the same key is added twice, the first index is
+ * kept, which matches what a linear scan of the stack would find.
+ */
+
+
+/** @cond */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "strindex.h"
+
+#include "log.h"
+
+
+#define STRINDEX_MIN       16 /**< Minimum amount of slots. */
+
+
+/**
+ * @brief A slot of the index.
+ */
+typedef struct StrIndexSlot_ {
+   const char *key; /**< Name, NULL if the slot is empty. */
+   uint32_t hash; /**< Hash of the name. */
+   int idx; /**< Position in the stack. */
+} StrIndexSlot;
+
+
+/**
+ * @brief Hash index mapping names to positions in a stack.
+ */
+struct StrIndex_ {
+   StrIndexSlot *slots; /**< Slots, amount is a power of two. */
+   int nslots; /**< Amount of slots. */
+   int n; /**< Amount of used slots. */
+};
+
+
+/*
+ * Prototypes.
+ */
+static uint32_t strindex_hash( const char *key );
+static void strindex_grow( StrIndex *si );
+static void strindex_insert( StrIndex *si, const char *key, uint32_t h, int idx );
+
+
+/**
+ * @brief Hashes a name (FNV-1a).
+ *
+ *    @param key Name to hash.
+ *    @return Hash of the name.
+ */
+static uint32_t strindex_hash( const char *key )
+{
+   uint32_t h;
+   const unsigned char *s;
+
+   h = 2166136261u;
+   for (s=(const unsigned char*)key; *s != '\0'; s++) {
+      h ^= *s;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Creates a new index.
+ *
+ *    @param n Amount of names expected, to avoid growing.
+ *    @return The new index.
+ */
+StrIndex* strindex_create( int n )
+{
+   StrIndex *si;
+
+   si          = calloc( 1, sizeof(StrIndex) );
+   si->nslots  = STRINDEX_MIN;
+   while (si->nslots < 2*n)
+      si->nslots *= 2;
+   si->slots   = calloc( si->nslots, sizeof(StrIndexSlot) );
+   return si;
+}
+
+
+/**
+ * @brief Frees an index.
+ *
+ *    @param si Index to free.
+ */
+void strindex_free( StrIndex *si )
+{
+   if (si == NULL)
+      return;
+   free( si->slots );
+   free( si );
+}
+
+
+/**
+ * @brief Removes all the names from an index.
+ *
+ *    @param si Index to clear.
+ */
+void strindex_clear( StrIndex *si )
+{
+   memset( si->slots, 0, si->nslots * sizeof(StrIndexSlot) );
+   si->n = 0;
+}
+
+
+/**
+ * @brief Inserts a name known not to be in the index.
+ *
+ *    @param si Index to insert into.
+ *    @param key Name to insert.
+ *    @param h Hash of the name.
+ *    @param idx Position of the name in the stack.
+ */
+static void strindex_insert( StrIndex *si, const char *key, uint32_t h, int idx )
+{
+   int i, mask;
+
+   mask = si->nslots-1;
+   for (i=h & mask; si->slots[i].key != NULL; i=(i+1) & mask);
+   si->slots[i].key  = key;
+   si->slots[i].hash = h;
+   si->slots[i].idx  = idx;
+   si->n++;
+}
+
+
+/**
+ * @brief Doubles the amount of slots of an index.
+ *
+ *    @param si Index to grow.
+ */
+static void strindex_grow( StrIndex *si )
+{
+   int i, nslots;
+   StrIndexSlot *slots;
+
+   slots       = si->slots;
+   nslots      = si->nslots;
+   si->nslots *= 2;
+   si->slots   = calloc( si->nslots, sizeof(StrIndexSlot) );
+   si->n       = 0;
+   for (i=0; i<nslots; i++)
+      if (slots[i].key != NULL)
+         strindex_insert( si, slots[i].key, slots[i].hash, slots[i].idx );
+   free( slots );
+}
+
+
+/**
+ * @brief Adds a name to an index.
+ *
+ * If the name is already in the index, the previous position is kept.
+ *
+ *    @param si Index to add to.
+ *    @param key Name to add, it is not copied.
+ *    @param idx Position of the name in the stack.
+ */
+void strindex_add( StrIndex *si, const char *key, int idx )
+{
+   if (key == NULL) {
+      WARN(_("Trying to index NULL name."));
+      return;
+   }
+   if (strindex_get( si, key ) >= 0)
+      return;
+
+   /* Keep the load factor under one half. */
+   if (2*(si->n+1) > si->nslots)
+      strindex_grow( si );
+   strindex_insert( si, key, strindex_hash(key), idx );
+}
+
+
+/**
+ * @brief Looks up a name in an index.
+ *
+ *    @param si Index to look up in.
+ *    @param key Name to look up.
+ *    @return Position of the name in the stack or -1 if not found.
+ */
+int strindex_get( const StrIndex *si, const char *key )
+{
+   int i, mask;
+   uint32_t h;
+
+   if ((si == NULL) || (key == NULL))
+      return -1;
+
+   h     = strindex_hash( key );
+   mask  = si->nslots-1;
+   for (i=h & mask; si->slots[i].key != NULL; i=(i+1) & mask)
+      if ((si->slots[i].hash == h) && (strcmp( si->slots[i].key, key ) == 0))
+         return si->slots[i].idx;
+   return -1;
+}
+
+
+/**
+ * @brief Removes a name from an index.
+ *
+ * Uses backward shift deletion so that lookups of the remaining names do not
+ * need tombstones.
+ *
+ *    @param si Index to remove from.
+ *    @param key Name to remove.
+ *    @return The position the name had or -1 if it was not in the index.
+ */
+int strindex_remove( StrIndex *si, const char *key )
+{
+   int i, j, k, mask, idx;
+   uint32_t h;
+
+   if ((si == NULL) || (key == NULL))
+      return -1;
+
+   h     = strindex_hash( key );
+   mask  = si->nslots-1;
+   for (i=h & mask; si->slots[i].key != NULL; i=(i+1) & mask)
+      if ((si->slots[i].hash == h) && (strcmp( si->slots[i].key, key ) == 0))
+         break;
+   if (si->slots[i].key == NULL)
+      return -1;
+   idx = si->slots[i].idx;
+
+   /* Shift back the following slots that would no longer be reachable. */
+   for (j=(i+1) & mask; si->slots[j].key != NULL; j=(j+1) & mask) {
+      k = si->slots[j].hash & mask;
+      /* Slot j can fill the hole at i only if its home is not in (i,j]. */
+      if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+         continue;
+      si->slots[i] = si->slots[j];
+      i = j;
+   }
+   si->slots[i].key = NULL;
+   si->n--;
+   return idx;
+}
+
+
+/**
+ * @brief Gets the amount of names in an index.
+ *
+ *    @param si Index to get the size of.
+ *    @return Amount of names in the index.
+ */
+int strindex_size( const StrIndex *si )
+{
+   return (si == NULL) ? 0 : si->n;
+}
@@ -0,0 +1,32 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef STRINDEX_H
+#  define STRINDEX_H
+
+
+/**
+ * @brief Hash index mapping names to positions in a stack.
+ */
+typedef struct StrIndex_ StrIndex;
+
+
+/*
+ * Creation and destruction.
+ */
+StrIndex* strindex_create( int n );
+void strindex_free( StrIndex *si );
+void strindex_clear( StrIndex *si );
+
+/*
+ * Usage.
+ */
+void strindex_add( StrIndex *si, const char *key, int idx );
+int strindex_get( const StrIndex *si, const char *key );
+int strindex_remove( StrIndex *si, const char *key );
+int strindex_size( const StrIndex *si );
+
+
+#endif /* STRINDEX_H */
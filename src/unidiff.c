@@ -38,10 +38,22 @@
 typedef struct UniDiffData_ {
    char *name; /**< Name of the diff (read from XML). */
    char *filename; /**< Filename of the diff. */
+   xmlDocPtr doc; /**< Parsed diff, kept as the applied hunks point into it. */
 } UniDiffData_t;
 static UniDiffData_t *diff_available = NULL; /**< Available diffs. */
 
 
+/*
+ * Universe rebuilds pending after patching.
+ */
+#define DIFF_REBUILD_JUMPS    (1<<0) /**< Jumps need to be reconstructed. */
+#define DIFF_REBUILD_PRESENCE (1<<1) /**< Presences need to be reconstructed. */
+#define DIFF_REBUILD_ECONOMY  (1<<2) /**< Queued economy updates need to be run. */
+#define DIFF_REBUILD_PRICES   (1<<3) /**< Commodity prices need to be recomputed. */
+static int diff_rebuildFlags  = 0; /**< Pending rebuilds. */
+static int diff_batchLevel    = 0; /**< Rebuilds are deferred while in a batch. */
+
+
 /**
  * @enum UniHunkTargetType_t
  *
@@ -151,6 +163,7 @@ static void diff_hunkFailed( UniDiff_t *diff, UniHunk_t *hunk );
 static void diff_hunkSuccess( UniDiff_t *diff, UniHunk_t *hunk );
 static void diff_cleanup( UniDiff_t *diff );
 static void diff_cleanupHunk( UniHunk_t *hunk );
+static void diff_rebuild (void);
 /* Externed. */
 int diff_save( xmlTextWriterPtr writer ); /**< Used in save.c */
 int diff_load( xmlNodePtr parent ); /**< Used in save.c */
@@ -185,8 +198,8 @@ int diff_loadAvailable (void)
 
       diff = &array_grow(&diff_available);
       diff->filename = diff_files[i];
+      diff->doc = doc;
       xmlr_attr_strd(node, "name", diff->name);
-      xmlFreeDoc(doc);
    }
    array_free( diff_files );
    array_shrink(&diff_available);
@@ -235,45 +248,90 @@ static UniDiff_t* diff_get( const char *name )
  */
 int diff_apply( const char *name )
 {
-   xmlNodePtr node;
    xmlDocPtr doc;
-   char *filename;
    int i;
 
    /* Check if already applied. */
    if (diff_isApplied(name))
       return 0;
 
-   filename = NULL;
+   doc = NULL;
    for (i=0; i<array_size(diff_available); i++) {
       if (strcmp(diff_available[i].name,name)==0) {
-         filename = diff_available[i].filename;
+         doc = diff_available[i].doc;
          break;
       }
    }
-   if (filename == NULL) {
+   if (doc == NULL) {
       WARN(_("UniDiff '%s' not found in %s!"), name, UNIDIFF_DATA_PATH);
       return -1;
    }
 
-   doc = xml_parsePhysFS( filename );
+   /* Apply it, the root element was checked by diff_loadAvailable(). */
+   diff_patch( doc->xmlChildrenNode );
 
-   node = doc->xmlChildrenNode;
-   if (strcmp((char*)node->name,"unidiff")) {
-      ERR(_("Malformed unidiff file: missing root element 'unidiff'"));
-      return 0;
+   /* Re-compute the economy. */
+   diff_rebuildFlags |= DIFF_REBUILD_ECONOMY | DIFF_REBUILD_PRICES;
+   diff_rebuild();
+
+   return 0;
+}
+
+
+/**
+ * @brief Starts a batch of diff changes.
+ *
+ * The jumps, presences and economy are only rebuilt once the outermost batch
+ * is ended with diff_batchEnd(), instead of after every diff.
+ */
+void diff_batchStart (void)
+{
+   diff_batchLevel++;
+}
+
+
+/**
+ * @brief Ends a batch of diff changes, doing the pending rebuilds.
+ */
+void diff_batchEnd (void)
+{
+   if (diff_batchLevel <= 0) {
+      WARN(_("Ending a UniDiff batch that was not started!"));
+      return;
    }
+   diff_batchLevel--;
+   diff_rebuild();
+}
 
-   /* Apply it. */
-   diff_patch( node );
 
-   xmlFreeDoc(doc);
+/**
+ * @brief Rebuilds what the applied or removed diffs changed, unless batching.
+ */
+static void diff_rebuild (void)
+{
+   int flags;
 
-   /* Re-compute the economy. */
-   economy_execQueued();
-   economy_initialiseCommodityPrices();
+   if (diff_batchLevel > 0)
+      return;
 
-   return 0;
+   flags = diff_rebuildFlags;
+   diff_rebuildFlags = 0;
+
+   if (flags & DIFF_REBUILD_JUMPS)
+      systems_reconstructJumps();
+
+   /* Prune presences if necessary. */
+   if (flags & DIFF_REBUILD_PRESENCE)
+      space_reconstructPresences();
+
+   /* Update overlay map just in case. */
+   if (flags & (DIFF_REBUILD_JUMPS | DIFF_REBUILD_PRESENCE))
+      ovr_refresh();
+
+   if (flags & DIFF_REBUILD_ECONOMY)
+      economy_execQueued();
+   if (flags & DIFF_REBUILD_PRICES)
+      economy_initialiseCommodityPrices();
 }
 
 
@@ -719,12 +777,10 @@ static int diff_patch( xmlNodePtr parent )
       }
    }
 
-   /* Prune presences if necessary. */
+   /* Prune presences if necessary, done by diff_rebuild(). */
    if (univ_update)
-      space_reconstructPresences();
+      diff_rebuildFlags |= DIFF_REBUILD_PRESENCE;
 
-   /* Update overlay map just in case. */
-   ovr_refresh();
    return 0;
 }
 
@@ -760,9 +816,11 @@ static int diff_patchHunk( UniHunk_t *hunk )
 
       /* Adding a Jump. */
       case HUNK_TYPE_JUMP_ADD:
+         diff_rebuildFlags |= DIFF_REBUILD_JUMPS;
          return system_addJumpDiff( system_get(hunk->target.u.name), hunk->node );
       /* Removing a jump. */
       case HUNK_TYPE_JUMP_REMOVE:
+         diff_rebuildFlags |= DIFF_REBUILD_JUMPS;
          return system_rmJump( system_get(hunk->target.u.name), hunk->u.name );
 
       /* Adding a tech. */
@@ -910,7 +968,8 @@ void diff_remove( const char *name )
 
    diff_removeDiff(diff);
 
-   economy_execQueued();
+   diff_rebuildFlags |= DIFF_REBUILD_ECONOMY;
+   diff_rebuild();
 }
 
 
@@ -922,7 +981,8 @@ void diff_clear (void)
    while (array_size(diff_stack) > 0)
       diff_removeDiff(&diff_stack[array_size(diff_stack)-1]);
 
-   economy_execQueued();
+   diff_rebuildFlags |= DIFF_REBUILD_ECONOMY;
+   diff_rebuild();
 }
 
 
@@ -935,6 +995,7 @@ void diff_free (void)
    for (int i = 0; i < array_size(diff_available); i++) {
       free(diff_available[i].name);
       free(diff_available[i].filename);
+      xmlFreeDoc(diff_available[i].doc);
    }
    array_free(diff_available);
    diff_available = NULL;
@@ -1128,6 +1189,8 @@ int diff_load( xmlNodePtr parent )
    xmlNodePtr node, cur;
    char *     diffName;
 
+   /* Only rebuild the universe once all the diffs are applied. */
+   diff_batchStart();
    diff_clear();
 
    node = parent->xmlChildrenNode;
@@ -1146,6 +1209,7 @@ int diff_load( xmlNodePtr parent )
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
+   diff_batchEnd();
 
    return 0;
 
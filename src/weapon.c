@@ -34,9 +34,12 @@
 #include "player.h"
 #include "rng.h"
 #include "spfx.h"
+#include "weapon_grid.h"
 
 
 #define weapon_isSmart(w)     (w->think != NULL) /**< Checks if the weapon w is smart. */
+#define weapon_isLinear(w)    (!weapon_isSmart(w) && outfit_isBolt(w->outfit) && \
+      (w->solid->thrust == 0.) && (w->solid->dir_vel == 0.)) /**< Weapon moves in a straight line at constant speed. */
 
 /* Weapon status */
 #define WEAPON_STATUS_OK         0 /**< Weapon is fine */
@@ -57,6 +60,9 @@ extern Pilot** pilot_stack;
  */
 typedef struct Weapon_ {
    Solid *solid; /**< Actually has its own solid :) */
+   Solid solid_data; /**< Storage of the solid, avoids an allocation. */
+   int idx; /**< Position in its layer. */
+   int removed; /**< Destroyed while updating, freed once the layers are done. */
    unsigned int ID; /**< Only used for beam weapons. */
 
    int faction; /**< faction of pilot that shot it */
@@ -104,6 +110,26 @@ static size_t weapon_vboSize   = 0; /**< Size of the VBO. */
 static unsigned int beam_idgen = 0; /**< Beam identifier generator. */
 
 
+/*
+ * Weapon pool.
+ *
+ * Weapons are created and destroyed constantly, so they are carved out of
+ * blocks that are never freed until weapon_exit() and recycled through a
+ * freelist instead of going through malloc each time.
+ */
+#define WEAPON_CHUNK       256 /**< Amount of weapons allocated at once. */
+static Weapon **weapon_chunks = NULL; /**< Allocated blocks of WEAPON_CHUNK weapons. */
+static Weapon **weapon_pool   = NULL; /**< Weapons available for reuse. */
+static int weapons_updating   = 0; /**< Layers are being iterated, so removals are deferred. */
+
+
+/*
+ * Collision broadphase, pilots are binned before asteroids.
+ */
+static int wgrid_npilots      = 0; /**< Amount of pilots binned this tick. */
+static int wgrid_nopoly[2]    = { -1, -1 }; /**< First two binned pilots without a collision polygon. */
+
+
 /*
  * Prototypes
  */
@@ -123,8 +149,15 @@ static void weapon_render( Weapon* w, const double dt );
 static void weapons_updateLayer( const double dt, const WeaponLayer layer );
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer );
 static void weapon_sample_trail( Weapon* w );
+/* Broadphase. */
+static void weapons_gridBuild (void);
+static int weapon_gridNoPoly( const Weapon *w, int i );
+static int weapon_collidePilot( Weapon *w, Pilot *p, int usePoly,
+      glTexture *gfx, CollPoly *polygon, WeaponLayer layer, const double dt );
 /* Destruction. */
+static Weapon* weapon_alloc (void);
 static void weapon_destroy( Weapon* w, WeaponLayer layer );
+static void weapons_purgeLayer( Weapon **wlayer );
 static void weapon_free( Weapon* w );
 static void weapon_explodeLayer( WeaponLayer layer,
       double x, double y, double radius,
@@ -152,6 +185,9 @@ void weapon_init (void)
 {
    wfrontLayer = array_create(Weapon*);
    wbackLayer  = array_create(Weapon*);
+
+   weapon_chunks  = array_create(Weapon*);
+   weapon_pool    = array_create(Weapon*);
 }
 
 
@@ -460,8 +496,45 @@ static void think_beam( Weapon* w, const double dt )
  */
 void weapons_update( const double dt )
 {
+   /* Pilots and asteroids don't move while weapons update, so the
+    * broadphase can be shared by both layers. */
+   weapons_gridBuild();
+
+   /* Weapons destroyed meanwhile (including by explosions from the other
+    * layer) stay in place until both layers are done, so every weapon gets
+    * exactly one update. */
+   weapons_updating = 1;
    weapons_updateLayer(dt,WEAPON_LAYER_BG);
    weapons_updateLayer(dt,WEAPON_LAYER_FG);
+   weapons_updating = 0;
+
+   weapons_purgeLayer( wbackLayer );
+   weapons_purgeLayer( wfrontLayer );
+}
+
+
+/**
+ * @brief Frees the weapons removed during the update, keeping the order of the rest.
+ *
+ *    @param wlayer Layer to purge.
+ */
+static void weapons_purgeLayer( Weapon **wlayer )
+{
+   int i, n;
+   Weapon *w;
+
+   n = 0;
+   for (i=0; i<array_size(wlayer); i++) {
+      w = wlayer[i];
+      if (w->removed) {
+         weapon_free(w);
+         continue;
+      }
+      w->idx      = n;
+      wlayer[n++] = w;
+   }
+   if (n < array_size(wlayer))
+      array_erase( &wlayer, &wlayer[n], array_end(wlayer) );
 }
 
 
@@ -494,9 +567,10 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
          return;
    }
 
-   i = 0;
-   while (i < array_size(wlayer)) {
+   for (i=0; i<array_size(wlayer); i++) {
       w = wlayer[i];
+      if (w->removed)
+         continue;
 
       switch (w->outfit->type) {
 
@@ -590,16 +664,9 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
             break;
       }
 
-      /* Out of bounds, loop is over. */
-      if (i >= array_size(wlayer))
-         break;
-
-      /* Only increment if weapon wasn't deleted. */
-      if (w == wlayer[i]) {
+      /* Only update if weapon wasn't destroyed. */
+      if (!w->removed)
          weapon_update(w,dt,layer);
-         if ((i < array_size(wlayer)) && (w == wlayer[i]))
-            i++;
-      }
    }
 }
 
@@ -628,8 +695,10 @@ void weapons_render( const WeaponLayer layer, const double dt )
          return;
    }
 
+   gl_batchBegin();
    for (i=0; i<array_size(wlayer); i++)
       weapon_render( wlayer[i], dt );
+   gl_batchEnd();
 }
 
 
@@ -640,6 +709,9 @@ static void weapon_renderBeam( Weapon* w, const double dt ) {
    /* Animation. */
    w->anim += dt;
 
+   /* Draw any batched sprites below the beam. */
+   gl_batchFlush();
+
    /* Load GLSL program */
    glUseProgram(shaders.beam.program);
 
@@ -821,6 +893,173 @@ static int weapon_checkCanHit( Weapon* w, Pilot *p )
 }
 
 
+/**
+ * @brief Bins all the pilots and visible asteroids into the collision grid.
+ *
+ * Extents are deliberately generous (full sprite size instead of half) so
+ * that the grid never culls a pair the narrow phase would have reported.
+ */
+static void weapons_gridBuild (void)
+{
+   int i, j;
+   Pilot *p;
+   AsteroidAnchor *ast;
+   Asteroid *a;
+   glTexture *gfx;
+
+   weapons_gridClear();
+   wgrid_nopoly[0] = -1;
+   wgrid_nopoly[1] = -1;
+
+   /* Pilots go first and in stack order, so that sorting the candidates
+    * gives the same order as iterating over the stack. */
+   wgrid_npilots = array_size(pilot_stack);
+   for (i=0; i<wgrid_npilots; i++) {
+      p   = pilot_stack[i];
+      gfx = p->ship->gfx_space;
+      weapon_gridAdd( p->solid->pos.x, p->solid->pos.y,
+            MAX( gfx->sw, gfx->sh ), -1, i );
+
+      if (array_size(p->ship->polygon) == 0) {
+         if (wgrid_nopoly[0] < 0)
+            wgrid_nopoly[0] = i;
+         else if (wgrid_nopoly[1] < 0)
+            wgrid_nopoly[1] = i;
+      }
+   }
+
+   /* Asteroids can only be hit while visible. */
+   for (i=0; i<array_size(cur_system->asteroids); i++) {
+      ast = &cur_system->asteroids[i];
+      for (j=0; j<ast->nb; j++) {
+         a = &ast->asteroids[j];
+         if (a->appearing != ASTEROID_VISIBLE)
+            continue;
+         gfx = space_getType( a->type )->gfxs[ a->gfxID ];
+         weapon_gridAdd( a->pos.x, a->pos.y, MAX( gfx->sw, gfx->sh ), i, j );
+      }
+   }
+
+   weapons_gridBin();
+}
+
+
+/**
+ * @brief Checks to see if a pilot without a collision polygon comes before
+ *        a stack position, ignoring the weapon's parent.
+ *
+ * Once such a pilot is found, sprite collisions are used for the rest of
+ * the stack, so this keeps the results independent of the broadphase.
+ *
+ *    @param w Weapon being checked.
+ *    @param i Stack position being checked.
+ *    @return 1 if sprite collisions should be used.
+ */
+static int weapon_gridNoPoly( const Weapon *w, int i )
+{
+   int k, j;
+
+   for (k=0; k<2; k++) {
+      j = wgrid_nopoly[k];
+      if ((j < 0) || (j > i))
+         return 0;
+      if (pilot_stack[j]->id != w->parent)
+         return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Checks and handles a collision between a weapon and a pilot.
+ *
+ *    @param w Weapon to check.
+ *    @param p Pilot to check against.
+ *    @param usePoly Whether or not to use the collision polygons.
+ *    @param gfx Graphic of the weapon if not a beam.
+ *    @param polygon Polygon of the weapon if not a beam.
+ *    @param layer Layer to which the weapon belongs.
+ *    @param dt Current delta tick.
+ *    @return 1 if the weapon was destroyed.
+ */
+static int weapon_collidePilot( Weapon *w, Pilot *p, int usePoly,
+      glTexture *gfx, CollPoly *polygon, WeaponLayer layer, const double dt )
+{
+   int psx, psy, k;
+   unsigned int coll;
+   Vector2d crash[2];
+
+   psx = p->tsx;
+   psy = p->tsy;
+
+   /* Beam weapons have special collisions. */
+   if (outfit_isBeam(w->outfit)) {
+      /* Check for collision. */
+      if (weapon_checkCanHit(w,p)) {
+         if (usePoly) {
+            k = p->ship->gfx_space->sx * psy + psx;
+            coll = CollideLinePolygon( &w->solid->pos, w->solid->dir,
+                  w->outfit->u.bem.range, &p->ship->polygon[k],
+                  &p->solid->pos, crash);
+         }
+         else {
+            coll = CollideLineSprite( &w->solid->pos, w->solid->dir,
+                  w->outfit->u.bem.range, p->ship->gfx_space, psx, psy,
+                  &p->solid->pos, crash);
+         }
+         if (coll)
+            weapon_hitBeam( w, p, layer, crash, dt );
+            /* No return because beam can still think, it's not
+             * destroyed like the other weapons.*/
+      }
+   }
+   /* smart weapons only collide with their target */
+   else if (weapon_isSmart(w)) {
+
+      if ( (p->id == w->target) &&
+            (w->status == WEAPON_STATUS_OK) &&
+            weapon_checkCanHit(w,p) ) {
+         if (usePoly) {
+            k = p->ship->gfx_space->sx * psy + psx;
+            coll = CollidePolygon( &p->ship->polygon[k], &p->solid->pos,
+                     polygon, &w->solid->pos, &crash[0] );
+         }
+         else {
+            coll = CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
+                     p->ship->gfx_space, psx, psy,
+                     &p->solid->pos, &crash[0] );
+         }
+         if (coll) {
+            weapon_hit( w, p, layer, &crash[0] );
+            return 1; /* Weapon is destroyed. */
+         }
+      }
+   }
+   /* unguided weapons hit anything not of the same faction */
+   else {
+      if (weapon_checkCanHit(w,p)) {
+         if (usePoly) {
+            k = p->ship->gfx_space->sx * psy + psx;
+            coll = CollidePolygon( &p->ship->polygon[k], &p->solid->pos,
+                     polygon, &w->solid->pos, &crash[0] );
+         }
+         else {
+            coll = CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
+                     p->ship->gfx_space, psx, psy,
+                     &p->solid->pos, &crash[0] );
+         }
+
+         if (coll) {
+            weapon_hit( w, p, layer, &crash[0] );
+            return 1; /* Weapon is destroyed. */
+         }
+      }
+   }
+
+   return 0;
+}
+
+
 /**
  * @brief Updates an individual weapon.
  *
@@ -830,15 +1069,17 @@ static int weapon_checkCanHit( Weapon* w, Pilot *p )
  */
 static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
 {
-   int i, j, b, psx, psy, k, n;
-   unsigned int coll, usePoly=1;
+   int i, j, b, n, nopoly;
+   unsigned int usePoly=1;
+   double r, x2, y2;
    glTexture *gfx;
    CollPoly *plg, *polygon;
    Vector2d crash[2];
    Pilot *p;
-   AsteroidAnchor *ast;
    Asteroid *a;
    AsteroidType *at;
+   const WGridObj *o;
+   const int *cand;
 
    gfx = NULL;
    polygon = NULL;
@@ -861,133 +1102,80 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
          if (array_size(w->outfit->u.amm.polygon) == 0)
             usePoly = 0;
       }
+
+      /* Only look at what overlaps the weapon. */
+      r = MAX( gfx->sw, gfx->sh );
+      cand = weapon_gridQuery( w->solid->pos.x - r, w->solid->pos.y - r,
+            w->solid->pos.x + r, w->solid->pos.y + r );
    }
+   else {
+      /* Only look at what overlaps the beam. */
+      x2 = w->solid->pos.x + w->outfit->u.bem.range * cos(w->solid->dir);
+      y2 = w->solid->pos.y + w->outfit->u.bem.range * sin(w->solid->dir);
+      cand = weapon_gridQuery( MIN( w->solid->pos.x, x2 ), MIN( w->solid->pos.y, y2 ),
+            MAX( w->solid->pos.x, x2 ), MAX( w->solid->pos.y, y2 ) );
+   }
+
+   /* Collide with the pilots, in stack order. */
+   for (i=0; i<array_size(cand); i++) {
+      o = weapon_gridObj( cand[i] );
+      if (o->anchor >= 0)
+         break;
+      if (o->id >= array_size(pilot_stack))
+         continue;
+      p = pilot_stack[ o->id ];
 
-   for (i=0; i<array_size(pilot_stack); i++) {
-      p = pilot_stack[i];
+      if (w->parent == p->id) continue; /* pilot is self */
 
-      psx = pilot_stack[i]->tsx;
-      psy = pilot_stack[i]->tsy;
+      if (weapon_collidePilot( w, p, usePoly && !weapon_gridNoPoly( w, o->id ),
+               gfx, polygon, layer, dt ))
+         return; /* Weapon is destroyed. */
+   }
+
+   /* Pilots added since the grid was built are not binned. */
+   nopoly = weapon_gridNoPoly( w, wgrid_npilots-1 );
+   for (j=wgrid_npilots; j<array_size(pilot_stack); j++) {
+      p = pilot_stack[j];
 
-      if (w->parent == pilot_stack[i]->id) continue; /* pilot is self */
+      if (w->parent == p->id) continue; /* pilot is self */
 
       /* See if the ship has a collision polygon. */
       if (array_size(p->ship->polygon) == 0)
-         usePoly = 0;
-
-      /* Beam weapons have special collisions. */
-      if (b) {
-         /* Check for collision. */
-         if (weapon_checkCanHit(w,p)) {
-            if (usePoly) {
-               k = p->ship->gfx_space->sx * psy + psx;
-               coll = CollideLinePolygon( &w->solid->pos, w->solid->dir,
-                     w->outfit->u.bem.range, &p->ship->polygon[k],
-                     &p->solid->pos, crash);
-            }
-            else {
-               coll = CollideLineSprite( &w->solid->pos, w->solid->dir,
-                     w->outfit->u.bem.range, p->ship->gfx_space, psx, psy,
-                     &p->solid->pos, crash);
-            }
-            if (coll)
-               weapon_hitBeam( w, p, layer, crash, dt );
-               /* No return because beam can still think, it's not
-                * destroyed like the other weapons.*/
-         }
-      }
-      /* smart weapons only collide with their target */
-      else if (weapon_isSmart(w)) {
-
-         if ( (pilot_stack[i]->id == w->target) &&
-               (w->status == WEAPON_STATUS_OK) &&
-               weapon_checkCanHit(w,p) ) {
-            if (usePoly) {
-               k = p->ship->gfx_space->sx * psy + psx;
-               coll = CollidePolygon( &p->ship->polygon[k], &p->solid->pos,
-                        polygon, &w->solid->pos, &crash[0] );
-            }
-            else {
-               coll = CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        p->ship->gfx_space, psx, psy,
-                        &p->solid->pos, &crash[0] );
-            }
-            if (coll) {
-               weapon_hit( w, p, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
-         }
-      }
-      /* unguided weapons hit anything not of the same faction */
-      else {
-         if (weapon_checkCanHit(w,p)) {
-            if (usePoly) {
-               k = p->ship->gfx_space->sx * psy + psx;
-               coll = CollidePolygon( &p->ship->polygon[k], &p->solid->pos,
-                        polygon, &w->solid->pos, &crash[0] );
-            }
-            else {
-               coll = CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        p->ship->gfx_space, psx, psy,
-                        &p->solid->pos, &crash[0] );
-            }
+         nopoly = 1;
 
-            if (coll) {
-            weapon_hit( w, p, layer, &crash[0] );
-            return; /* Weapon is destroyed. */
-            }
-         }
-      }
+      if (weapon_collidePilot( w, p, usePoly && !nopoly,
+               gfx, polygon, layer, dt ))
+         return; /* Weapon is destroyed. */
    }
 
-   /* Collide with asteroids*/
-   if (outfit_isAmmo(w->outfit)) {
-      for (i=0; i<array_size(cur_system->asteroids); i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        &crash[0] ) ) {
-               weapon_hitAst( w, a, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
-         }
-      }
-   }
-   else if (outfit_isBolt(w->outfit)) {
-      for (i=0; i<array_size(cur_system->asteroids); i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        &crash[0] ) ) {
-               weapon_hitAst( w, a, layer, &crash[0] );
-               return; /* Weapon is destroyed. */
-            }
+   /* Collide with asteroids, the remaining candidates. */
+   if (outfit_isAmmo(w->outfit) || outfit_isBolt(w->outfit)) {
+      for (; i<array_size(cand); i++) {
+         o  = weapon_gridObj( cand[i] );
+         a  = &cur_system->asteroids[ o->anchor ].asteroids[ o->id ];
+         at = space_getType ( a->type );
+         if ( (a->appearing == ASTEROID_VISIBLE) &&
+               CollideSprite( gfx, w->sx, w->sy, &w->solid->pos,
+                     at->gfxs[a->gfxID], 0, 0, &a->pos,
+                     &crash[0] ) ) {
+            weapon_hitAst( w, a, layer, &crash[0] );
+            return; /* Weapon is destroyed. */
          }
       }
    }
    else if (b) { /* Beam */
-      for (i=0; i<array_size(cur_system->asteroids); i++) {
-         ast = &cur_system->asteroids[i];
-         for (j=0; j<ast->nb; j++) {
-            a = &ast->asteroids[j];
-            at = space_getType ( a->type );
-            if ( (a->appearing == ASTEROID_VISIBLE) &&
-                  CollideLineSprite( &w->solid->pos, w->solid->dir,
-                        w->outfit->u.bem.range,
-                        at->gfxs[a->gfxID], 0, 0, &a->pos,
-                        crash ) ) {
-               weapon_hitAstBeam( w, a, layer, crash, dt );
-               /* No return because beam can still think, it's not
-                * destroyed like the other weapons.*/
-            }
+      for (; i<array_size(cand); i++) {
+         o  = weapon_gridObj( cand[i] );
+         a  = &cur_system->asteroids[ o->anchor ].asteroids[ o->id ];
+         at = space_getType ( a->type );
+         if ( (a->appearing == ASTEROID_VISIBLE) &&
+               CollideLineSprite( &w->solid->pos, w->solid->dir,
+                     w->outfit->u.bem.range,
+                     at->gfxs[a->gfxID], 0, 0, &a->pos,
+                     crash ) ) {
+            weapon_hitAstBeam( w, a, layer, crash, dt );
+            /* No return because beam can still think, it's not
+             * destroyed like the other weapons.*/
          }
       }
    }
@@ -996,15 +1184,20 @@ static void weapon_update( Weapon* w, const double dt, WeaponLayer layer )
    if (weapon_isSmart(w))
       (*w->think)(w,dt);
 
-   /* Update the solid position. */
-   (*w->solid->update)(w->solid, dt);
+   /* Update the solid position, unguided bolts just drift. Nothing reads the
+    * polar form of a weapon position, so it is not kept up to date. */
+   if (weapon_isLinear(w))
+      vect_csetmin( &w->solid->pos, w->solid->pos.x + w->solid->vel.x*dt,
+            w->solid->pos.y + w->solid->vel.y*dt );
+   else
+      (*w->solid->update)(w->solid, dt);
 
    /* Update the sound. */
    sound_updatePos(w->voice, w->solid->pos.x, w->solid->pos.y,
          w->solid->vel.x, w->solid->vel.y);
 
-   /* Update the trail. */
-   if (w->trail != NULL)
+   /* Update the trail, not visible when simulating the system. */
+   if ((w->trail != NULL) && !space_isSimulation())
       weapon_sample_trail( w );
 }
 
@@ -1429,7 +1622,7 @@ static void weapon_createBolt( Weapon *w, const Outfit* outfit, double T,
    vect_cadd( &v, outfit->u.blt.speed*cos(rdir), outfit->u.blt.speed*sin(rdir));
    w->timer = outfit->u.blt.range / outfit->u.blt.speed;
    w->falloff = w->timer - outfit->u.blt.falloff / outfit->u.blt.speed;
-   w->solid = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_EULER );
+   solid_init( w->solid, mass, rdir, pos, &v, SOLID_UPDATE_EULER );
    w->voice = sound_playPos( w->outfit->u.blt.sound,
          w->solid->pos.x,
          w->solid->pos.y,
@@ -1496,7 +1689,7 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
    /* Set up ammo details. */
    mass        = w->outfit->mass;
    w->timer    = ammo->u.amm.duration * parent->stats.launch_range;
-   w->solid    = solid_create( mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
+   solid_init( w->solid, mass, rdir, pos, &v, SOLID_UPDATE_RK4 );
    if (w->outfit->u.amm.thrust != 0.) {
       weapon_setThrust( w, w->outfit->u.amm.thrust * mass );
       w->solid->speed_max = w->outfit->u.amm.speed; /* Limit speed, we only care if it has thrust. */
@@ -1524,8 +1717,8 @@ static void weapon_createAmmo( Weapon *w, const Outfit* launcher, double T,
    gfx = outfit_gfx( w->outfit );
    gl_getSpriteFromDir( &w->sx, &w->sy, gfx, w->solid->dir );
 
-   /* Set up trails. */
-   if (ammo->u.amm.trail_spec != NULL)
+   /* Set up trails, they would never get updated while simulating. */
+   if ((ammo->u.amm.trail_spec != NULL) && !space_isSimulation())
       w->trail = spfx_trail_create( ammo->u.amm.trail_spec );
 }
 
@@ -1555,7 +1748,8 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
    Weapon* w;
 
    /* Create basic features */
-   w           = calloc( 1, sizeof(Weapon) );
+   w           = weapon_alloc();
+   w->solid    = &w->solid_data;
    w->dam_mod  = 1.; /* Default of 100% damage. */
    w->dam_as_dis_mod = 0.; /* Default of 0% damage to disable. */
    w->faction  = parent->faction; /* non-changeable */
@@ -1603,7 +1797,7 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
             rdir -= 2.*M_PI;
          mass = 1.; /**< Needs a mass. */
          w->r     = RNGF(); /* Set unique value. */
-         w->solid = solid_create( mass, rdir, pos, vel, SOLID_UPDATE_EULER );
+         solid_init( w->solid, mass, rdir, pos, vel, SOLID_UPDATE_EULER );
          w->think = think_beam;
          w->timer = outfit->u.bem.duration;
          w->voice = sound_playPos( w->outfit->u.bem.sound,
@@ -1623,7 +1817,7 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
       default:
          WARN(_("Weapon of type '%s' has no create implemented yet!"),
                w->outfit->name);
-         w->solid = solid_create( 1., dir, pos, vel, SOLID_UPDATE_EULER );
+         solid_init( w->solid, 1., dir, pos, vel, SOLID_UPDATE_EULER );
          break;
    }
 
@@ -1668,9 +1862,11 @@ void weapon_add( const Outfit* outfit, const double T, const double dir,
    switch (layer) {
       case WEAPON_LAYER_BG:
          m = &array_grow(&wbackLayer);
+         w->idx = array_size(wbackLayer)-1;
          break;
       case WEAPON_LAYER_FG:
          m = &array_grow(&wfrontLayer);
+         w->idx = array_size(wfrontLayer)-1;
          break;
 
       default:
@@ -1731,9 +1927,11 @@ unsigned int beam_start( const Outfit* outfit,
    switch (layer) {
       case WEAPON_LAYER_BG:
          m = &array_grow(&wbackLayer);
+         w->idx = array_size(wbackLayer)-1;
          break;
       case WEAPON_LAYER_FG:
          m = &array_grow(&wfrontLayer);
+         w->idx = array_size(wfrontLayer)-1;
          break;
 
       default:
@@ -1804,7 +2002,7 @@ void beam_end( const unsigned int parent, unsigned int beam )
  */
 static void weapon_destroy( Weapon* w, WeaponLayer layer )
 {
-   int i;
+   int i, n;
    Weapon** wlayer;
 
    switch (layer) {
@@ -1820,14 +2018,54 @@ static void weapon_destroy( Weapon* w, WeaponLayer layer )
          return;
    }
 
-   for (i=0; (wlayer[i] != w) && (i < array_size(wlayer)); i++); /* get to the current position */
-   if (i >= array_size(wlayer)) {
+   i = w->idx;
+   if ((i < 0) || (i >= array_size(wlayer)) || (wlayer[i] != w)) {
       WARN(_("Trying to destroy weapon not found in stack!"));
       return;
    }
+   if (w->removed)
+      return;
+
+   /* Don't move weapons around while the layers are being updated. */
+   if (weapons_updating) {
+      w->removed = 1;
+      return;
+   }
+
+   /* Swap with the last weapon instead of shifting the whole layer. */
+   n = array_size(wlayer)-1;
+   wlayer[i] = wlayer[n];
+   wlayer[i]->idx = i;
+   array_erase( &wlayer, &wlayer[n], &wlayer[n+1] );
+
+   weapon_free(w);
+}
+
+
+/**
+ * @brief Gets a weapon from the pool.
+ *
+ *    @return A zeroed out weapon.
+ */
+static Weapon* weapon_alloc (void)
+{
+   int i;
+   Weapon *chunk, *w;
+
+   /* Pool ran dry, carve out a new block. */
+   if (array_size(weapon_pool) == 0) {
+      chunk = malloc( WEAPON_CHUNK * sizeof(Weapon) );
+      if (chunk == NULL)
+         ERR(_("Out of Memory"));
+      array_push_back( &weapon_chunks, chunk );
+      for (i=WEAPON_CHUNK-1; i>=0; i--)
+         array_push_back( &weapon_pool, &chunk[i] );
+   }
 
-   weapon_free(wlayer[i]);
-   array_erase( &wlayer, &wlayer[i], &wlayer[i+1] );
+   w = weapon_pool[ array_size(weapon_pool)-1 ];
+   array_resize( &weapon_pool, array_size(weapon_pool)-1 );
+   memset( w, 0, sizeof(Weapon) );
+   return w;
 }
 
 
@@ -1859,9 +2097,6 @@ static void weapon_free( Weapon* w )
             w->solid->vel.y);
    }
 
-   /* Free the solid. */
-   solid_free(w->solid);
-
    /* Free the trail, if any. */
    spfx_trail_remove(w->trail);
 
@@ -1869,7 +2104,8 @@ static void weapon_free( Weapon* w )
    memset(w, 0, sizeof(Weapon));
 #endif /* DEBUGGING */
 
-   free(w);
+   /* Give it back to the pool. */
+   array_push_back( &weapon_pool, w );
 }
 
 /**
@@ -1896,6 +2132,8 @@ void weapon_clear (void)
  */
 void weapon_exit (void)
 {
+   int i;
+
    weapon_clear();
 
    /* Destroy front layer. */
@@ -1904,6 +2142,17 @@ void weapon_exit (void)
    /* Destroy back layer. */
    array_free(wfrontLayer);
 
+   /* Destroy the pool. */
+   for (i=0; i<array_size(weapon_chunks); i++)
+      free( weapon_chunks[i] );
+   array_free(weapon_chunks);
+   weapon_chunks = NULL;
+   array_free(weapon_pool);
+   weapon_pool = NULL;
+
+   /* Destroy the collision grid. */
+   weapons_gridFree();
+
    /* Destroy VBO. */
    free( weapon_vboData );
    weapon_vboData = NULL;
@@ -1934,7 +2183,8 @@ static void weapon_explodeLayer( WeaponLayer layer,
       const Pilot *parent, int mode )
 {
    (void)parent;
-   int i;
+   int i, n;
+   Weapon *w;
    Weapon **curLayer;
    double dist, rad2;
 
@@ -1956,15 +2206,21 @@ static void weapon_explodeLayer( WeaponLayer layer,
 
    /* Now try to destroy the weapons affected. */
    for (i=0; i<array_size(curLayer); i++) {
-      if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(curLayer[i]->outfit)) ||
-            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(curLayer[i]->outfit))) {
+      w = curLayer[i];
+      if (w->removed)
+         continue;
+      if (((mode & EXPL_MODE_MISSILE) && outfit_isAmmo(w->outfit)) ||
+            ((mode & EXPL_MODE_BOLT) && outfit_isBolt(w->outfit))) {
 
-         dist = pow2(curLayer[i]->solid->pos.x - x) +
-               pow2(curLayer[i]->solid->pos.y - y);
+         dist = pow2(w->solid->pos.x - x) +
+               pow2(w->solid->pos.y - y);
 
          if (dist < rad2) {
-            weapon_destroy(curLayer[i], layer);
-            i--;
+            /* Recheck the slot if the last weapon got swapped into it. */
+            n = array_size(curLayer);
+            weapon_destroy(w, layer);
+            if (array_size(curLayer) < n)
+               i--;
          }
       }
    }
@@ -0,0 +1,265 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+/**
+ * @file weapon_grid.c
+ *
+ * @brief Collision broadphase of the weapons.
+ *
+ * Pilots and visible asteroids are binned once per tick into a uniform grid
+ * by their bounding boxes, so that weapons only run the narrow phase against
+ * objects that could possibly overlap them.  Objects are numbered in the
+ * order they are added, and queries return them in that order.
+ */
+
+
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "weapon_grid.h"
+
+#include "array.h"
+
+
+#define WGRID_CELL_MIN     256. /**< Minimum size of a grid cell. */
+#define WGRID_CELLS_MAX    64 /**< Maximum amount of cells along each axis. */
+
+
+static WGridObj *wgrid_obj    = NULL; /**< Objects in the grid, in the order they were added. */
+static int *wgrid_start       = NULL; /**< Start offset of each cell into wgrid_entries. */
+static int *wgrid_entries     = NULL; /**< Object indices ordered by cell. */
+static unsigned int *wgrid_mark = NULL; /**< Per-object query stamp to avoid duplicates. */
+static unsigned int wgrid_stamp = 0; /**< Current query stamp. */
+static int *wgrid_cand        = NULL; /**< Candidates of the last query. */
+static int wgrid_nx           = 0; /**< Amount of cells along X. */
+static int wgrid_ny           = 0; /**< Amount of cells along Y. */
+static double wgrid_x0        = 0.; /**< Left edge of the grid. */
+static double wgrid_y0        = 0.; /**< Bottom edge of the grid. */
+static double wgrid_cell      = WGRID_CELL_MIN; /**< Size of a cell. */
+
+
+/*
+ * Prototypes.
+ */
+static int weapon_gridRange( double x1, double y1, double x2, double y2,
+      int *cx1, int *cy1, int *cx2, int *cy2 );
+static int weapon_gridCmp( const void *a, const void *b );
+
+
+/**
+ * @brief Removes all the objects from the grid.
+ */
+void weapons_gridClear (void)
+{
+   if (wgrid_obj == NULL) {
+      wgrid_obj      = array_create( WGridObj );
+      wgrid_start    = array_create( int );
+      wgrid_entries  = array_create( int );
+      wgrid_mark     = array_create( unsigned int );
+      wgrid_cand     = array_create( int );
+   }
+   array_resize( &wgrid_obj, 0 );
+   wgrid_nx = 0;
+   wgrid_ny = 0;
+}
+
+
+/**
+ * @brief Adds an object to the grid, to be binned by weapons_gridBin().
+ *
+ *    @param x X position of the object.
+ *    @param y Y position of the object.
+ *    @param r Half extent of the object's bounding box.
+ *    @param anchor Asteroid anchor of the object or -1 if it's a pilot.
+ *    @param id Stack position of the pilot or position of the asteroid in the anchor.
+ */
+void weapon_gridAdd( double x, double y, double r, int anchor, int id )
+{
+   WGridObj *o;
+
+   o = &array_grow( &wgrid_obj );
+   o->x1 = x - r;
+   o->y1 = y - r;
+   o->x2 = x + r;
+   o->y2 = y + r;
+   o->anchor = anchor;
+   o->id = id;
+}
+
+
+/**
+ * @brief Gets the range of cells overlapped by a bounding box.
+ *
+ *    @return 1 if the box overlaps the grid, 0 otherwise.
+ */
+static int weapon_gridRange( double x1, double y1, double x2, double y2,
+      int *cx1, int *cy1, int *cx2, int *cy2 )
+{
+   double w, h;
+
+   w = wgrid_nx * wgrid_cell;
+   h = wgrid_ny * wgrid_cell;
+   x1 -= wgrid_x0;
+   x2 -= wgrid_x0;
+   y1 -= wgrid_y0;
+   y2 -= wgrid_y0;
+   /* Boxes touching the far edges still belong to the last cells. */
+   if ((x2 < 0.) || (y2 < 0.) || (x1 > w) || (y1 > h))
+      return 0;
+
+   *cx1 = CLAMP( 0, wgrid_nx-1, (int)(x1 / wgrid_cell) );
+   *cy1 = CLAMP( 0, wgrid_ny-1, (int)(y1 / wgrid_cell) );
+   *cx2 = CLAMP( 0, wgrid_nx-1, (int)(x2 / wgrid_cell) );
+   *cy2 = CLAMP( 0, wgrid_ny-1, (int)(y2 / wgrid_cell) );
+   return 1;
+}
+
+
+/**
+ * @brief Bins the objects added since the last clear into the cells.
+ */
+void weapons_gridBin (void)
+{
+   int i, n, c, cx, cy, cx1, cy1, cx2, cy2;
+   double x1, y1, x2, y2;
+
+   n = array_size(wgrid_obj);
+   array_resize( &wgrid_mark, n );
+   memset( wgrid_mark, 0, n * sizeof(unsigned int) );
+   wgrid_stamp = 0;
+   if (n == 0) {
+      wgrid_nx = 0;
+      wgrid_ny = 0;
+      return;
+   }
+
+   /* Fit the grid to the objects. */
+   x1 = wgrid_obj[0].x1;
+   y1 = wgrid_obj[0].y1;
+   x2 = wgrid_obj[0].x2;
+   y2 = wgrid_obj[0].y2;
+   for (i=1; i<n; i++) {
+      x1 = MIN( x1, wgrid_obj[i].x1 );
+      y1 = MIN( y1, wgrid_obj[i].y1 );
+      x2 = MAX( x2, wgrid_obj[i].x2 );
+      y2 = MAX( y2, wgrid_obj[i].y2 );
+   }
+   wgrid_x0   = x1;
+   wgrid_y0   = y1;
+   wgrid_cell = MAX( WGRID_CELL_MIN, MAX( x2-x1, y2-y1 ) / WGRID_CELLS_MAX );
+   wgrid_nx   = MIN( WGRID_CELLS_MAX, (int)((x2-x1) / wgrid_cell) + 1 );
+   wgrid_ny   = MIN( WGRID_CELLS_MAX, (int)((y2-y1) / wgrid_cell) + 1 );
+
+   /* Counting sort of the objects into the cells. */
+   c = wgrid_nx * wgrid_ny;
+   array_resize( &wgrid_start, c+1 );
+   memset( wgrid_start, 0, (c+1) * sizeof(int) );
+   for (i=0; i<n; i++) {
+      weapon_gridRange( wgrid_obj[i].x1, wgrid_obj[i].y1,
+            wgrid_obj[i].x2, wgrid_obj[i].y2, &cx1, &cy1, &cx2, &cy2 );
+      for (cy=cy1; cy<=cy2; cy++)
+         for (cx=cx1; cx<=cx2; cx++)
+            wgrid_start[ cy*wgrid_nx + cx + 1 ]++;
+   }
+   for (i=0; i<c; i++)
+      wgrid_start[i+1] += wgrid_start[i];
+   array_resize( &wgrid_entries, wgrid_start[c] );
+   /* Filling advances each start to the next cell's, shift them back after. */
+   for (i=0; i<n; i++) {
+      weapon_gridRange( wgrid_obj[i].x1, wgrid_obj[i].y1,
+            wgrid_obj[i].x2, wgrid_obj[i].y2, &cx1, &cy1, &cx2, &cy2 );
+      for (cy=cy1; cy<=cy2; cy++)
+         for (cx=cx1; cx<=cx2; cx++)
+            wgrid_entries[ wgrid_start[ cy*wgrid_nx + cx ]++ ] = i;
+   }
+   for (i=c; i>0; i--)
+      wgrid_start[i] = wgrid_start[i-1];
+   wgrid_start[0] = 0;
+}
+
+
+/**
+ * @brief Frees the grid.
+ */
+void weapons_gridFree (void)
+{
+   array_free( wgrid_obj );
+   wgrid_obj = NULL;
+   array_free( wgrid_start );
+   wgrid_start = NULL;
+   array_free( wgrid_entries );
+   wgrid_entries = NULL;
+   array_free( wgrid_mark );
+   wgrid_mark = NULL;
+   array_free( wgrid_cand );
+   wgrid_cand = NULL;
+   wgrid_nx = 0;
+   wgrid_ny = 0;
+}
+
+
+/**
+ * @brief Gets an object of the grid.
+ *
+ *    @param i Index of the object, as returned by weapon_gridQuery().
+ *    @return The object.
+ */
+const WGridObj* weapon_gridObj( int i )
+{
+   return &wgrid_obj[i];
+}
+
+
+/**
+ * @brief Compares two collision grid objects for qsort.
+ */
+static int weapon_gridCmp( const void *a, const void *b )
+{
+   return *(const int*)a - *(const int*)b;
+}
+
+
+/**
+ * @brief Gets the objects whose bounding box overlaps a box.
+ *
+ *    @return Array (array.h) of object indices in the order they were added,
+ *            valid until the next query.
+ */
+const int* weapon_gridQuery( double x1, double y1, double x2, double y2 )
+{
+   int i, k, c, cx, cy, cx1, cy1, cx2, cy2;
+   WGridObj *o;
+
+   if (wgrid_cand == NULL)
+      wgrid_cand = array_create( int );
+   array_resize( &wgrid_cand, 0 );
+   if ((wgrid_nx == 0) ||
+         !weapon_gridRange( x1, y1, x2, y2, &cx1, &cy1, &cx2, &cy2 ))
+      return wgrid_cand;
+
+   wgrid_stamp++;
+   for (cy=cy1; cy<=cy2; cy++) {
+      for (cx=cx1; cx<=cx2; cx++) {
+         c = cy*wgrid_nx + cx;
+         for (k=wgrid_start[c]; k<wgrid_start[c+1]; k++) {
+            i = wgrid_entries[k];
+            if (wgrid_mark[i] == wgrid_stamp)
+               continue;
+            wgrid_mark[i] = wgrid_stamp;
+
+            o = &wgrid_obj[i];
+            if ((o->x2 < x1) || (x2 < o->x1) || (o->y2 < y1) || (y2 < o->y1))
+               continue;
+            array_push_back( &wgrid_cand, i );
+         }
+      }
+   }
+   qsort( wgrid_cand, array_size(wgrid_cand), sizeof(int), weapon_gridCmp );
+   return wgrid_cand;
+}
@@ -0,0 +1,38 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef WEAPON_GRID_H
+#  define WEAPON_GRID_H
+
+
+/**
+ * @brief Bounding box of an object in the collision grid.
+ */
+typedef struct WGridObj_ {
+   double x1; /**< Left edge. */
+   double y1; /**< Bottom edge. */
+   double x2; /**< Right edge. */
+   double y2; /**< Top edge. */
+   int anchor; /**< Asteroid anchor, -1 for pilots. */
+   int id; /**< Pilot stack position or asteroid position in the anchor. */
+} WGridObj;
+
+
+/*
+ * Grid management.
+ */
+void weapons_gridClear (void);
+void weapon_gridAdd( double x, double y, double r, int anchor, int id );
+void weapons_gridBin (void);
+void weapons_gridFree (void);
+
+/*
+ * Queries.
+ */
+const WGridObj* weapon_gridObj( int i );
+const int* weapon_gridQuery( double x1, double y1, double x2, double y2 );
+
+
+#endif /* WEAPON_GRID_H */
@@ -0,0 +1,62 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file test.h
+ *
+ * @brief Shared scaffolding of the unit tests.
+ *
+ * Each test includes this once and defines test_run(), which does the
+ * checks.  The test fails if any CHECK() did.
+ */
+
+
+#ifndef TEST_H
+#  define TEST_H
+
+
+/** @cond */
+#include <stdio.h>
+/** @endcond */
+
+
+static int test_failed = 0; /**< Amount of failed checks. */
+static unsigned int test_seed = 12345; /**< State of the random generator. */
+
+
+#define CHECK( cond ) do { if (!(cond)) { \
+   fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond ); \
+   test_failed++; } } while (0) /**< Counts a check as failed if cond is false. */
+
+
+/**
+ * @brief Runs the checks of a test, defined by each test.
+ */
+static void test_run (void);
+
+
+/**
+ * @brief Gets a reproducible random number in [0,n).
+ */
+static inline int test_rnd( int n )
+{
+   test_seed = test_seed*1103515245u + 12345u;
+   return (test_seed >> 8) % n;
+}
+
+
+int main( int argc, char** argv )
+{
+   (void) argc;
+   (void) argv;
+
+   test_run();
+
+   if (test_failed)
+      fprintf( stderr, "%d checks failed\n", test_failed );
+   return (test_failed > 0);
+}
+
+
+#endif /* TEST_H */
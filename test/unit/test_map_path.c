@@ -0,0 +1,223 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file test_map_path.c
+ *
+ * @brief Checks the jump pathfinding against a breadth first search.
+ *
+ * Runs on random universes with known, unknown, hidden and exit only jumps,
+ * and grows the universe between searches.
+ */
+
+
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "map_path.h"
+
+#include "array.h"
+#include "test.h"
+
+
+#define NSYS      60 /**< Amount of systems at first. */
+#define NMORE     25 /**< Amount of systems added afterwards. */
+#define NJUMPS    3 /**< Maximum amount of jumps per system. */
+
+
+StarSystem *systems_stack = NULL; /**< Stack of the test systems. */
+
+
+/**
+ * @brief Only known systems can be reached through unknown ones.
+ */
+int space_sysReachable( StarSystem *sys )
+{
+   (void) sys;
+   return 0;
+}
+
+
+/**
+ * @brief Adds a system with random jumps to the stack.
+ *
+ * Targets are stored as ids and linked by link_systems(), as adding systems
+ * moves the stack around.
+ */
+static void add_system( int nsys )
+{
+   int i, f;
+   StarSystem *sys;
+   JumpPoint *jp;
+
+   sys         = &array_grow( &systems_stack );
+   memset( sys, 0, sizeof(StarSystem) );
+   sys->id     = array_size(systems_stack)-1;
+   sys->jumps  = array_create( JumpPoint );
+   if (test_rnd(4) > 0)
+      sys->flags |= SYSTEM_KNOWN;
+   for (i=test_rnd(NJUMPS+1); i>0; i--) {
+      jp = &array_grow( &sys->jumps );
+      memset( jp, 0, sizeof(JumpPoint) );
+      jp->targetid = test_rnd( nsys );
+      f = test_rnd(8);
+      if (f > 0)
+         jp->flags |= JP_KNOWN;
+      if (f == 1)
+         jp->flags |= JP_HIDDEN;
+      if (f == 2)
+         jp->flags |= JP_EXITONLY;
+   }
+}
+
+
+/**
+ * @brief Points the jumps to their target systems.
+ */
+static void link_systems (void)
+{
+   int i, j;
+   for (i=0; i<array_size(systems_stack); i++) {
+      for (j=0; j<array_size(systems_stack[i].jumps); j++) {
+         systems_stack[i].jumps[j].from   = &systems_stack[i];
+         systems_stack[i].jumps[j].target =
+               &systems_stack[ systems_stack[i].jumps[j].targetid ];
+      }
+   }
+}
+
+
+/**
+ * @brief Frees all the test systems.
+ */
+static void free_systems (void)
+{
+   int i;
+   for (i=0; i<array_size(systems_stack); i++)
+      array_free( systems_stack[i].jumps );
+   array_free( systems_stack );
+   systems_stack = NULL;
+}
+
+
+/**
+ * @brief Checks to see if a system has a usable jump to another.
+ */
+static int has_jump( int from, int to, int ignore_known, int show_hidden )
+{
+   int i;
+   JumpPoint *jp;
+
+   for (i=0; i<array_size(systems_stack[from].jumps); i++) {
+      jp = &systems_stack[from].jumps[i];
+      if (jp->targetid != to)
+         continue;
+      if (!ignore_known && (!jp_isKnown(jp) || !sys_isKnown(jp->target)))
+         continue;
+      if (jp_isFlag( jp, JP_EXITONLY ))
+         continue;
+      if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ))
+         continue;
+      return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Computes the jumps from a system with a breadth first search.
+ */
+static void bfs( int start, int ignore_known, int show_hidden, int *dist )
+{
+   int i, j, n, head, *queue;
+
+   n     = array_size(systems_stack);
+   queue = malloc( n * sizeof(int) );
+   for (i=0; i<n; i++)
+      dist[i] = -1;
+   dist[start] = 0;
+   queue[0]    = start;
+   j           = 1;
+   for (head=0; head<j; head++)
+      for (i=0; i<n; i++)
+         if ((dist[i] < 0) && has_jump( queue[head], i, ignore_known, show_hidden )) {
+            dist[i]    = dist[ queue[head] ] + 1;
+            queue[j++] = i;
+         }
+   free( queue );
+}
+
+
+/**
+ * @brief Checks searches from every system of the stack.
+ */
+static void check_searches( int ignore_known, int show_hidden )
+{
+   int s, e, i, n, p, found, *dist;
+
+   n    = array_size(systems_stack);
+   dist = malloc( n * sizeof(int) );
+   for (s=0; s<n; s++) {
+      bfs( s, ignore_known, show_hidden, dist );
+
+      /* Expanding everything reachable. */
+      CHECK( map_pathRun( &systems_stack[s], NULL, ignore_known, show_hidden ) == 0 );
+      for (i=0; i<n; i++) {
+         CHECK( map_pathJumps( i ) == dist[i] );
+         p = map_pathParent( i );
+         if ((i == s) || (dist[i] < 0))
+            CHECK( p == -1 );
+         else
+            CHECK( (p >= 0) && (dist[p] == dist[i]-1) &&
+                  has_jump( p, i, ignore_known, show_hidden ) );
+      }
+
+      /* Stopping at a target, the path has to lead back to the start. */
+      e     = test_rnd( n );
+      found = map_pathRun( &systems_stack[s], &systems_stack[e],
+            ignore_known, show_hidden );
+      CHECK( found == (dist[e] >= 0) );
+      if (found) {
+         CHECK( map_pathJumps( e ) == dist[e] );
+         for (i=e; (i >= 0) && (i != s); i=map_pathParent( i ));
+         CHECK( i == s );
+      }
+
+      if (test_failed)
+         break;
+   }
+   free( dist );
+}
+
+
+/**
+ * @brief Runs the checks.
+ */
+static void test_run (void)
+{
+   int i, ik, sh;
+
+   systems_stack = array_create( StarSystem );
+   for (i=0; i<NSYS; i++)
+      add_system( NSYS );
+   link_systems();
+   for (ik=0; ik<2; ik++)
+      for (sh=0; sh<2; sh++)
+         check_searches( ik, sh );
+
+   /* New systems after the first searches. */
+   for (i=0; i<NMORE; i++)
+      add_system( NSYS+NMORE );
+   link_systems();
+   for (ik=0; ik<2; ik++)
+      for (sh=0; sh<2; sh++)
+         check_searches( ik, sh );
+
+   map_pathFree();
+   free_systems();
+}
@@ -0,0 +1,198 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file test_pilot_grid.c
+ *
+ * @brief Checks the pilot spatial index against plain scans of the stack.
+ *
+ * Pilots are laid out on the cell boundaries of the grid, which is where
+ * rounding mistakes in the cell lookups would show.
+ */
+
+
+/** @cond */
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "pilot_grid.h"
+
+#include "array.h"
+#include "test.h"
+
+
+#define CELL      1000. /**< Cell size the layout below ends up with. */
+#define SPAN      31 /**< Extent of the layout in cells. */
+
+
+Pilot** pilot_stack = NULL; /**< Stack of the test pilots. */
+
+
+/**
+ * @brief Adds a pilot at a position to the stack.
+ */
+static void add_pilot( double x, double y )
+{
+   Pilot *p;
+
+   p        = calloc( 1, sizeof(Pilot) );
+   p->solid = calloc( 1, sizeof(Solid) );
+   p->solid->pos.x = x;
+   p->solid->pos.y = y;
+   array_push_back( &pilot_stack, p );
+}
+
+
+/**
+ * @brief Frees all the test pilots.
+ */
+static void free_pilots (void)
+{
+   int i;
+   for (i=0; i<array_size(pilot_stack); i++) {
+      free( pilot_stack[i]->solid );
+      free( pilot_stack[i] );
+   }
+   array_resize( &pilot_stack, 0 );
+}
+
+
+/**
+ * @brief Cost of the plain distance, skipping pilots at odd stack positions
+ *        when data is set.
+ */
+static int cost_dist( const Pilot *p, double d2, const void *data, double *cost )
+{
+   int i;
+
+   if (data != NULL) {
+      for (i=0; pilot_stack[i] != p; i++);
+      if (i % 2)
+         return 0;
+   }
+   *cost = d2;
+   return 1;
+}
+
+
+/**
+ * @brief Checks a nearest query against a scan of the stack.
+ */
+static void check_nearest( double x, double y, const void *data )
+{
+   int i, best, found;
+   double d2, c, bc, fc;
+
+   best = -1;
+   bc   = 0.;
+   for (i=0; i<array_size(pilot_stack); i++) {
+      d2 = pow2( x - pilot_stack[i]->solid->pos.x ) +
+            pow2( y - pilot_stack[i]->solid->pos.y );
+      if (!cost_dist( pilot_stack[i], d2, data, &c ))
+         continue;
+      if ((best < 0) || (c < bc)) {
+         best = i;
+         bc   = c;
+      }
+   }
+
+   fc    = -1.;
+   found = pilot_gridNearest( x, y, 1., cost_dist, data, &fc );
+   CHECK( found == best );
+   if (best >= 0)
+      CHECK( fc == bc );
+}
+
+
+/**
+ * @brief Checks a radius query against a scan of the stack.
+ */
+static void check_radius( double x, double y, double r )
+{
+   int i, n;
+   const int *res;
+
+   res = pilot_gridRadius( x, y, r );
+   n   = 0;
+   for (i=0; i<array_size(pilot_stack); i++) {
+      if (pow2( x - pilot_stack[i]->solid->pos.x ) +
+            pow2( y - pilot_stack[i]->solid->pos.y ) > pow2(r))
+         continue;
+      CHECK( (n < array_size(res)) && (res[n] == i) );
+      n++;
+   }
+   CHECK( array_size(res) == n );
+}
+
+
+/**
+ * @brief Runs queries on and around every cell boundary of the layout.
+ */
+static void check_queries (void)
+{
+   int i, j;
+   double x, y;
+
+   for (i=-2; i<=2*SPAN+2; i++) {
+      for (j=-2; j<=2*SPAN+2; j+=3) {
+         x = i * CELL/2.;
+         y = j * CELL/2.;
+         check_nearest( x, y, NULL );
+         check_nearest( x, y, pilot_stack );
+         check_radius( x, y, 0. );
+         check_radius( x, y, CELL );
+         check_radius( x, y, 1.5*CELL );
+         if (test_failed)
+            return;
+      }
+   }
+}
+
+
+/**
+ * @brief Runs the checks.
+ */
+static void test_run (void)
+{
+   int i;
+
+   pilot_stack = array_create( Pilot* );
+
+   /* Empty index. */
+   pilots_gridBuild();
+   CHECK( pilot_gridNearest( 0., 0., 1., cost_dist, NULL, NULL ) == -1 );
+   CHECK( array_size( pilot_gridRadius( 0., 0., CELL ) ) == 0 );
+
+   /* Pilots on the cell boundaries along the diagonal and edges, and just
+    * inside of them. */
+   for (i=0; i<=SPAN; i++) {
+      add_pilot( i*CELL, i*CELL );
+      add_pilot( i*CELL, 0. );
+      add_pilot( 0., i*CELL );
+      add_pilot( i*CELL - 1e-9, SPAN*CELL - i*CELL );
+   }
+   add_pilot( SPAN*CELL, SPAN*CELL );
+   pilots_gridBuild();
+   check_queries();
+
+   /* Pilots added after building are not in the index. */
+   add_pilot( 5.5*CELL, 7.*CELL );
+   add_pilot( -3.*CELL, 40.*CELL );
+   check_queries();
+
+   /* Invalidated index, everything is scanned. */
+   pilots_gridInvalidate();
+   check_queries();
+
+   /* Larger layout, so the cells grow. */
+   add_pilot( 4.*SPAN*CELL, 4.*SPAN*CELL );
+   pilots_gridBuild();
+   check_queries();
+
+   pilots_gridFree();
+   free_pilots();
+   array_free( pilot_stack );
+}
@@ -0,0 +1,160 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file test_strindex.c
+ *
+ * @brief Checks the name index against a plain scan of the names.
+ */
+
+
+/** @cond */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "strindex.h"
+
+#include "log.h"
+#include "test.h"
+
+
+#define NKEYS     64 /**< Amount of distinct names. */
+#define NOPS      20000 /**< Amount of random operations. */
+
+
+static char keys[NKEYS][16]; /**< Names to index. */
+
+
+/*
+ * Stubs for what the index needs from the rest of the game.
+ */
+const char* gettext_ngettext( const char* msgid, const char* msgid_plural, uint64_t n )
+{
+   return ((n == 1) || (msgid_plural == NULL)) ? msgid : msgid_plural;
+}
+int logprintf( FILE *stream, int newline, const char *fmt, ... )
+{
+   int n;
+   va_list ap;
+
+   va_start( ap, fmt );
+   n = vfprintf( stream, fmt, ap );
+   va_end( ap );
+   if (newline)
+      fputc( '\n', stream );
+   return n;
+}
+
+
+/**
+ * @brief Checks that every name is found exactly where the reference says.
+ */
+static void check_all( const StrIndex *si, const int *ref )
+{
+   int i, n;
+
+   n = 0;
+   for (i=0; i<NKEYS; i++) {
+      CHECK( strindex_get( si, keys[i] ) == ref[i] );
+      if (ref[i] >= 0)
+         n++;
+   }
+   CHECK( strindex_size( si ) == n );
+}
+
+
+/**
+ * @brief Adds, looks up and removes names in order.
+ */
+static void test_basic (void)
+{
+   int i, ref[NKEYS];
+   StrIndex *si;
+
+   si = strindex_create( 0 );
+   for (i=0; i<NKEYS; i++) {
+      strindex_add( si, keys[i], i );
+      ref[i] = i;
+   }
+   check_all( si, ref );
+
+   /* The first index is kept for duplicates. */
+   strindex_add( si, keys[3], 100 );
+   CHECK( strindex_get( si, keys[3] ) == 3 );
+   CHECK( strindex_get( si, "missing" ) == -1 );
+   CHECK( strindex_get( si, NULL ) == -1 );
+   CHECK( strindex_get( NULL, keys[0] ) == -1 );
+
+   /* Every other name removed, the rest must still be reachable. */
+   for (i=0; i<NKEYS; i+=2) {
+      CHECK( strindex_remove( si, keys[i] ) == i );
+      CHECK( strindex_remove( si, keys[i] ) == -1 );
+      ref[i] = -1;
+   }
+   check_all( si, ref );
+
+   /* Removed names can be added again. */
+   for (i=0; i<NKEYS; i+=2) {
+      strindex_add( si, keys[i], NKEYS+i );
+      ref[i] = NKEYS+i;
+   }
+   check_all( si, ref );
+
+   strindex_clear( si );
+   for (i=0; i<NKEYS; i++)
+      ref[i] = -1;
+   check_all( si, ref );
+   strindex_free( si );
+}
+
+
+/**
+ * @brief Random adds and removes in a small index, where probing wraps around.
+ */
+static void test_random (void)
+{
+   int i, k, ref[NKEYS];
+   StrIndex *si;
+
+   si = strindex_create( 0 );
+   for (i=0; i<NKEYS; i++)
+      ref[i] = -1;
+
+   for (i=0; i<NOPS; i++) {
+      /* Only use a few names so the index stays small and crowded. */
+      k = test_rnd( 12 );
+      if (test_rnd( 2 )) {
+         strindex_add( si, keys[k], i );
+         if (ref[k] < 0)
+            ref[k] = i;
+      }
+      else {
+         CHECK( strindex_remove( si, keys[k] ) == ref[k] );
+         ref[k] = -1;
+      }
+      check_all( si, ref );
+      if (test_failed)
+         break;
+   }
+   strindex_free( si );
+}
+
+
+/**
+ * @brief Runs the checks.
+ */
+static void test_run (void)
+{
+   int i;
+
+   for (i=0; i<NKEYS; i++)
+      snprintf( keys[i], sizeof(keys[i]), "key%d", i );
+
+   test_basic();
+   test_random();
+}
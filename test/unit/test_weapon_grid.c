@@ -0,0 +1,133 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file test_weapon_grid.c
+ *
+ * @brief Checks the weapon collision grid against plain overlap tests.
+ *
+ * Boxes and queries are snapped to a quarter of a cell so that their edges
+ * often fall exactly on the cell boundaries, and touching boxes are expected
+ * to be reported.
+ */
+
+
+/** @cond */
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "weapon_grid.h"
+
+#include "array.h"
+#include "test.h"
+
+
+#define SNAP      64. /**< Snapping of the positions, a quarter of the smallest cell. */
+#define NOBJS     300 /**< Amount of boxes. */
+#define NQUERIES  3000 /**< Amount of random queries. */
+
+
+/**
+ * @brief Gets a random snapped coordinate in [0,n*SNAP].
+ */
+static double rnd_snap( int n )
+{
+   return test_rnd( n+1 ) * SNAP;
+}
+
+
+/**
+ * @brief Checks a query against overlap tests of all the boxes.
+ */
+static void check_query( const double *box, int n, double x1, double y1,
+      double x2, double y2 )
+{
+   int i, m;
+   const int *res;
+   const WGridObj *o;
+
+   res = weapon_gridQuery( x1, y1, x2, y2 );
+   m   = 0;
+   for (i=0; i<n; i++) {
+      if ((box[4*i+2] < x1) || (x2 < box[4*i]) ||
+            (box[4*i+3] < y1) || (y2 < box[4*i+1]))
+         continue;
+      CHECK( (m < array_size(res)) && (res[m] == i) );
+      m++;
+   }
+   CHECK( array_size(res) == m );
+
+   for (i=0; i<array_size(res); i++) {
+      o = weapon_gridObj( res[i] );
+      CHECK( o->id == res[i] );
+   }
+}
+
+
+/**
+ * @brief Bins random boxes spread over a span and queries them.
+ *
+ *    @param span Extent of the layout in multiples of SNAP.
+ */
+static void test_layout( int span )
+{
+   int i;
+   double x, y, r, x1, y1;
+   double box[4*NOBJS];
+
+   weapons_gridClear();
+   for (i=0; i<NOBJS; i++) {
+      x = rnd_snap( span );
+      y = rnd_snap( span );
+      r = rnd_snap( 2 );
+      weapon_gridAdd( x, y, r, (i%3 == 0) ? -1 : i%3, i );
+      box[4*i]   = x-r;
+      box[4*i+1] = y-r;
+      box[4*i+2] = x+r;
+      box[4*i+3] = y+r;
+   }
+   weapons_gridBin();
+
+   for (i=0; i<NQUERIES; i++) {
+      x1 = rnd_snap( span+8 ) - 4.*SNAP;
+      y1 = rnd_snap( span+8 ) - 4.*SNAP;
+      check_query( box, NOBJS, x1, y1, x1 + rnd_snap( 8 ), y1 + rnd_snap( 8 ) );
+      if (test_failed)
+         return;
+   }
+
+   /* Points exactly on every snapped position, including cell corners. */
+   for (x=-2.*SNAP; x<=(span+2)*SNAP; x+=SNAP)
+      for (y=-2.*SNAP; y<=(span+2)*SNAP; y+=4.*SNAP)
+         check_query( box, NOBJS, x, y, x, y );
+}
+
+
+/**
+ * @brief Runs the checks.
+ */
+static void test_run (void)
+{
+   /* Empty grid. */
+   weapons_gridClear();
+   weapons_gridBin();
+   CHECK( array_size( weapon_gridQuery( -1., -1., 1., 1. ) ) == 0 );
+
+   /* Small layout with the minimum cell size, then ones with larger cells
+    * and with more cells than the grid allows along each axis. */
+   test_layout( 40 );
+   test_layout( 256 );
+   test_layout( 1000 );
+
+   /* Rebinning after clearing drops the old boxes. */
+   weapons_gridClear();
+   weapon_gridAdd( 0., 0., 10., -1, 0 );
+   weapons_gridBin();
+   CHECK( array_size( weapon_gridQuery( 100., 100., 200., 200. ) ) == 0 );
+   CHECK( array_size( weapon_gridQuery( 10., 10., 20., 20. ) ) == 1 );
+
+   weapons_gridFree();
+}